@@ -70,17 +70,23 @@
 #include <unistd.h>
 #if !defined(AIX) && !defined(SOLARIS) && !defined(FREEBSD) && !defined(DARWIN)
 #include <getopt.h>
+#define HAVE_GETOPT_LONG
 #endif /* !AIX and !SOLARIS and !FREEBSD and !DARWIN */
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <time.h>
+#include <signal.h>
+#include <errno.h>
 #include <string.h>
 #include <fcntl.h>
 #include <strings.h>
 #include <stdint.h>
+#include <pthread.h>
 #include "ad26.h"
 
 #include "digitemp.h"
 #include "device_name.h"
+#include "format.h"
 #include "ownet.h"
 #include "owproto.h"
 
@@ -93,8 +99,7 @@ extern int	optind, opterr, optopt;
 
 extern const char dtlib[];			/* Library Used            */
  
-char serial_port[1024],				/* Path to the serial port */
-     tmp_serial_port[1024],
+char tmp_serial_port[1024],
      serial_dev[1024],				/* Device name without /dev/ */
      log_file[1024],                         /* Path to the log file    */
      tmp_log_file[1024],
@@ -111,18 +116,47 @@ char serial_port[1024],				/* Path to the serial port */
      option_list[40];
 int	read_time,				/* Pause during read	   */
 	tmp_read_time,
+	convert_tries = DEFAULT_CONVERT_TRIES,	/* Conversions per sensor  */
+	read_tries = DEFAULT_READ_TRIES,	/* Re-reads per conversion */
 	log_type,				/* output format type	   */
 	tmp_log_type,
-    num_cs = 0,                             /* Number of sensors on cplr */
 	opts = 0;				/* Bitmask of flags	        */
 
-struct _coupler *coupler_top = NULL;		/* Linked list of couplers */
-
-unsigned char Last2409[9];                      /* Last selected coupler   */
-
-
-int	global_msec = 10;			/* For ReadCOM delay       */
-int	global_msec_max = 15;
+struct _bus buses[MAX_BUSES];			/* One for each TTY line   */
+int	num_buses = 1,
+	num_open = 0;				/* Adapter ports acquired  */
+
+struct _fmt_prog *temp_prog = NULL,		/* Compiled output formats */
+		 *counter_prog = NULL,
+		 *humidity_prog = NULL,
+		 *adc_prog = NULL;
+
+int	log_fd = -1,				/* Open logfile            */
+	log_len = 0,				/* Bytes waiting in log_buf */
+	log_records = 0,			/* Lines waiting in log_buf */
+	log_flush_records = 0,			/* Flush after this many, 0 every sample */
+	log_fsync = 0;				/* Seconds between fsyncs, 0 never */
+long	log_bucket = -1;			/* Time bucket of log_path */
+int	log_secs = -1;				/* log_bucket_secs( log_file ), -1 not known */
+long	log_bytes = 0,				/* Bytes of output written */
+	log_syscalls = 0;			/* System calls used to write it */
+time_t	log_synced = 0;				/* Time of the last fsync  */
+char	log_path[1024],				/* log_file after strftime */
+	log_buf[LOG_BUF_SIZE];
+
+pthread_mutex_t fmt_lock = PTHREAD_MUTEX_INITIALIZER;	/* Output formats and localtime */
+
+
+volatile sig_atomic_t daemon_quit = 0,		/* SIGTERM or SIGINT seen  */
+		      daemon_reload = 0;	/* SIGHUP seen             */
+
+#ifdef HAVE_GETOPT_LONG
+struct option long_options[] = {
+  { "daemon", no_argument, NULL, 'D' },
+  { "bench", required_argument, NULL, 'B' },
+  { NULL, 0, NULL, 0 }
+};
+#endif /* HAVE_GETOPT_LONG */
 
 /* ----------------------------------------------------------------------- *
    Print out the program usage
@@ -145,6 +179,8 @@ void usage()
   printf("                -q                            No Copyright notice\n");
   printf("                -a                            Read all Sensors\n");
   printf("                -d 5                          Delay between samples (in sec.)\n");
+  printf("                -D, --daemon                  Keep running, -d is in mS\n");
+  printf("                -B, --bench 20                Benchmark 20 sweeps of -a and exit\n");
   printf("                -n 50                         Number of times to repeat\n");
   printf("                                              0=loop forever\n");
   printf("                -A                            Treat DS2438 as A/D converter\n");
@@ -178,17 +214,17 @@ void usage()
 /* ----------------------------------------------------------------------- *
    Free up all memory used by the coupler list
  * ----------------------------------------------------------------------- */
-void free_coupler( int free_only )
+void free_coupler( struct _bus *bus, int free_only )
 {
   unsigned char   a[3];
   struct _coupler *c;
   
-  c = coupler_top;
+  c = bus->coupler_top;
   while(c)
   {
      /* Turn off the Coupler */
      if ( !free_only )
-       SetSwitch1F(0, c->SN, ALL_LINES_OFF, 0, a, TRUE);
+       SetSwitch1F(bus->portnum, c->SN, ALL_LINES_OFF, 0, a, TRUE);
 
     /* Free up the serial number lists */
     if( c->num_main > 0 )
@@ -198,16 +234,113 @@ void free_coupler( int free_only )
       free( c->aux );
       
     /* Point to the next in the list */
-    coupler_top = c->next;
+    bus->coupler_top = c->next;
     
     /* Free up the current entry */
     free( c );
     
-    c = coupler_top;
+    c = bus->coupler_top;
   } /* Coupler free loop */
 
   /* Make sure its null */
-  coupler_top = NULL;
+  bus->coupler_top = NULL;
+}
+
+
+/* ----------------------------------------------------------------------- *
+   Set up an empty bus on adapter port portnum
+ * ----------------------------------------------------------------------- */
+void init_bus( struct _bus *bus, int portnum )
+{
+  bzero( bus, sizeof( struct _bus ) );
+  bus->portnum = portnum;
+  bus->power = POWER_UNKNOWN;
+}
+
+
+/* ----------------------------------------------------------------------- *
+   Free up the sensor lists and cached state of a bus, turning off its
+   couplers unless free_only is set
+ * ----------------------------------------------------------------------- */
+void free_bus( struct _bus *bus, int free_only )
+{
+  if( bus->sensor_list.roms != NULL )
+    free( bus->sensor_list.roms );
+  bus->sensor_list.roms = NULL;
+  bus->sensor_list.max = 0;
+
+  if( bus->coupler_top != NULL )
+    free_coupler( bus, free_only );
+  free_sensor_info( bus );
+
+  if( bus->out != NULL )
+    free( bus->out );
+  bus->out = NULL;
+  bus->out_len = bus->out_size = 0;
+}
+
+
+/* ----------------------------------------------------------------------- *
+   Number the sensors of all the buses one after the other, in the order
+   of their TTY lines
+
+   Returns the total number of sensors
+ * ----------------------------------------------------------------------- */
+int number_buses()
+{
+  int x,
+      first = 0;
+
+  for( x = 0; x < num_buses; x++ )
+  {
+    buses[x].first = first;
+    first += buses[x].sensor_list.max + buses[x].num_cs;
+  }
+
+  return first;
+}
+
+
+/* ----------------------------------------------------------------------- *
+   Find the bus a sensor number is on, and change sensor to the number
+   of the sensor on that bus. Numbers past the end go to the last bus.
+ * ----------------------------------------------------------------------- */
+struct _bus *find_bus( int *sensor )
+{
+  int x;
+
+  for( x = 0; x < num_buses - 1; x++ )
+  {
+    if( *sensor < buses[x+1].first )
+      break;
+  }
+  *sensor -= buses[x].first;
+
+  return &buses[x];
+}
+
+
+/* ----------------------------------------------------------------------- *
+   Free up all the buses and close the first num_open adapter ports
+ * ----------------------------------------------------------------------- */
+void close_buses( int num_open, int free_only )
+{
+  int  x;
+#ifdef OWUSB
+  char msg[1024];
+#endif
+
+  for( x = 0; x < num_buses; x++ )
+    free_bus( &buses[x], free_only );
+
+  for( x = 0; x < num_open; x++ )
+  {
+#ifndef OWUSB
+    owRelease( x );
+#else
+    owRelease( x, msg );
+#endif /* OWUSB */
+  }
 }
 
 
@@ -856,65 +989,567 @@ int test_build_af() {
 }
 
 
+/* -----------------------------------------------------------------------
+   Check that the compiled formats print the same thing as build_tf(),
+   build_cf() and build_af() followed by strftime(), and time both ways
+   ----------------------------------------------------------------------- */
+int test_format_prog()
+{
+  char   outbuf[1024],
+         newbuf[1024],
+         time_format[1024];
+  unsigned char sn[8] = { 0x01, 0x12, 0x23, 0x34, 0x45, 0x56, 0x67, 0x78 };
+  struct {
+    int  flavour;
+    char *format;
+  } fmt_test[] = {
+    { FMT_TEMPERATURE, "%b %d %H:%M:%S Sensor %s C: %.2C F: %.2F" },
+    { FMT_TEMPERATURE, "%b %d %H:%M:%S Sensor %s C: %.2C F: %.2F H: %h%%" },
+    { FMT_TEMPERATURE, "%N %R %3s %5.1C" },
+    { FMT_TEMPERATURE, "no tokens" },
+    { FMT_COUNTER,     "%b %d %H:%M:%S Sensor %s #%n %C" },
+    { FMT_COUNTER,     "%R %N %s %F %10C" },
+    { FMT_ADC,         "%b %d %H:%M:%S Sensor %s VDD: %0.2Q AD: %0.2q C: %0.2C" },
+    { FMT_ADC,         "%R %.04J %F %Y-%m-%d" }
+  };
+  struct _fmt_values values;
+  struct _fmt_prog   *prog;
+  struct timespec    start, end;
+  time_t             now = 1476177670;
+  long               old_ns, new_ns;
+  int                x, i, res, rc = 0,
+                     loops = 100000;
+
+  bzero( &values, sizeof(values) );
+  values.sensor = 3;
+  values.temp_c = 23.4375;
+  values.humidity = 45;
+  values.page = 1;
+  values.count = 123456;
+  values.vdd = 4.98;
+  values.ad = 2.56;
+  values.vsens = 0.1234;
+  values.sn = sn;
+
+  for( x = 0; x < sizeof(fmt_test) / sizeof(fmt_test[0]); x++ )
+  {
+    if( (prog = fmt_compile( fmt_test[x].format, fmt_test[x].flavour )) == NULL )
+    {
+      fprintf( stdout, "FAIL: Compiling '%s'\n", fmt_test[x].format );
+      rc = 1;
+      continue;
+    }
+
+    /* The old way, parse and strftime every time */
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for( i = 0; i < loops; i++ )
+    {
+      switch( fmt_test[x].flavour )
+      {
+        case FMT_TEMPERATURE:
+          build_tf( time_format, fmt_test[x].format, values.sensor,
+                    values.temp_c, values.humidity, sn );
+          break;
+        case FMT_COUNTER:
+          build_cf( time_format, fmt_test[x].format, values.sensor,
+                    values.page, values.count, sn );
+          break;
+        case FMT_ADC:
+          build_af( time_format, sizeof(time_format), fmt_test[x].format,
+                    values.sensor, values.temp_c, values.vdd, values.ad,
+                    values.vsens, sn );
+          break;
+      }
+      strftime( outbuf, sizeof(outbuf), time_format, localtime( &now ) );
+    }
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    old_ns = ((end.tv_sec - start.tv_sec) * 1000000000L +
+              (end.tv_nsec - start.tv_nsec)) / loops;
+
+    /* The compiled program */
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    for( i = 0; i < loops; i++ )
+    {
+      fmt_render( prog, newbuf, sizeof(newbuf), &values, now );
+    }
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    new_ns = ((end.tv_sec - start.tv_sec) * 1000000000L +
+              (end.tv_nsec - start.tv_nsec)) / loops;
+
+    res = (strcmp( outbuf, newbuf ) == 0);
+    rc = rc || !res;
+    fprintf( stdout, "%s: Compiled '%s', '%s'\n", res ? "PASS":"FAIL",
+             fmt_test[x].format, newbuf );
+    if( !res )
+      fprintf( stdout, "      expected '%s'\n", outbuf );
+    fprintf( stdout, "BENCH: '%s' old %ld nS new %ld nS per line\n",
+             fmt_test[x].format, old_ns, new_ns );
+
+    fmt_free( prog );
+  }
+
+  return rc;
+}
+
+
+/* -----------------------------------------------------------------------
+   Remember the time and the counters at the start of a --bench test
+   ----------------------------------------------------------------------- */
+void bench_start( struct _bench *bench )
+{
+  bzero( &bench->stats, sizeof( bench->stats ) );
+  bench->have_stats = adapter_stats( &bench->stats );
+  bench->log_bytes = log_bytes;
+  bench->log_syscalls = log_syscalls;
+  clock_gettime( CLOCK_MONOTONIC, &bench->start );
+}
+
+
+/* -----------------------------------------------------------------------
+   Print the results of a --bench test as one line of key=value pairs
+
+   Times, transactions, syscalls and bytes are per loop, transactions and
+   syscalls are also per sensor. The bus counters are -1 when the adapter
+   doesn't keep them.
+   ----------------------------------------------------------------------- */
+void bench_report( char *name, struct _bench *bench, int loops, int sensors )
+{
+  struct timespec       end;
+  struct _adapter_stats stats;
+  double                wall_us;
+  long                  syscalls;
+
+  clock_gettime( CLOCK_MONOTONIC, &end );
+  wall_us = (end.tv_sec - bench->start.tv_sec) * 1000000.0 +
+            (end.tv_nsec - bench->start.tv_nsec) / 1000.0;
+
+  if( loops < 1 )
+    loops = 1;
+  if( sensors < 1 )
+    sensors = 1;
+
+  printf( "BENCH test=%s loops=%d sensors=%d wall_us=%.1f", name, loops,
+          sensors, wall_us / loops );
+
+  syscalls = log_syscalls - bench->log_syscalls;
+  bzero( &stats, sizeof( stats ) );
+  if( bench->have_stats && adapter_stats( &stats ) )
+  {
+    syscalls += stats.syscalls - bench->stats.syscalls;
+    printf( " bus_us=%.0f delay_us=%.0f transactions_per_sensor=%.1f crc_errors=%ld",
+            (stats.bus_us - bench->stats.bus_us) / loops,
+            (stats.delay_us - bench->stats.delay_us) / loops,
+            (double) (stats.transactions - bench->stats.transactions) /
+            loops / sensors,
+            stats.crc_errors - bench->stats.crc_errors );
+  } else {
+    printf( " bus_us=-1 delay_us=-1 transactions_per_sensor=-1 crc_errors=-1" );
+  }
+
+  printf( " syscalls_per_sensor=%.2f log_bytes=%ld response_us=%.0f timeout_ms=%ld\n",
+          (double) syscalls / loops / sensors,
+          (log_bytes - bench->log_bytes) / loops,
+          stats.response_us, stats.timeout_ms );
+  fflush( stdout );
+}
+
+
+/* -----------------------------------------------------------------------
+   Show the adapter's counters and response time, for -v
+   ----------------------------------------------------------------------- */
+void show_adapter_stats()
+{
+  struct _adapter_stats stats;
+
+  bzero( &stats, sizeof( stats ) );
+  if( !adapter_stats( &stats ) )
+    return;
+
+  printf( "Adapter: %ld transactions, %ld syscalls, %.1f mS waiting",
+          stats.transactions, stats.syscalls, stats.bus_us / 1000 );
+  if( stats.timeout_ms > 0 )
+    printf( ", response %.2f mS, timeout %ld mS",
+            stats.response_us / 1000, stats.timeout_ms );
+  printf( "\n" );
+}
+
+
+/* -----------------------------------------------------------------------
+   Benchmark the search, read_buses() and the logging
+
+   Searches the buses with init_buses() and Walk1Wire(), reads every
+   sensor sweeps+1 times (the first sweep finds out how the sensors are
+   powered, so it is reported on its own) and then logs 1000 readings.
+   The results are printed by bench_report().
+
+   Returns 0 if everything ran, 1 if the search failed
+   ----------------------------------------------------------------------- */
+int run_bench( int sweeps )
+{
+  struct _bench bench;
+  unsigned char sn[8] = { 0x28, 0x6D, 0x1D, 0x2D, 0x00, 0x00, 0x00, 0xEA };
+  int           x,
+                sensors;
+
+  if( sweeps < 1 )
+    sweeps = 1;
+
+  bench_start( &bench );
+  if( init_buses() != 0 )
+    return 1;
+  sensors = number_buses();
+  bench_report( "init", &bench, 1, sensors );
+
+  bench_start( &bench );
+  for( x = 0; x < num_buses; x++ )
+    Walk1Wire( &buses[x] );
+  bench_report( "walk", &bench, 1, sensors );
+
+  bench_start( &bench );
+  read_buses();
+  log_flush( TRUE );
+  bench_report( "first_sweep", &bench, 1, sensors );
+
+  bench_start( &bench );
+  for( x = 0; x < sweeps; x++ )
+  {
+    read_buses();
+    log_flush( TRUE );
+  }
+  bench_report( "sweep", &bench, sweeps, sensors );
+
+  bench_start( &bench );
+  for( x = 0; x < 1000; x++ )
+  {
+    log_temp( &buses[0], x % sensors, 20.0 + x / 100.0, sn );
+    if( (x % sensors) == sensors - 1 )
+      log_flush( TRUE );
+  }
+  log_flush( -1 );
+  bench_report( "log", &bench, 1000, 1 );
+
+  return 0;
+}
+
+
+/* -----------------------------------------------------------------------
+   How many seconds the strftime tokens in the logfile name stay the same
+
+   The name only has to be worked out again when the time moves into a new
+   bucket of this size. 0 means there is no time in the name at all.
+   ----------------------------------------------------------------------- */
+int log_bucket_secs( char *fmt )
+{
+  int secs = 0;
+
+  for( ; *fmt; fmt++ )
+  {
+    if( *fmt != '%' )
+      continue;
+
+    /* Skip the E and O modifiers */
+    fmt++;
+    if( (*fmt == 'E') || (*fmt == 'O') )
+      fmt++;
+
+    switch( *fmt )
+    {
+      case 0:
+        return secs;
+
+      case '%':
+      case 'n':
+      case 't':
+        break;
+
+      case 'S':
+      case 's':
+      case 'T':
+      case 'c':
+      case 'r':
+      case 'X':
+      case '+':
+        return 1;
+
+      case 'M':
+      case 'R':
+        secs = 60;
+        break;
+
+      case 'H':
+      case 'I':
+      case 'k':
+      case 'l':
+      case 'p':
+      case 'P':
+        if( (secs == 0) || (secs > 3600) )
+          secs = 3600;
+        break;
+
+      default:
+        /* Days, weeks, months and years all change at midnight */
+        if( secs == 0 )
+          secs = 86400;
+        break;
+    }
+  }
+
+  return secs;
+}
+
+
+/* -----------------------------------------------------------------------
+   Make sure the logfile for the current time is open
+
+   The name is only run through strftime when the time bucket changes,
+   and the file is only reopened when the name is different. The size of
+   the bucket is worked out once for each log_file.
+   ----------------------------------------------------------------------- */
+int log_open( time_t now )
+{
+  char   path[1024];
+  long   bucket;
+
+  if( log_secs < 0 )
+    log_secs = log_bucket_secs( log_file );
+  bucket = log_secs ? (long) (now / log_secs) : 0;
+
+  if( (log_fd != -1) && (bucket == log_bucket) )
+    return 0;
+
+  /* Update the logfile name according to current time and logfile format */
+  strftime( path, sizeof(path) - 1, log_file, gmtime( &now ) );
+  log_bucket = bucket;
+
+  if( (log_fd != -1) && (strcmp( path, log_path ) == 0) )
+    return 0;
+
+  /* Whatever is in the buffer belongs in the old file */
+  log_close();
+
+  if( (log_fd = open( path, O_CREAT | O_WRONLY | O_APPEND,
+                      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH ) ) == -1 )
+  {
+    printf("Error opening logfile: %s\n", path );
+    log_bucket = -1;
+    return -1;
+  }
+  log_syscalls++;
+  strcpy( log_path, path );
+  log_synced = now;
+
+  return 0;
+}
+
+
+/* -----------------------------------------------------------------------
+   Write out the buffered log lines
+
+   sweep is TRUE at the end of a sample, which flushes when LOG_FLUSH is 0.
+   Otherwise the buffer is only written when it holds LOG_FLUSH lines. Set
+   sweep to -1 to write it no matter what. The file is fsync'ed every
+   LOG_FSYNC seconds.
+   ----------------------------------------------------------------------- */
+int log_flush( int sweep )
+{
+  int    x,
+         len;
+  time_t now;
+
+  if( log_len == 0 )
+    return 0;
+
+  if( sweep != -1 )
+  {
+    if( (log_flush_records == 0) && !sweep )
+      return 0;
+    if( (log_flush_records > 0) && (log_records < log_flush_records) )
+      return 0;
+  }
+
+  if( log_fd == -1 )
+  {
+    /* Couldn't open it, the lines are lost */
+    log_len = log_records = 0;
+    return -1;
+  }
+
+  for( x = 0; x < log_len; x += len )
+  {
+    if( (len = write( log_fd, &log_buf[x], log_len - x )) == -1 )
+    {
+      if( errno == EINTR )
+      {
+        len = 0;
+        continue;
+      }
+      perror("Error loging to logfile");
+      break;
+    }
+    log_bytes += len;
+    log_syscalls++;
+  }
+  log_len = log_records = 0;
+
+  if( log_fsync > 0 )
+  {
+    now = time(NULL);
+    if( now - log_synced >= log_fsync )
+    {
+      fsync( log_fd );
+      log_syscalls++;
+      log_synced = now;
+    }
+  }
+
+  return 0;
+}
+
+
+/* -----------------------------------------------------------------------
+   Write out anything that is left and close the logfile
+   ----------------------------------------------------------------------- */
+void log_close()
+{
+  if( log_fd == -1 )
+    return;
+
+  log_flush( -1 );
+  if( log_fsync > 0 )
+  {
+    fsync( log_fd );
+    log_syscalls++;
+  }
+  close( log_fd );
+  log_syscalls++;
+  log_fd = -1;
+  log_bucket = -1;
+}
+
+
 /* -----------------------------------------------------------------------
    Print a string to the console or the logfile
+
+   The logfile stays open and the output is buffered, see log_flush()
    ----------------------------------------------------------------------- */
 int log_string( char *line )
 {
-  int fd=0;
-  char time_log_file[1024];
+  int    len;
+  char   *ptr;
 
   if( log_file[0] != 0 )
   {
-    time_t now = time(NULL);
+    if( log_open( time(NULL) ) < 0 )
+      return -1;
 
-    /* Update time_log_file name according to current time and logfile format */
-    strftime(time_log_file, sizeof(log_file) - 1, log_file, gmtime(&now));
+    len = strlen( line );
+    if( log_len + len > sizeof(log_buf) )
+      log_flush( -1 );
 
-    if( (fd = open( time_log_file, O_CREAT | O_WRONLY | O_APPEND,
-                          S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH ) ) == -1 )
+    if( len > sizeof(log_buf) )
     {
-      printf("Error opening logfile: %s\n", time_log_file );
-      return -1;
+      /* Too big to buffer, write it straight out */
+      if( write( log_fd, line, len ) == -1 )
+        perror("Error loging to logfile");
+      else
+        log_bytes += len;
+      log_syscalls++;
+      return 0;
     }
-    if( write( fd, line, strlen( line ) ) == -1)
-      perror("Error loging to logfile");
-    close( fd );
+    memcpy( &log_buf[log_len], line, len );
+    log_len += len;
+
+    for( ptr = line; (ptr = strchr( ptr, '\n' )) != NULL; ptr++ )
+      log_records++;
+
+    log_flush( FALSE );
   } else {
     printf( "%s", line );
     fflush( stdout );
+    log_bytes += strlen( line );
+    log_syscalls++;
   }
   return 0;
 }  
 
 
+/* -----------------------------------------------------------------------
+   Output from a bus
+
+   A bus that is swept on its own thread collects its output, main() logs
+   it in bus order once all of the buses are done. Otherwise it goes
+   straight to log_string().
+   ----------------------------------------------------------------------- */
+int bus_string( struct _bus *bus, char *line )
+{
+  char   *out;
+  int    len,
+         size;
+
+  if( !bus->threaded )
+    return log_string( line );
+
+  len = strlen( line );
+  if( bus->out_len + len + 1 > bus->out_size )
+  {
+    size = bus->out_size ? bus->out_size : LOG_BUF_SIZE;
+    while( bus->out_len + len + 1 > size )
+      size *= 2;
+    if( (out = realloc( bus->out, size )) == NULL )
+    {
+      fprintf( stderr, "Failed to allocate %d bytes for bus output\n", size );
+      return -1;
+    }
+    bus->out = out;
+    bus->out_size = size;
+  }
+  memcpy( &bus->out[bus->out_len], line, len+1 );
+  bus->out_len += len;
+
+  return 0;
+}
+
+
 /* -----------------------------------------------------------------------
    Log one line of text to the logfile with the current date and time
 
    Used with temperatures
    ----------------------------------------------------------------------- */
-int log_temp( int sensor, float temp_c, unsigned char *sn )
+int log_temp( struct _bus *bus, int sensor, float temp_c, unsigned char *sn )
 {
   char	temp[1024],
   	time_format[160];
   time_t	mytime;
+  struct _fmt_values values;
 
 
   mytime = time(NULL);
   if( mytime )
   {
-    /* Build the time format string from log_format */
-    build_tf( time_format, temp_format, sensor, temp_c, -1, sn );
+    pthread_mutex_lock( &fmt_lock );
+    if( temp_prog != NULL )
+    {
+      bzero( &values, sizeof(values) );
+      values.sensor = bus->first + sensor;
+      values.temp_c = temp_c;
+      values.humidity = -1;
+      values.sn = sn;
+      fmt_render( temp_prog, temp, sizeof(temp)-1, &values, mytime );
+    } else {
+      /* Build the time format string from log_format */
+      build_tf( time_format, temp_format, bus->first + sensor, temp_c, -1, sn );
 
-    /* Handle the time format tokens */
-    strftime( temp, 1024, time_format, localtime( &mytime ) );
+      /* Handle the time format tokens */
+      strftime( temp, 1024, time_format, localtime( &mytime ) );
+    }
+    pthread_mutex_unlock( &fmt_lock );
 
     strcat( temp, "\n" );
   } else {
     sprintf( temp, "Time Error\n" );
   }
   /* Log it to stdout, logfile or both */
-  log_string( temp );
+  bus_string( bus, temp );
 
   return 0;
 }
@@ -925,28 +1560,41 @@ int log_temp( int sensor, float temp_c, unsigned char *sn )
 
    Used with counters
    ----------------------------------------------------------------------- */
-int log_counter( int sensor, int page, unsigned long counter, unsigned char *sn )
+int log_counter( struct _bus *bus, int sensor, int page, unsigned long counter, unsigned char *sn )
 {
   char	temp[1024],
   	time_format[160];
   time_t	mytime;
+  struct _fmt_values values;
 
 
   mytime = time(NULL);
   if( mytime )
   {
-    /* Build the time format string from counter_format */
-    build_cf( time_format, counter_format, sensor, page, counter, sn );
+    pthread_mutex_lock( &fmt_lock );
+    if( counter_prog != NULL )
+    {
+      bzero( &values, sizeof(values) );
+      values.sensor = bus->first + sensor;
+      values.page = page;
+      values.count = counter;
+      values.sn = sn;
+      fmt_render( counter_prog, temp, sizeof(temp)-1, &values, mytime );
+    } else {
+      /* Build the time format string from counter_format */
+      build_cf( time_format, counter_format, bus->first + sensor, page, counter, sn );
 
-    /* Handle the time format tokens */
-    strftime( temp, 1024, time_format, localtime( &mytime ) );
+      /* Handle the time format tokens */
+      strftime( temp, 1024, time_format, localtime( &mytime ) );
+    }
+    pthread_mutex_unlock( &fmt_lock );
 
     strcat( temp, "\n" );
   } else {
     sprintf( temp, "Time Error\n" );
   }
   /* Log it to stdout, logfile or both */
-  log_string( temp );
+  bus_string( bus, temp );
 
   return 0;
 }
@@ -957,11 +1605,12 @@ int log_counter( int sensor, int page, unsigned long counter, unsigned char *sn
 
    Used with temperatures
    ----------------------------------------------------------------------- */
-int log_humidity( int sensor, double temp_c, int humidity, unsigned char *sn )
+int log_humidity( struct _bus *bus, int sensor, double temp_c, int humidity, unsigned char *sn )
 {
   char	temp[1024],
   	time_format[160];
   time_t	mytime;
+  struct _fmt_values values;
 
 
   mytime = time(NULL);
@@ -981,11 +1630,23 @@ int log_humidity( int sensor, double temp_c, int humidity, unsigned char *sn )
                   break;
 
       default:
-                  /* Build the time format string from log_format */
-                  build_tf( time_format, humidity_format, sensor, temp_c, humidity, sn );
+                  pthread_mutex_lock( &fmt_lock );
+                  if( humidity_prog != NULL )
+                  {
+                    bzero( &values, sizeof(values) );
+                    values.sensor = bus->first + sensor;
+                    values.temp_c = temp_c;
+                    values.humidity = humidity;
+                    values.sn = sn;
+                    fmt_render( humidity_prog, temp, sizeof(temp)-1, &values, mytime );
+                  } else {
+                    /* Build the time format string from log_format */
+                    build_tf( time_format, humidity_format, bus->first + sensor, temp_c, humidity, sn );
 
-                  /* Handle the time format tokens */
-                  strftime( temp, 1024, time_format, localtime( &mytime ) );
+                    /* Handle the time format tokens */
+                    strftime( temp, 1024, time_format, localtime( &mytime ) );
+                  }
+                  pthread_mutex_unlock( &fmt_lock );
 
                   strcat( temp, "\n" );
                   break;
@@ -994,7 +1655,7 @@ int log_humidity( int sensor, double temp_c, int humidity, unsigned char *sn )
     sprintf( temp, "Time Error\n" );
   }
   /* Log it to stdout, logfile or both */
-  log_string( temp );
+  bus_string( bus, temp );
 
   return 0;
 }
@@ -1005,13 +1666,14 @@ int log_humidity( int sensor, double temp_c, int humidity, unsigned char *sn )
 
    Used with temperature and voltage values from DS2438
    ----------------------------------------------------------------------- */
-int log_temperature_voltage( int sensor, double temp_c,
+int log_temperature_voltage( struct _bus *bus, int sensor, double temp_c,
                              float vdd, float ad, float vsens,
                              unsigned char *sn )
 {
   char	temp[1024],
         time_format[160];
   time_t mytime;
+  struct _fmt_values values;
 
   mytime = time(NULL);
   if( mytime )
@@ -1031,12 +1693,25 @@ int log_temperature_voltage( int sensor, double temp_c,
         sprintf( temp, "\t%3.2f", c2f(temp_c) );
         break;
       default:
-        /* Build the time format string from log_format */
-        build_af( time_format, sizeof(time_format), adc_format,
-                  sensor, temp_c, vdd, ad, vsens, sn );
+        pthread_mutex_lock( &fmt_lock );
+        if( adc_prog != NULL ) {
+          bzero( &values, sizeof(values) );
+          values.sensor = bus->first + sensor;
+          values.temp_c = temp_c;
+          values.vdd = vdd;
+          values.ad = ad;
+          values.vsens = vsens;
+          values.sn = sn;
+          fmt_render( adc_prog, temp, sizeof(temp)-1, &values, mytime );
+        } else {
+          /* Build the time format string from log_format */
+          build_af( time_format, sizeof(time_format), adc_format,
+                    bus->first + sensor, temp_c, vdd, ad, vsens, sn );
 
-        /* Handle the time format tokens */
-        strftime( temp, 1024, time_format, localtime( &mytime ) );
+          /* Handle the time format tokens */
+          strftime( temp, 1024, time_format, localtime( &mytime ) );
+        }
+        pthread_mutex_unlock( &fmt_lock );
 
         strcat( temp, "\n" );
         break;
@@ -1045,7 +1720,7 @@ int log_temperature_voltage( int sensor, double temp_c,
     sprintf( temp, "Time Error\n" );
   }
   /* Log it to stdout, logfile or both */
-  log_string( temp );
+  bus_string( bus, temp );
 
   return 0;
 }
@@ -1081,7 +1756,7 @@ int cmpSN( unsigned char *sn1, unsigned char *sn2, int branch )
 /* -----------------------------------------------------------------------
    Show the verbose contents of the scratchpad
    ----------------------------------------------------------------------- */
-void show_scratchpad( unsigned char *scratchpad, int sensor_family )
+void show_scratchpad( struct _bus *bus, unsigned char *scratchpad, int sensor_family )
 {
   char temp[80];
   int i;
@@ -1091,36 +1766,36 @@ void show_scratchpad( unsigned char *scratchpad, int sensor_family )
   {
     case DS1820_FAMILY:
       sprintf( temp, "  Temperature   : 0x%02X\n", scratchpad[1] );
-      log_string( temp );
+      bus_string( bus, temp );
       sprintf( temp, "  Sign          : 0x%02X\n", scratchpad[2] );
-      log_string( temp );
+      bus_string( bus, temp );
       sprintf( temp, "  TH            : 0x%02X\n", scratchpad[3] );
-      log_string( temp );
+      bus_string( bus, temp );
       sprintf( temp, "  TL            : 0x%02X\n", scratchpad[4] );
-      log_string( temp );
+      bus_string( bus, temp );
       sprintf( temp, "  Remain        : 0x%02X\n", scratchpad[7] );
-      log_string( temp );
+      bus_string( bus, temp );
       sprintf( temp, "  Count Per C   : 0x%02X\n", scratchpad[8] );
-      log_string( temp );
+      bus_string( bus, temp );
       sprintf( temp, "  CRC           : 0x%02X\n", scratchpad[9] );
-      log_string( temp );
+      bus_string( bus, temp );
       break;
   
     case DS18B20_FAMILY:
     case DS1822_FAMILY:
     case DS28EA00_FAMILY:
       sprintf( temp, "  Temp. LSB     : 0x%02X\n", scratchpad[1] );
-      log_string( temp );
+      bus_string( bus, temp );
       sprintf( temp, "  Temp. MSB     : 0x%02X\n", scratchpad[2] );
-      log_string( temp );
+      bus_string( bus, temp );
       sprintf( temp, "  TH            : 0x%02X\n", scratchpad[3] );
-      log_string( temp );
+      bus_string( bus, temp );
       sprintf( temp, "  TL            : 0x%02X\n", scratchpad[4] );
-      log_string( temp );
+      bus_string( bus, temp );
       sprintf( temp, "  Config Reg.   : 0x%02X\n", scratchpad[5] );
-      log_string( temp );
+      bus_string( bus, temp );
       sprintf( temp, "  CRC           : 0x%02X\n", scratchpad[9] );
-      log_string( temp );
+      bus_string( bus, temp );
       break;
       
     case DS2422_FAMILY:
@@ -1139,14 +1814,413 @@ void show_scratchpad( unsigned char *scratchpad, int sensor_family )
 
 
 /* -----------------------------------------------------------------------
-   Read the temperature from one sensor
+   Return the cached state for a sensor number, growing the list as needed
 
-   Return the high-precision temperature value
+   New entries are zeroed, so everything starts out unknown.
+   ----------------------------------------------------------------------- */
+struct _sensor_info *get_sensor_info( struct _bus *bus, int sensor )
+{
+  struct _sensor_info *info;
+  int                 x;
 
-   Calculated using formula from DS1820 datasheet
+  if( sensor < 0 )
+    return NULL;
 
-   Temperature   = scratchpad[1]
-   Sign          = scratchpad[2]
+  if( sensor >= bus->sensor_info_max )
+  {
+    if( (info = realloc( bus->sensor_info, (sensor+1) * sizeof( struct _sensor_info ) ) ) == NULL )
+    {
+      fprintf( stderr, "Failed to allocate %d bytes for sensor_info\n",
+               (int) ((sensor+1) * sizeof( struct _sensor_info )) );
+      return NULL;
+    }
+    bzero( &info[bus->sensor_info_max],
+           (sensor+1-bus->sensor_info_max) * sizeof( struct _sensor_info ) );
+
+    /* Not planned yet, so it is read in the current sweep */
+    for( x = bus->sensor_info_max; x <= sensor; x++ )
+      info[x].due = TRUE;
+    bus->sensor_info = info;
+    bus->sensor_info_max = sensor+1;
+  }
+
+  return &bus->sensor_info[sensor];
+}
+
+
+/* -----------------------------------------------------------------------
+   Get the cached state for the sensor number ptr from a line of the rc
+   file, keyword and line are for the error message
+
+   Returns NULL if it isn't a number from 0 to MAX_RC_SENSOR
+   ----------------------------------------------------------------------- */
+struct _sensor_info *rc_sensor_info( struct _bus *bus, char *ptr, char *keyword, int line )
+{
+  char *end;
+  long sensor = -1;
+
+  if( ptr != NULL )
+    sensor = strtol( ptr, &end, 0 );
+
+  if( (ptr == NULL) || (end == ptr) || (*end != 0) ||
+      (sensor < 0) || (sensor > MAX_RC_SENSOR) )
+  {
+    fprintf( stderr, "Error, %s on line %d: sensor %s is not 0 to %d\n",
+             keyword, line, ptr ? ptr : "(none)", MAX_RC_SENSOR );
+    return NULL;
+  }
+
+  return get_sensor_info( bus, sensor );
+}
+
+
+/* -----------------------------------------------------------------------
+   Forget all the cached sensor state (sensor numbers are changing)
+   ----------------------------------------------------------------------- */
+void free_sensor_info( struct _bus *bus )
+{
+  if( bus->sensor_info != NULL )
+    free( bus->sensor_info );
+  bus->sensor_info = NULL;
+  bus->sensor_info_max = 0;
+  bus->power = POWER_UNKNOWN;
+}
+
+
+/* -----------------------------------------------------------------------
+   Move the cached sensor settings to the new sensor numbers after a
+   search of the bus. The SN of each old entry must already be filled in.
+   ----------------------------------------------------------------------- */
+void renumber_sensor_info( struct _bus *bus )
+{
+  struct _roms        *sensor_list = &bus->sensor_list;
+  struct _sensor_info *old_info, *info;
+  unsigned char       *sn;
+  int                 old_max, x, y;
+
+  old_info = bus->sensor_info;
+  old_max = bus->sensor_info_max;
+  bus->sensor_info = NULL;
+  bus->sensor_info_max = 0;
+  bus->power = POWER_UNKNOWN;
+
+  for( x = 0; x < sensor_list->max + bus->num_cs; x++ )
+  {
+    if( (sn = get_sensor_sn( bus, x )) == NULL )
+      continue;
+
+    for( y = 0; y < old_max; y++ )
+    {
+      if( (old_info[y].resolution || old_info[y].interval) &&
+          (memcmp( old_info[y].SN, sn, 8 ) == 0) )
+      {
+        if( (info = get_sensor_info( bus, x )) != NULL )
+        {
+          info->resolution = old_info[y].resolution;
+          info->interval = old_info[y].interval;
+        }
+        break;
+      }
+    }
+  }
+
+  if( old_info != NULL )
+    free( old_info );
+}
+
+
+/* -----------------------------------------------------------------------
+   Return a pointer to the serial number of a sensor number, or NULL if
+   there is no such sensor.
+   ----------------------------------------------------------------------- */
+unsigned char *get_sensor_sn( struct _bus *bus, int sensor )
+{
+  struct _roms    *sensor_list = &bus->sensor_list;
+  struct _coupler *c_ptr;
+  int             s;
+
+  if( sensor < 0 )
+    return NULL;
+
+  if( sensor < sensor_list->max )
+    return &sensor_list->roms[sensor*8];
+
+  s = sensor - sensor_list->max;
+  c_ptr = bus->coupler_top;
+  while( c_ptr )
+  {
+    if( s < c_ptr->num_main )
+      return &c_ptr->main[s*8];
+    s -= c_ptr->num_main;
+
+    if( s < c_ptr->num_aux )
+      return &c_ptr->aux[s*8];
+    s -= c_ptr->num_aux;
+
+    c_ptr = c_ptr->next;
+  }
+
+  return NULL;
+}
+
+
+/* -----------------------------------------------------------------------
+   Find out how the selected sensor is powered using Read Power Supply
+
+   Parasite powered devices pull the bus low during the read slot. With
+   skip_rom set all the devices on the segment are asked at once, so it
+   returns POWER_EXTERNAL only if none of them are parasite powered.
+   ----------------------------------------------------------------------- */
+int read_power_supply( struct _bus *bus, int skip_rom )
+{
+  if( skip_rom )
+  {
+    if( !owTouchReset(bus->portnum) || !owWriteByte( bus->portnum, 0xCC ) )
+      return POWER_UNKNOWN;
+  } else {
+    if( !owAccess(bus->portnum) )
+      return POWER_UNKNOWN;
+  }
+
+  /* Read Power Supply */
+  if( !owWriteByte( bus->portnum, 0xB4 ) )
+    return POWER_UNKNOWN;
+
+  if( owTouchBit( bus->portnum, 1 ) )
+    return POWER_EXTERNAL;
+
+  return POWER_PARASITE;
+}
+
+
+/* -----------------------------------------------------------------------
+   Set the resolution of the selected DS18B20, DS1822 or DS28EA00
+
+   Reads the scratchpad first so that TH and TL are preserved, and only
+   writes the config register (and copies it to EEPROM) when it is
+   different from the requested resolution.
+   ----------------------------------------------------------------------- */
+int set_resolution( struct _bus *bus, int sensor_family, int power, int resolution )
+{
+  unsigned char scratchpad[10],
+                config,
+                lastcrc8 = 0;
+  int           j;
+
+  if( (resolution < 9) || (resolution > 12) )
+    return FALSE;
+
+  /* R1 and R0 are bits 6 and 5 of the config register */
+  config = ((resolution - 9) << 5) | 0x1F;
+
+  /* Read the current TH, TL and config register */
+  if( !owAccess(bus->portnum) )
+    return FALSE;
+
+  scratchpad[0] = 0xBE;
+  for( j = 1; j < 10; j++ )
+    scratchpad[j] = 0xFF;
+
+  if( !owBlock( bus->portnum, FALSE, scratchpad, 10 ) )
+    return FALSE;
+
+  setcrc8(bus->portnum, 0);
+  for( j = 1; j < 10; j++ )
+    lastcrc8 = docrc8( bus->portnum, scratchpad[j] );
+
+  if( lastcrc8 != 0x00 )
+    return FALSE;
+
+  /* Already set? Don't wear out the EEPROM */
+  if( scratchpad[5] == config )
+    return TRUE;
+
+  /* Write Scratchpad, TH, TL and config */
+  if( !owAccess(bus->portnum) )
+    return FALSE;
+
+  scratchpad[0] = 0x4E;
+  scratchpad[1] = scratchpad[3];
+  scratchpad[2] = scratchpad[4];
+  scratchpad[3] = config;
+
+  if( !owBlock( bus->portnum, FALSE, scratchpad, 4 ) )
+    return FALSE;
+
+  /* Copy Scratchpad to EEPROM, takes up to 10mS */
+  if( !owAccess(bus->portnum) )
+    return FALSE;
+
+  if( power == POWER_EXTERNAL )
+  {
+    if( !owWriteByte( bus->portnum, 0x48 ) )
+      return FALSE;
+    msDelay( 10 );
+  } else {
+    if( !owWriteBytePower( bus->portnum, 0x48 ) )
+      return FALSE;
+    msDelay( 10 );
+    owLevel( bus->portnum, MODE_NORMAL );
+  }
+
+  return TRUE;
+}
+
+
+/* -----------------------------------------------------------------------
+   Apply the RESOLUTION setting to the selected sensor, if it has one and
+   it hasn't been done yet.
+   ----------------------------------------------------------------------- */
+int setup_sensor( struct _bus *bus, int sensor_family, int sensor, int power )
+{
+  struct _sensor_info *info;
+
+  if( (info = get_sensor_info( bus, sensor )) == NULL )
+    return FALSE;
+
+  if( !info->resolution || info->resolution_set )
+    return TRUE;
+
+  switch( sensor_family )
+  {
+    case DS1822_FAMILY:
+    case DS18B20_FAMILY:
+    case DS28EA00_FAMILY:
+      if( !set_resolution( bus, sensor_family, power, info->resolution ) )
+      {
+        fprintf( stderr, "Setting sensor %d to %d bits failed\n",
+                 bus->first + sensor, info->resolution );
+        return FALSE;
+      }
+      break;
+
+    default:
+      fprintf( stderr, "Sensor %d doesn't support RESOLUTION\n",
+               bus->first + sensor );
+      break;
+  }
+  info->resolution_set = TRUE;
+
+  return TRUE;
+}
+
+
+/* -----------------------------------------------------------------------
+   How long a sensor takes to do a temperature conversion in mS
+
+   Sensors with a RESOLUTION setting use the datasheet maximum for that
+   resolution, everything else uses read_time.
+   ----------------------------------------------------------------------- */
+int conversion_time( struct _bus *bus, int sensor_family, int sensor )
+{
+  static int res_time[4] = { 94, 188, 375, 750 };
+  struct _sensor_info *info;
+
+  switch( sensor_family )
+  {
+    case DS1822_FAMILY:
+    case DS18B20_FAMILY:
+    case DS28EA00_FAMILY:
+      if( ((info = get_sensor_info( bus, sensor )) != NULL) &&
+          info->resolution_set &&
+          (info->resolution >= 9) && (info->resolution <= 12) )
+      {
+        return res_time[info->resolution - 9];
+      }
+      break;
+  }
+
+  return read_time;
+}
+
+
+/* -----------------------------------------------------------------------
+   Wait for a temperature conversion to finish
+
+   Externally powered sensors return 0 in read slots until the conversion
+   is done, so poll the bus instead of sleeping for the whole msec.
+   Parasite powered sensors need the strong pullup for the full msec,
+   so the caller must have sent Convert T with owWriteBytePower().
+
+   Returns FALSE if the conversion didn't finish within msec
+   ----------------------------------------------------------------------- */
+int wait_conversion( struct _bus *bus, int power, int msec )
+{
+  long start;
+
+  if( power == POWER_EXTERNAL )
+  {
+    start = msGettick();
+    while( !owTouchBit( bus->portnum, 1 ) )
+    {
+      if( (msGettick() - start) > msec )
+        return FALSE;
+    }
+    return TRUE;
+  }
+
+  /* Sleep for conversion second */
+  msDelay( msec );
+
+  /* Turn off the strong pullup */
+  owLevel( bus->portnum, MODE_NORMAL );
+
+  return TRUE;
+}
+
+
+/* -----------------------------------------------------------------------
+   Read the scratchpad of the selected DS18x20 into scratchpad[1-9]
+
+   A CRC error only means that the read was corrupted, the conversion
+   result in the sensor is still good. So re-read it up to read_tries
+   times before giving up and letting the caller convert again.
+   ----------------------------------------------------------------------- */
+int read_scratchpad( struct _bus *bus, unsigned char *scratchpad, int sensor_family )
+{
+  unsigned char lastcrc8 = 0;
+  int           j,
+                try;
+
+  for( try = 0; try < read_tries; try++ )
+  {
+    /* Build a block for the Scratchpad read */
+    scratchpad[0] = 0xBE;
+    for( j = 1; j < 10; j++ )
+      scratchpad[j] = 0xFF;
+
+    /* Select the sensor and send the block in one transaction */
+    if( !owAccessBlock( bus->portnum, FALSE, scratchpad, 10 ) )
+      continue;
+
+    /* Calculate the CRC 8 checksum on the received data */
+    setcrc8(bus->portnum, 0);
+    for( j = 1; j < 10; j++ )
+      lastcrc8 = docrc8( bus->portnum, scratchpad[j] );
+
+    if( lastcrc8 == 0x00 )
+      return TRUE;
+
+    fprintf( stderr, "CRC Failed. CRC is %02X instead of 0x00\n", lastcrc8 );
+    if( opts & OPT_VERBOSE )
+    {
+      show_scratchpad( bus, scratchpad, sensor_family );
+    } /* if OPT_VERBOSE */
+  }
+
+  return FALSE;
+}
+
+
+/* -----------------------------------------------------------------------
+   Read the temperature from one sensor
+
+   Return the high-precision temperature value
+
+   Calculated using formula from DS1820 datasheet
+
+   Temperature   = scratchpad[1]
+   Sign          = scratchpad[2]
    TH            = scratchpad[3]
    TL            = scratchpad[4]
    Count Remain  = scratchpad[7]
@@ -1160,180 +2234,168 @@ void show_scratchpad( unsigned char *scratchpad, int sensor_family )
    If Sign is not 0x00 then it is a negative (Centigrade) number, and
    the temperature must be subtracted from 0x100 and multiplied by -1
    ----------------------------------------------------------------------- */
-int read_temperature( int sensor_family, int sensor )
+int read_temperature( struct _bus *bus, int sensor_family, int sensor )
 {
   char    temp[1024];              /* For output string                    */
-  unsigned char lastcrc8,
-                scratchpad[30],    /* Scratchpad block from the sensor     */
+  unsigned char scratchpad[30],    /* Scratchpad block from the sensor     */
                 TempSN[8];
-  int     j,
-          try,                     /* Number of tries at reading device    */
+  int     try,                     /* Number of conversions tried          */
           ds1820_try,              /* Allow ds1820 glitch 1 time           */
-          ds18s20_try;             /* Allow DS18S20 error 1 time           */
+          ds18s20_try,             /* Allow DS18S20 error 1 time           */
+          power;                   /* How the sensor is powered            */
+  struct _sensor_info *info;
   float   temp_c,                  /* Calculated temperature in Centigrade */
           hi_precision;
 
   ds1820_try = 0;
   ds18s20_try = 0;  
   temp_c = 0;
+
+  /* Find out how it is powered the first time it is read */
+  power = POWER_UNKNOWN;
+  if( (info = get_sensor_info( bus, sensor )) != NULL )
+  {
+    if( info->power == POWER_UNKNOWN )
+      info->power = read_power_supply( bus, FALSE );
+    power = info->power;
+  }
+
+  /* Set its resolution, if it has one in the rc file */
+  setup_sensor( bus, sensor_family, sensor, power );
   
-  for( try = 0; try < MAX_READ_TRIES; try++ )
+  for( try = 0; try < convert_tries; try++ )
   {
-    if( owAccess(0) )
+    /* The first try can use the broadcast conversion from read_all() */
+    if( (try > 0) || !bus->converted )
     {
-      /* Convert Temperature */
-      if( !owWriteBytePower( 0, 0x44 ) )
+      /* Convert Temperature, parasite power needs the strong pullup */
+      scratchpad[0] = 0x44;
+      if( !owAccessBlock( bus->portnum, power != POWER_EXTERNAL, scratchpad, 1 ) )
       {
-        return FALSE;
+        /* Failed to select it, reset the network, delay and try again */
+        owTouchReset(bus->portnum);
+        msDelay( read_time );
+        continue;
       }
 
-      /* Sleep for conversion second */
-      msDelay( read_time );
-      
-      /* Turn off the strong pullup */
-      owLevel( 0, MODE_NORMAL );
+      if( !wait_conversion( bus, power, conversion_time( bus, sensor_family, sensor ) ) )
+      {
+        /* Conversion timed out, reset the network and try again */
+        owTouchReset(bus->portnum);
+        continue;
+      }
+    }
+
+    /* Read the scratchpad, CRC errors are re-read before converting again */
+    if( !read_scratchpad( bus, scratchpad, sensor_family ) )
+    {
+      owTouchReset(bus->portnum);
+      continue;
+    }
+
+    /* DS1822 and DS18B20 use a different calculation */
+    if( (sensor_family == DS18B20_FAMILY) ||
+        (sensor_family == DS1822_FAMILY) ||
+        (sensor_family == DS28EA00_FAMILY) ||
+        (sensor_family == DS1923_FAMILY) )
+    {
+      short int temp2 = (scratchpad[2] << 8) | scratchpad[1];
+      temp_c = temp2 / 16.0;
+    }
 
-      /* Now read the scratchpad from the device */
-      if( owAccess(0) )
+    /* Handle the DS1820 and DS18S20 */
+    if( sensor_family == DS1820_FAMILY )
+    {
+      /* Check for DS1820 glitch condition */
+      /* COUNT_PER_C - COUNT_REMAIN == 1 */
+      if( ds1820_try == 0 )
+      {
+        if( (scratchpad[7] - scratchpad[6]) == 1 )
+        {
+          ds1820_try = 1;
+          continue;
+        } /* DS1820 error */
+      } /* ds1820_try */
+    
+      /* Check for DS18S20 Error condition */
+      /*  LSB = 0xAA
+          MSB = 0x00
+          COUNT_REMAIN = 0x0C
+          COUNT_PER_C = 0x10
+      */
+      if( ds18s20_try == 0 )
       {
-/* Use Read_Scratchpad instead? */
-        /* Build a block for the Scratchpad read */
-        scratchpad[0] = 0xBE;
-        for( j = 1; j < 10; j++ )
-          scratchpad[j] = 0xFF;
-
-        /* Send the block */
-        if( owBlock( 0, FALSE, scratchpad, 10 ) )
+        if( (scratchpad[4]==0xAA) &&
+            (scratchpad[3]==0x00) &&
+            (scratchpad[7]==0x0C) &&
+            (scratchpad[8]==0x10)
+          )
         {
-          /* Calculate the CRC 8 checksum on the received data */
-          setcrc8(0, 0);
-          for( j = 1; j < 10; j++ )
-            lastcrc8 = docrc8( 0, scratchpad[j] );
+          ds18s20_try = 1;
+          continue;
+        } /* DS18S20 error condition */
+      } /* ds18s20_try */
+  
+      /* Convert data to temperature */
+      if( scratchpad[2] == 0 )
+      {
+        temp_c = (int) scratchpad[1] >> 1;
+      } else {
+        temp_c = -1 * (int) (0x100-scratchpad[1]) >> 1;
+      } /* Negative temp calculation */
+      temp_c -= 0.25;
+      hi_precision = (int) scratchpad[8] - (int) scratchpad[7];
+      hi_precision = hi_precision / (int) scratchpad[8];
+      temp_c = temp_c + hi_precision;
+    } /* DS1820_FAMILY */
+    
+    /* Log the temperature */
+    switch( log_type )
+    {
+      /* Multiple Centigrade temps per line */
+      case 2:
+      case 4:     sprintf( temp, "\t%3.2f", temp_c );
+                  bus_string( bus, temp );
+                  break;
 
-          /* If the CRC8 is valid then calculate the temperature */
-          if( lastcrc8 == 0x00 )
-          {
-            /* DS1822 and DS18B20 use a different calculation */
-            if( (sensor_family == DS18B20_FAMILY) ||
-                (sensor_family == DS1822_FAMILY) ||
-                (sensor_family == DS28EA00_FAMILY) ||
-                (sensor_family == DS1923_FAMILY) )
-            {
-              short int temp2 = (scratchpad[2] << 8) | scratchpad[1];
-              temp_c = temp2 / 16.0;
-            }
+      /* Multiple Fahrenheit temps per line */
+      case 3:
+      case 5:     sprintf( temp, "\t%3.2f", c2f(temp_c) );
+                  bus_string( bus, temp );
+                  break;
 
-            /* Handle the DS1820 and DS18S20 */
-            if( sensor_family == DS1820_FAMILY )
-            {
-              /* Check for DS1820 glitch condition */
-              /* COUNT_PER_C - COUNT_REMAIN == 1 */
-              if( ds1820_try == 0 )
-              {
-                if( (scratchpad[7] - scratchpad[6]) == 1 )
-                {
-                  ds1820_try = 1;
-                  continue;
-                } /* DS1820 error */
-              } /* ds1820_try */
-            
-              /* Check for DS18S20 Error condition */
-              /*  LSB = 0xAA
-                  MSB = 0x00
-                  COUNT_REMAIN = 0x0C
-                  COUNT_PER_C = 0x10
-              */
-              if( ds18s20_try == 0 )
-              {
-                if( (scratchpad[4]==0xAA) &&
-                    (scratchpad[3]==0x00) &&
-                    (scratchpad[7]==0x0C) &&
-                    (scratchpad[8]==0x10)
-                  )
-                {
-                  ds18s20_try = 1;
-                  continue;
-                } /* DS18S20 error condition */
-              } /* ds18s20_try */
-          
-              /* Convert data to temperature */
-              if( scratchpad[2] == 0 )
-              {
-                temp_c = (int) scratchpad[1] >> 1;
-              } else {
-                temp_c = -1 * (int) (0x100-scratchpad[1]) >> 1;
-              } /* Negative temp calculation */
-              temp_c -= 0.25;
-              hi_precision = (int) scratchpad[8] - (int) scratchpad[7];
-              hi_precision = hi_precision / (int) scratchpad[8];
-              temp_c = temp_c + hi_precision;
-            } /* DS1820_FAMILY */
-            
-            /* Log the temperature */
-            switch( log_type )
-            {
-              /* Multiple Centigrade temps per line */
-              case 2:
-              case 4:     sprintf( temp, "\t%3.2f", temp_c );
-                          log_string( temp );
-                          break;
-
-              /* Multiple Fahrenheit temps per line */
-              case 3:
-              case 5:     sprintf( temp, "\t%3.2f", c2f(temp_c) );
-                          log_string( temp );
-                          break;
-
-              default:    owSerialNum( 0, &TempSN[0], TRUE );
-                          log_temp( sensor, temp_c, TempSN );
-                          break;
-            } /* switch( log_type ) */
-
-            /* Show the scratchpad if verbose is seelcted */
-            if( opts & OPT_VERBOSE )
-            {
-              show_scratchpad( scratchpad, sensor_family );              
-            } /* if OPT_VERBOSE */
+      default:    owSerialNum( bus->portnum, &TempSN[0], TRUE );
+                  log_temp( bus, sensor, temp_c, TempSN );
+                  break;
+    } /* switch( log_type ) */
 
-            /* Good conversion finished */
-            return TRUE;
-          } else {
-            fprintf( stderr, "CRC Failed. CRC is %02X instead of 0x00\n", lastcrc8 );
+    /* Show the scratchpad if verbose is seelcted */
+    if( opts & OPT_VERBOSE )
+    {
+      show_scratchpad( bus, scratchpad, sensor_family );              
+    } /* if OPT_VERBOSE */
 
-            if (try == MAX_READ_TRIES - 1)
-            {
-              /* need to output something (0,-,NaN?) to keep columns consistent */
-              switch( log_type )
-              {
-            	/* Multiple Centigrade temps per line */
-                 case 2:
-                 case 4:
-                 /* Multiple Fahrenheit temps per line */
-                 case 3:
-                 case 5:     sprintf( temp, "\t%3.2f", (double) 0 );
-                             log_string( temp );
-                             break;
-             
-                 default:
-                             break;
-               } /* switch( log_type ) */
-            } /* if tries == max_read_tries */
-
-            if( opts & OPT_VERBOSE )
-            {
-              show_scratchpad( scratchpad, sensor_family );              
-            } /* if OPT_VERBOSE */
-          } /* CRC 8 is OK */
-        } /* Scratchpad Read */
-      } /* owAccess failed */
-    } /* owAccess failed */
-    
-    /* Failed to read, rest the network, delay and try again */
-    owTouchReset(0);
-    msDelay( read_time );
-  } /* for try < 3 */
+    /* Good conversion finished */
+    return TRUE;
+  } /* for try < convert_tries */
+
+  /* need to output something (0,-,NaN?) to keep columns consistent */
+  switch( log_type )
+  {
+    /* Multiple Centigrade temps per line */
+    case 2:
+    case 4:
+    /* Multiple Fahrenheit temps per line */
+    case 3:
+    case 5:     sprintf( temp, "\t%3.2f", (double) 0 );
+                bus_string( bus, temp );
+                break;
+
+    default:
+                break;
+  } /* switch( log_type ) */
   
-  /* Failed, no good reads after MAX_READ_TRIES */
+  /* Failed, no good reads after convert_tries */
   return FALSE;
 }
 
@@ -1341,7 +2403,7 @@ int read_temperature( int sensor_family, int sensor )
 /* -----------------------------------------------------------------------
    Read the current counter values
    ----------------------------------------------------------------------- */
-int read_counter( int sensor_family, int sensor )
+int read_counter( struct _bus *bus, int sensor_family, int sensor )
 {
   char          temp[1024];        /* For output string                    */
   unsigned char TempSN[8];
@@ -1353,7 +2415,7 @@ int read_counter( int sensor_family, int sensor )
     /* Read Pages 2, 3 */
     for( page=2; page<=3; page++ )
     {
-      if( ReadCounter( 0, page, &counter_value ) )
+      if( ReadCounter( bus->portnum, page, &counter_value ) )
       {
         /* Log the counter */
         switch( log_type )
@@ -1363,11 +2425,11 @@ int read_counter( int sensor_family, int sensor )
           case 3:
           case 4:
           case 5:     sprintf( temp, "\t%ld", counter_value );
-                      log_string( temp );
+                      bus_string( bus, temp );
                       break;
 
-          default:    owSerialNum( 0, &TempSN[0], TRUE );
-                      log_counter( sensor, page-2, counter_value, TempSN );
+          default:    owSerialNum( bus->portnum, &TempSN[0], TRUE );
+                      log_counter( bus, sensor, page-2, counter_value, TempSN );
                       break;
         } /* switch( log_type ) */
       }
@@ -1376,7 +2438,7 @@ int read_counter( int sensor_family, int sensor )
     /* Read Pages 14, 15 */
     for( page=14; page<=15; page++ )
     {
-      if( ReadCounter( 0, page, &counter_value ) )
+      if( ReadCounter( bus->portnum, page, &counter_value ) )
       {
         /* Log the counter */
         switch( log_type )
@@ -1386,11 +2448,11 @@ int read_counter( int sensor_family, int sensor )
           case 3:
           case 4:
           case 5:     sprintf( temp, "\t%ld", counter_value );
-                      log_string( temp );
+                      bus_string( bus, temp );
                       break;
 
-          default:    owSerialNum( 0, &TempSN[0], TRUE );
-                      log_counter( sensor, page-14, counter_value, TempSN );
+          default:    owSerialNum( bus->portnum, &TempSN[0], TRUE );
+                      log_counter( bus, sensor, page-14, counter_value, TempSN );
                       break;
         } /* switch( log_type ) */
       }
@@ -1408,21 +2470,22 @@ int read_counter( int sensor_family, int sensor )
    !!!! Not finished !!!!
    Needs an output format string system. Hard-coded for the moment.
    ----------------------------------------------------------------------- */
-int read_ds2406( int sensor_family, int sensor )
+int read_ds2406( struct _bus *bus, int sensor_family, int sensor )
 {
   int		pio;
   char		temp[1024],
   		    time_format[160];
   time_t	mytime;
+  struct tm	tm;
 
   
   if( sensor_family == DS2406_FAMILY )
   {
     /* Read Vdd */
-    pio = PIO_Reading(0, 0);
+    pio = PIO_Reading(bus->portnum, 0);
 
     if (pio==-1) {
-	printf(" PIO DS2406 sensor %d CRC failed\n", sensor);
+	printf(" PIO DS2406 sensor %d CRC failed\n", bus->first + sensor);
 	return FALSE;
     }
     mytime = time(NULL);
@@ -1442,7 +2505,7 @@ int read_ds2406( int sensor_family, int sensor )
                     break;
 
         default:
-                    sprintf( time_format, "%%b %%d %%H:%%M:%%S Sensor %d PIO: %02x,%02x, PIO-A: %s%s", sensor, pio>>8, pio&0xff,
+                    sprintf( time_format, "%%b %%d %%H:%%M:%%S Sensor %d PIO: %02x,%02x, PIO-A: %s%s", bus->first + sensor, pio>>8, pio&0xff,
 			((pio&0x1000)!=0)? // Port A latch: there was a change
 				(((pio&0x0400)!=0)?
 					"ON"	// and the current state is ON
@@ -1458,7 +2521,7 @@ int read_ds2406( int sensor_family, int sensor )
 				"")
 			;
                     /* Handle the time format tokens */
-                    strftime( temp, 1024, time_format, localtime( &mytime ) );
+                    strftime( temp, 1024, time_format, localtime_r( &mytime, &tm ) );
                     strcat( temp, "\n" );
                     break;
       } /* switch( log_type ) */
@@ -1467,7 +2530,7 @@ int read_ds2406( int sensor_family, int sensor )
     }
 
     /* Log it to stdout, logfile or both */
-    log_string( temp );
+    bus_string( bus, temp );
   }
 
   return TRUE;
@@ -1484,39 +2547,45 @@ int read_ds2406( int sensor_family, int sensor )
    !!!! Not finished !!!!
    Needs an output format string system. Hard-coded for the moment.
    ----------------------------------------------------------------------- */
-int read_ds2438( int sensor_family, int sensor )
+int read_ds2438( struct _bus *bus, int sensor_family, int sensor )
 {
-  double	temp_c;
-  float		vdd,
-                ad,
+  double	temp_c = -999.0;
+  float		vdd = 0.0,
+                ad = 0.0,
                 vsens;
   int           cad = 0;
   unsigned char TempSN[8];
   int           try;
   int           result = FALSE;
 
-  for( try = 0; try < MAX_READ_TRIES; try++ )
+  for( try = 0; try < convert_tries; try++ )
   {
     /* Read the temperature */
-    temp_c = Get_Temperature(0);
+    temp_c = Get_Temperature(bus->portnum, read_tries);
     if (temp_c == -999.0)
-        return result;
+    {
+        owTouchReset(bus->portnum);
+        continue;
+    }
 
     /* Read Vdd, the supply voltage */
-    if( (vdd = Volt_Reading(0, 1, &cad)) != -1.0 )
+    if( (vdd = Volt_Reading(bus->portnum, 1, &cad, read_tries)) != -1.0 )
     {
       /* Read A/D reading from the sense input pin */
-      if( (ad = Volt_Reading(0, 0, NULL)) != -1.0 )
+      if( (ad = Volt_Reading(bus->portnum, 0, NULL, read_tries)) != -1.0 )
       {
         result = TRUE;
         break;
       }
     }
 
-    owTouchReset(0);
-    msDelay(read_time);
+    owTouchReset(bus->portnum);
   }
 
+  /* Never got a temperature */
+  if (temp_c == -999.0)
+    return result;
+
   /* Convert cad into measured voltage: datasheet specifies each unit in
    * cad value to represent 0.2441 mV.
    * Note: vsens is in unit mV, whereas vdd and ad are in V
@@ -1524,8 +2593,8 @@ int read_ds2438( int sensor_family, int sensor )
   vsens = 0.2441 * cad;
 
   /* Log the measured values */
-  owSerialNum(0, &TempSN[0], TRUE);
-  log_temperature_voltage(sensor, temp_c, vdd, ad, vsens, TempSN);
+  owSerialNum(bus->portnum, &TempSN[0], TRUE);
+  log_temperature_voltage( bus, sensor, temp_c, vdd, ad, vsens, TempSN);
 
   return result;
 }
@@ -1576,9 +2645,9 @@ int read_ds2438( int sensor_family, int sensor )
 
    !!!! Not Finished !!!!
    ----------------------------------------------------------------------- */
-int read_humidity( int sensor_family, int sensor )
+int read_humidity( struct _bus *bus, int sensor_family, int sensor )
 {
-  double	temp_c;			/* Converted temperature in degrees C */
+  double	temp_c = -999.0;	/* Converted temperature in degrees C */
   float		sup_voltage,		/* Supply voltage in volts            */
 		hum_voltage,		/* Humidity sensor voltage in volts   */
 		humidity = 0.0;		/* Calculated humidity in %RH         */
@@ -1586,18 +2655,21 @@ int read_humidity( int sensor_family, int sensor )
   int		try;  
   int           result = FALSE;
 	
-  for( try = 0; try < MAX_READ_TRIES; try++ )
+  for( try = 0; try < convert_tries; try++ )
   {
     /* Read the temperature */
-    temp_c = Get_Temperature(0);
+    temp_c = Get_Temperature(bus->portnum, read_tries);
     if (temp_c == -999.0)
-        return result;
+    {
+        owTouchReset(bus->portnum);
+        continue;
+    }
 
     /* Read Vdd, the supply voltage */
-    if( (sup_voltage = Volt_Reading(0, 1, NULL)) != -1.0 )
+    if( (sup_voltage = Volt_Reading(bus->portnum, 1, NULL, read_tries)) != -1.0 )
     {
       /* Read A/D reading from the humidity sensor */
-      if( (hum_voltage = Volt_Reading(0, 0, NULL)) != -1.0 )
+      if( (hum_voltage = Volt_Reading(bus->portnum, 0, NULL, read_tries)) != -1.0 )
       {
         /* Convert the measured voltage to humidity */
         humidity = (((hum_voltage/sup_voltage) - 0.16) * 161.29)
@@ -1612,39 +2684,92 @@ int read_humidity( int sensor_family, int sensor )
       }
     }
 
-    owTouchReset(0);
-    msDelay(read_time);
+    owTouchReset(bus->portnum);
   }
 
+  /* Never got a temperature */
+  if (temp_c == -999.0)
+    return result;
+
   /* Log the temperature and humidity */
-  owSerialNum( 0, &TempSN[0], TRUE );
-  log_humidity( sensor, temp_c, humidity, TempSN );
+  owSerialNum( bus->portnum, &TempSN[0], TRUE );
+  log_humidity( bus, sensor, temp_c, humidity, TempSN );
 
   return result;
 }
 
 
 /* -----------------------------------------------------------------------
-   Read the DS1923 Hygrochton Temperature/Humidity Logger
+   Read the latest temperature and humidity from the selected DS1923
+
+   Uses Read Memory with Password (0x69) on 0x20C:0x20F
+
+   Returns FALSE if the device didn't answer correctly
    ----------------------------------------------------------------------- */
-int read_temperature_DS1923( int sensor_family, int sensor )
+int read_DS1923_result( struct _bus *bus, float *temp_c, float *humidity )
 {
-  unsigned char TempSN[8],
-  		block2[2];
-  int try;                     /* Number of tries at reading device    */
+  unsigned char block2[2];
   int b;
   int pre_t;
-  float temp_c;
   int ival;
   float adval;
-  float humidity;
 
-  for( try = 0; try < MAX_READ_TRIES; try++ )
-  {
-    if( owAccess(0) )
-    {
+  if( !owAccess(bus->portnum) )
+    return FALSE;
+
+  if( !owWriteByte( bus->portnum, 0x69 ) )
+    return FALSE;
+
+  /* "Latest Temp" in the memory */
+  block2[0] = 0x0c;
+  block2[1] = 0x02;
+
+  /* Send the block */
+  if( !owBlock( bus->portnum, FALSE, block2, 2 ) )
+    return FALSE;
+
+  if (block2[0] != 0x0c && block2[1] != 0x02) 
+    return FALSE;
+
+  /* Send dummy password */
+  for(b = 0; b < 8; ++b) {
+    owWriteByte(bus->portnum, 0x04);
+  }
+
+  /* Read the temperature */
+  block2[0] = owReadByte(bus->portnum);
+  block2[1] = owReadByte(bus->portnum);
+  pre_t  = (block2[1]/2)-41;
+  *temp_c = 1.0f * pre_t + block2[0]/512.0f;
+
+  /* Read the humidity */
+  block2[0] = owReadByte(bus->portnum);
+  block2[1] = owReadByte(bus->portnum);
+  ival = (block2[1]*256 + block2[0])/16;
+  adval = 1.0f * ival * 5.02f/4096;
+  *humidity = (adval-0.958f) / 0.0307f;
+
+  return TRUE;
+}
+
+
+/* -----------------------------------------------------------------------
+   Read the DS1923 Hygrochton Temperature/Humidity Logger
+   ----------------------------------------------------------------------- */
+int read_temperature_DS1923( struct _bus *bus, int sensor_family, int sensor )
+{
+  unsigned char TempSN[8];
+  int try,                     /* Number of conversions tried          */
+      rtry;                    /* Number of reads of this conversion   */
+  float temp_c;
+  float humidity;
+
+  for( try = 0; try < convert_tries; try++ )
+  {
+    if( owAccess(bus->portnum) )
+    {
       /* Force Conversion */
-      if( !owWriteByte( 0, 0x55 ) || !owWriteByte( 0, 0x55 ))
+      if( !owWriteByte( bus->portnum, 0x55 ) || !owWriteByte( bus->portnum, 0x55 ))
       {
         return FALSE;
       }
@@ -1653,218 +2778,622 @@ int read_temperature_DS1923( int sensor_family, int sensor )
        * If the count has incremented, the command was executed successfully.
        */
 
-      /* Sleep for conversion (spec says it takes max 666ms */
-      /* Q. Is it possible to poll? */
-      msDelay( 666 );
-      
-      /* Now read the memory 0x20C:0x020F */
-      if( owAccess(0) )
+      /* Sleep for conversion (spec says it takes max 666ms).
+         The DS1923 doesn't signal completion in read slots like the
+         DS18x20, so it can't be polled.
+      */
+      msDelay( DS1923_CONV_TIME );
+
+      /* The result stays in memory, so re-read it before converting again */
+      for( rtry = 0; rtry < read_tries; rtry++ )
       {
-        if( !owWriteByte( 0, 0x69 ) )
+        if( read_DS1923_result( bus, &temp_c, &humidity ) )
         {
-          return FALSE;
+          /* Log the temperature and humidity */
+          /* TUTAJ masz wartosci we floatach dla Thermochrona
+             sensor to nr sensora z pliku konfiguracyjnego,
+             a tempsn to pewnie id urzadzenia 1wire
+          */
+          owSerialNum( bus->portnum, &TempSN[0], TRUE );
+          log_humidity( bus, sensor, temp_c, humidity, TempSN );
+
+          /* Good conversion finished */
+          return TRUE;
         }
+      } /* for rtry < read_tries */
+    } /* owAccess failed */
 
-        /* "Latest Temp" in the memory */
-        block2[0] = 0x0c;
-        block2[1] = 0x02;
- 
-        /* Send the block */
-        if( owBlock( 0, FALSE, block2, 2 ) )
+    /* Failed to read, reset the network and try again */
+    owTouchReset(bus->portnum);
+  } /* for try < convert_tries */
+  
+  /* Failed, no good reads after convert_tries */
+  return FALSE;
+}
+
+
+/* -----------------------------------------------------------------------
+   Select the indicated device, turning on any required couplers
+   ----------------------------------------------------------------------- */
+int read_device( struct _bus *bus, int sensor )
+{
+  struct _roms    *sensor_list = &bus->sensor_list;
+  unsigned char   TempSN[8];
+  int             s,
+                  status = 0,
+                  sensor_family;
+  struct _coupler *c_ptr;          /* Coupler linked list                  */
+    
+  /* Tell the sensor to do a temperature conversion */
+
+  /* Sort out how to address the sensor.
+     If sensor < num_sensors then it can be directly addressed
+     if sensor >= num_sensors then the coupler must first be
+     addressed and the correct branch turned on.
+  */
+  if( sensor < sensor_list->max )
+  {
+    /* Address the sensor directly */
+    owSerialNum( bus->portnum, &sensor_list->roms[sensor*8], FALSE );
+  } else {
+    /* Step through the coupler list until the right sensor is found.
+       Sensors are in order.
+    */
+    s = sensor - sensor_list->max;
+    c_ptr = bus->coupler_top;
+    while( c_ptr )
+    {
+      if( s < c_ptr->num_main )
+      {
+        /* Found the right area, turn on the main branch */
+        if( !select_branch( bus, c_ptr, 0 ) )
+          return FALSE;
+        
+        /* Select the sensor */
+        owSerialNum( bus->portnum, &c_ptr->main[s*8], FALSE );
+        break;
+      } else {
+        s -= c_ptr->num_main;
+        if( s < c_ptr->num_aux )
         {
-          if (block2[0] != 0x0c && block2[1] != 0x02) 
+          /* Found the right area, turn on the aux branch */
+          if( !select_branch( bus, c_ptr, 1 ) )
             return FALSE;
 
-          /* Send dummy password */
-          for(b = 0; b < 8; ++b) {
-            owWriteByte(0, 0x04);
-          }
+          /* Select the sensor */
+          owSerialNum( bus->portnum, &c_ptr->aux[s*8], FALSE );
+          break;          
+        }
+      }
+      s -= c_ptr->num_aux;
+      c_ptr = c_ptr->next;
+    }    
+  }
 
-          /* Read the temperature */
-          block2[0] = owReadByte(0);
-          block2[1] = owReadByte(0);
-          pre_t  = (block2[1]/2)-41;
-          temp_c = 1.0f * pre_t + block2[0]/512.0f;
+  /* Get the Serial # selected */
+  owSerialNum( bus->portnum, &TempSN[0], TRUE );
+  sensor_family = TempSN[0];
+  
+  switch( sensor_family )
+  {
+    case DS28EA00_FAMILY:
+    case DS2413_FAMILY:
+      if( (opts & OPT_DS2438) || (sensor_family==DS2413_FAMILY) ) { // read PIO
+		status = read_pio_ds28ea00( bus, sensor_family, sensor );
+	    break;
+	  }
+  	  // else - drop through to DS1822
+    case DS1820_FAMILY:
+    case DS1822_FAMILY:
+    case DS18B20_FAMILY:
+      status = read_temperature( bus, sensor_family, sensor ); // also for DS28EA00
+      break;
 
-          /* Read the humidity */
-          block2[0] = owReadByte(0);
-          block2[1] = owReadByte(0);
-          ival = (block2[1]*256 + block2[0])/16;
-          adval = 1.0f * ival * 5.02f/4096;
-          humidity = (adval-0.958f) / 0.0307f;
+    case DS1923_FAMILY:
+      status = read_temperature_DS1923( bus, sensor_family, sensor );
+      break;      
 
-          /* Log the temperature and humidity */
-	  /* TUTAJ masz wartosci we floatach dla Thermochrona
- 	     sensor to nr sensora z pliku konfiguracyjnego,
- 	     a tempsn to pewnie id urzadzenia 1wire
-          */
-          owSerialNum( 0, &TempSN[0], TRUE );
-          log_humidity( sensor, temp_c, humidity, TempSN );
+    case DS2422_FAMILY:
+    case DS2423_FAMILY:
+      status = read_counter( bus, sensor_family, sensor );
+      break;
 
-          /* Good conversion finished */
-          return TRUE;
-        } /* Scratchpad Read */
-      } /* owAccess failed */
-    } /* owAccess failed */
+    case DS2438_FAMILY:
+    // What type is it?
+        {
+            int page;
+            for( page=3; page<8; page++)
+            {
+                get_ibl_type( bus->portnum, page, 0);
+            }
+        }
+        if( opts & OPT_DS2438 )
+        {
+            status = read_ds2438( bus, sensor_family, sensor );
+        } else {
+            status = read_humidity( bus, sensor_family, sensor );
+        }
+        break;
+    }
+
+  return status;
+}
+
+
+
+
+/* -----------------------------------------------------------------------
+   Decide which sensors are read in this sweep
+
+   Sensors with an INTERVAL are only read once that much time has passed
+   since the sweep that last read them, everything else is read every
+   time. The schedule is anchored to the start of each sweep, so how long
+   the bus takes doesn't push the readings later and later.
+
+   Returns the number of sensors that are due
+   ----------------------------------------------------------------------- */
+int plan_sweep( struct _bus *bus )
+{
+  struct _roms        *sensor_list = &bus->sensor_list;
+  struct _sensor_info *info;
+  int                 x,
+                      due = 0;
+
+  clock_gettime( CLOCK_MONOTONIC, &bus->sweep_time );
+
+  for( x = 0; x < sensor_list->max + bus->num_cs; x++ )
+  {
+    if( (info = get_sensor_info( bus, x )) == NULL )
+    {
+      due++;
+      continue;
+    }
+
+    info->due = (info->interval == 0) ||
+                ((info->next_read.tv_sec == 0) && (info->next_read.tv_nsec == 0)) ||
+                (diff_msec( &bus->sweep_time, &info->next_read ) >= 0);
+    if( info->due )
+      due++;
+  }
+
+  return due;
+}
+
+
+/* -----------------------------------------------------------------------
+   Is the sensor due in the current sweep?
+   ----------------------------------------------------------------------- */
+int sensor_due( struct _bus *bus, int sensor )
+{
+  if( (sensor < 0) || (sensor >= bus->sensor_info_max) )
+    return TRUE;
+
+  return bus->sensor_info[sensor].due;
+}
+
+
+/* -----------------------------------------------------------------------
+   Count the sensors on a segment that are due in the current sweep
+   ----------------------------------------------------------------------- */
+int segment_due( struct _bus *bus, int first, int num )
+{
+  int x,
+      due = 0;
+
+  for( x = 0; x < num; x++ )
+  {
+    if( sensor_due( bus, first + x ) )
+      due++;
+  }
+
+  return due;
+}
+
+
+/* -----------------------------------------------------------------------
+   The sensor was read in this sweep, schedule the next one
+   ----------------------------------------------------------------------- */
+void sensor_done( struct _bus *bus, int sensor )
+{
+  struct _sensor_info *info;
+
+  if( (sensor < 0) || (sensor >= bus->sensor_info_max) )
+    return;
+
+  info = &bus->sensor_info[sensor];
+  if( info->interval )
+  {
+    info->next_read = bus->sweep_time;
+    add_msec( &info->next_read, info->interval );
+  }
+}
+
+
+/* -----------------------------------------------------------------------
+   Get the temperature sensors on the current segment ready to convert
+
+   roms is the list of num sensors on the segment, first is the sensor
+   number of the first one.
+
+   Returns how long to wait for the conversion in mS, 0 if there are no
+   temperature sensors due in the list.
+   ----------------------------------------------------------------------- */
+int setup_convert( struct _bus *bus, unsigned char *roms, int num, int first, int power )
+{
+  int x,
+      msec = 0,
+      family;
+
+  /* Set the resolutions before converting, and wait for the slowest one
+     that is due. The others convert too, but nobody waits for them.
+  */
+  for( x = 0; x < num; x++ )
+  {
+    if( !sensor_due( bus, first+x ) )
+      continue;
+
+    family = roms[x*8];
+    switch( family )
+    {
+      case DS1820_FAMILY:
+      case DS1822_FAMILY:
+      case DS18B20_FAMILY:
+      case DS28EA00_FAMILY:
+        owSerialNum( bus->portnum, &roms[x*8], FALSE );
+        setup_sensor( bus, family, first+x, power );
+        if( conversion_time( bus, family, first+x ) > msec )
+          msec = conversion_time( bus, family, first+x );
+        break;
+    }
+  }
+
+  return msec;
+}
+
+
+/* -----------------------------------------------------------------------
+   Send Convert T to every sensor on the current segment
+
+   Skip ROM addresses all of the devices at once, so the DS18x20 sensors
+   all convert in parallel and we only have to wait once for the whole
+   segment instead of once per sensor. Devices that don't know about
+   Convert T ignore it.
+
+   Returns FALSE if the bus didn't respond.
+   ----------------------------------------------------------------------- */
+int send_convert( struct _bus *bus, int power )
+{
+  if( !owTouchReset(bus->portnum) )
+    return FALSE;
+
+  /* Skip ROM */
+  if( !owWriteByte( bus->portnum, 0xCC ) )
+    return FALSE;
+
+  /* Convert Temperature */
+  if( power == POWER_EXTERNAL )
+    return owWriteByte( bus->portnum, 0x44 );
+
+  return owWriteBytePower( bus->portnum, 0x44 );
+}
+
+
+/* -----------------------------------------------------------------------
+   Start a temperature conversion on every sensor on the current segment
+
+   Returns how long to wait for the conversion in mS, 0 if there are no
+   temperature sensors due in the list, or -1 if the bus didn't respond.
+   ----------------------------------------------------------------------- */
+int start_convert( struct _bus *bus, unsigned char *roms, int num, int first, int power )
+{
+  int msec;
+
+  if( (msec = setup_convert( bus, roms, num, first, power )) <= 0 )
+    return msec;
+
+  if( !send_convert( bus, power ) )
+    return -1;
+
+  return msec;
+}
+
+
+/* -----------------------------------------------------------------------
+   Convert all the temperature sensors on the current segment and wait for
+   them to finish. power is the cached power supply of the segment, it is
+   filled in the first time.
+
+   The adapter gets the first try, the kernel's w1 masters convert all
+   of their thermometers with one bulk command and power the parasite
+   ones themselves.
+
+   Returns TRUE if the conversion was done, FALSE if there are no
+   temperature sensors in the list or the bus didn't respond.
+   ----------------------------------------------------------------------- */
+int convert_segment( struct _bus *bus, unsigned char *roms, int num, int first, int *power )
+{
+  int msec;
+
+  /* Can only poll if nothing on the segment is parasite powered */
+  if( *power == POWER_UNKNOWN )
+    *power = read_power_supply( bus, TRUE );
+
+  if( (msec = setup_convert( bus, roms, num, first, *power )) <= 0 )
+    return FALSE;
+
+  if( adapter_convert( bus->portnum, msec ) )
+    return TRUE;
+
+  if( !send_convert( bus, *power ) )
+    return FALSE;
+
+  return wait_conversion( bus, *power, msec );
+}
+
+
+/* -----------------------------------------------------------------------
+   Start a temperature conversion on every sensor on the main segment
+   ----------------------------------------------------------------------- */
+int convert_all( struct _bus *bus )
+{
+  unsigned char a[3];
+
+  /* The Skip ROMs would also reach the coupler branch the last sweep
+     left on, turn it off first */
+  if( bus->Last2409[0] == SWITCH_FAMILY )
+  {
+    SetSwitch1F(bus->portnum, bus->Last2409, ALL_LINES_OFF, 0, a, TRUE);
+    bzero( bus->Last2409, sizeof(bus->Last2409) );
+  }
+
+  return convert_segment( bus, bus->sensor_list.roms, bus->sensor_list.max, 0,
+                          &bus->power );
+}
+
+
+/* -----------------------------------------------------------------------
+   Turn on a DS2409 coupler branch, 0 = main, 1 = aux
+
+   Nothing is sent if it is already on. The previously selected coupler
+   is turned off first so that only one branch is on the bus at a time.
+   ----------------------------------------------------------------------- */
+int select_branch( struct _bus *bus, struct _coupler *c_ptr, int branch )
+{
+  unsigned char a[3];
+
+  /* Is this coupler & branch already on? */
+  if( cmpSN( c_ptr->SN, bus->Last2409, branch ) )
+    return TRUE;
+
+  /* Turn off the last coupler if it is a different one */
+  if( (bus->Last2409[0] == SWITCH_FAMILY) && memcmp( c_ptr->SN, bus->Last2409, 8 ) )
+    SetSwitch1F(bus->portnum, bus->Last2409, ALL_LINES_OFF, 0, a, TRUE);
+
+  if( branch == 0 )
+  {
+    /* Turn on the main branch */
+    if(!SetSwitch1F(bus->portnum, c_ptr->SN, DIRECT_MAIN_ON, 0, a, TRUE))
+    {
+      printf("Setting Switch to Main ON state failed\n");
+      bzero( bus->Last2409, sizeof(bus->Last2409) );
+      return FALSE;
+    }
+  } else {
+    /* Turn on the aux branch */
+    if(!SetSwitch1F(bus->portnum, c_ptr->SN, AUXILARY_ON, 2, a, TRUE))
+    {
+      printf("Setting Switch to Aux ON state failed\n");
+      bzero( bus->Last2409, sizeof(bus->Last2409) );
+      return FALSE;
+    }
+  }
+
+  /* Remember the last selected coupler & Branch */
+  memcpy( bus->Last2409, &c_ptr->SN, 8 );
+  bus->Last2409[8] = branch;
+
+  return TRUE;
+}
+
+
+/* -----------------------------------------------------------------------
+   Leave an empty column for a sensor that isn't due, so the multi-sensor
+   log types stay lined up
+   ----------------------------------------------------------------------- */
+void read_skipped( struct _bus *bus, int sensor )
+{
+  switch( log_type )
+  {
+    case 2:
+    case 3:
+    case 4:
+    case 5:	bus_string( bus, "\t" );
+		break;
+    default:
+		break;
+  }
+}
+
+
+/* -----------------------------------------------------------------------
+   Read a sensor if it is due in this sweep
+   ----------------------------------------------------------------------- */
+int read_scheduled( struct _bus *bus, int sensor )
+{
+  int ret;
+
+  if( !sensor_due( bus, sensor ) )
+  {
+    read_skipped( bus, sensor );
+    return 0;
+  }
 
-    /* Failed to read, rest the network, delay and try again */
-    owTouchReset(0);
-    msDelay( read_time );
-  } /* for try < 3 */
-  
-  /* Failed, no good reads after MAX_READ_TRIES */
-  return FALSE;
+  ret = read_device( bus, sensor );
+  sensor_done( bus, sensor );
+
+  return ret;
 }
 
 
 /* -----------------------------------------------------------------------
-   Select the indicated device, turning on any required couplers
+   Read the temperaturess for all the connected sensors
+
+   Step through all the sensors in the list of serial numbers. Each
+   segment (the main bus, then each coupler branch) is selected once and
+   all of its temperature sensors are converted with one Skip ROM.
+   Externally powered branches keep converting after they are switched
+   off, so they are all started before any of the branches are read.
+   Only the sensors that are due are read, and segments without any due
+   sensors aren't touched at all.
    ----------------------------------------------------------------------- */
-int read_device( struct _roms *sensor_list, int sensor )
+int read_all( struct _bus *bus )
 {
-  unsigned char   TempSN[8],
-                  a[3];
-  int             s,
-                  status = 0,
-                  sensor_family;
-  struct _coupler *c_ptr;          /* Coupler linked list                  */
-    
-  /* Tell the sensor to do a temperature conversion */
+  struct _roms    *sensor_list = &bus->sensor_list;
+  int             x,
+                  branch,
+                  num,
+                  first,
+                  msec;
+  unsigned char   *roms;
+  struct _coupler *c_ptr;
 
-  /* Sort out how to address the sensor.
-     If sensor < num_sensors then it can be directly addressed
-     if sensor >= num_sensors then the coupler must first be
-     addressed and the correct branch turned on.
-  */
-  if( sensor < sensor_list->max )
+  /* Nothing to do until a sensor's INTERVAL is up */
+  if( plan_sweep( bus ) == 0 )
   {
-    /* Address the sensor directly */
-    owSerialNum( 0, &sensor_list->roms[sensor*8], FALSE );
-  } else {
-    /* Step through the coupler list until the right sensor is found.
-       Sensors are in order.
-    */
-    s = sensor - sensor_list->max;
-    c_ptr = coupler_top;
-    while( c_ptr )
-    {
-      if( s < c_ptr->num_main )
-      {
-        /* Found the right area */
-        
-        /* Is this coupler & branch already on? */
-        if( !cmpSN( c_ptr->SN, Last2409, 0 ) )
-        {
-          /* Turn on the main branch */
-          if(!SetSwitch1F(0, c_ptr->SN, DIRECT_MAIN_ON, 0, a, TRUE))
-          {
-            printf("Setting Switch to Main ON state failed\n");
-            return FALSE;
-          }
-          /* Remember the last selected coupler & Branch */
-          memcpy( &Last2409, &c_ptr->SN, 8 );
-          Last2409[8] = 0;
-        }
-        
-        /* Select the sensor */
-        owSerialNum( 0, &c_ptr->main[s*8], FALSE );
-        break;
-      } else {
-        s -= c_ptr->num_main;
-        if( s < c_ptr->num_aux )
-        {
-          /* Found the right area */
+    for( x = 0; x < sensor_list->max + bus->num_cs; x++ )
+      read_skipped( bus, x );
+    return 0;
+  }
 
-          /* Is this coupler & branch already on? */
-          if( !cmpSN( c_ptr->SN, Last2409, 1 ) )
-          {        
-            /* Turn on the aux branch */
-            if(!SetSwitch1F(0, c_ptr->SN, AUXILARY_ON, 2, a, TRUE))
-            {
-              printf("Setting Switch to Aux ON state failed\n");
-              return FALSE;
-            }
-            /* Remember the last selected coupler & Branch */
-            memcpy( &Last2409, &c_ptr->SN, 8 );
-            Last2409[8] = 1;
-          } /* Last2409 check */
+  /* Start all the temperature sensors on the main segment at once */
+  if( segment_due( bus, 0, sensor_list->max ) )
+    bus->converted = convert_all( bus );
 
-          /* Select the sensor */
-          owSerialNum( 0, &c_ptr->aux[s*8], FALSE );
-          break;          
-        }
-      }
-      s -= c_ptr->num_aux;
-      c_ptr = c_ptr->next;
-    }    
+  for( x = 0; x < sensor_list->max; x++ )
+  {
+    read_scheduled( bus, x );
   }
+  bus->converted = 0;
 
-  /* Get the Serial # selected */
-  owSerialNum( 0, &TempSN[0], TRUE );
-  sensor_family = TempSN[0];
-  
-  switch( sensor_family )
+  /* Start the externally powered coupler branches converting */
+  first = sensor_list->max;
+  for( c_ptr = bus->coupler_top; c_ptr; c_ptr = c_ptr->next )
   {
-    case DS28EA00_FAMILY:
-    case DS2413_FAMILY:
-      if( (opts & OPT_DS2438) || (sensor_family==DS2413_FAMILY) ) { // read PIO
-		status = read_pio_ds28ea00( sensor_family, sensor );
-	    break;
-	  }
-  	  // else - drop through to DS1822
-    case DS1820_FAMILY:
-    case DS1822_FAMILY:
-    case DS18B20_FAMILY:
-      status = read_temperature( sensor_family, sensor ); // also for DS28EA00
-      break;
-
-    case DS1923_FAMILY:
-      status = read_temperature_DS1923( sensor_family, sensor );
-      break;      
+    for( branch = 0; branch < 2; branch++ )
+    {
+      num = branch ? c_ptr->num_aux : c_ptr->num_main;
+      roms = branch ? c_ptr->aux : c_ptr->main;
 
-    case DS2422_FAMILY:
-    case DS2423_FAMILY:
-      status = read_counter( sensor_family, sensor );
-      break;
+      c_ptr->convert_tick[branch] = 0;
+      if( segment_due( bus, first, num ) && select_branch( bus, c_ptr, branch ) )
+      {
+        if( c_ptr->power[branch] == POWER_UNKNOWN )
+          c_ptr->power[branch] = read_power_supply( bus, TRUE );
 
-    case DS2438_FAMILY:
-    // What type is it?
+        if( (c_ptr->power[branch] == POWER_EXTERNAL) &&
+            ((msec = start_convert( bus, roms, num, first, POWER_EXTERNAL )) > 0) )
         {
-            int page;
-            for( page=3; page<8; page++)
-            {
-                get_ibl_type( 0, page, 0);
-            }
+          c_ptr->convert_tick[branch] = msGettick();
+          c_ptr->convert_time[branch] = msec;
         }
-        if( opts & OPT_DS2438 )
+      }
+      first += num;
+    }
+  }
+
+  /* Visit each branch once, convert what is left and read them all */
+  first = sensor_list->max;
+  for( c_ptr = bus->coupler_top; c_ptr; c_ptr = c_ptr->next )
+  {
+    for( branch = 0; branch < 2; branch++ )
+    {
+      num = branch ? c_ptr->num_aux : c_ptr->num_main;
+      roms = branch ? c_ptr->aux : c_ptr->main;
+
+      if( segment_due( bus, first, num ) && select_branch( bus, c_ptr, branch ) )
+      {
+        if( c_ptr->convert_tick[branch] )
         {
-            status = read_ds2438( sensor_family, sensor );
+          /* Already converting, wait for whatever is left. This can't
+             be polled, the sensors only answer read slots right after
+             the Convert T command.
+          */
+          msec = c_ptr->convert_time[branch] -
+                 (msGettick() - c_ptr->convert_tick[branch]);
+          if( msec > 0 )
+            msDelay( msec );
+          bus->converted = TRUE;
         } else {
-            status = read_humidity( sensor_family, sensor );
+          bus->converted = convert_segment( bus, roms, num, first,
+                                           &c_ptr->power[branch] );
         }
-        break;
-    }
+      }
 
-  return status;
+      for( x = 0; x < num; x++ )
+      {
+        read_scheduled( bus, first + x );
+      }
+      bus->converted = 0;
+      first += num;
+    }
+  }
+  
+  return 0;
 }
 
 
+/* -----------------------------------------------------------------------
+   Sweep one bus, run on its own thread by read_buses()
+   ----------------------------------------------------------------------- */
+void *sweep_thread( void *arg )
+{
+  read_all( (struct _bus *) arg );
+
+  return NULL;
+}
 
 
 /* -----------------------------------------------------------------------
-   Read the temperaturess for all the connected sensors
+   Read all the sensors on all of the buses
 
-   Step through all the sensors in the list of serial numbers
+   Each bus is on its own adapter, so with more than one bus they are
+   swept at the same time, one thread per bus, and the sweep takes as long
+   as the slowest bus instead of all of them added up. The output of each
+   bus is collected while it runs and logged in bus order afterwards, so
+   it comes out the same as reading them one after the other.
    ----------------------------------------------------------------------- */
-int read_all( struct _roms *sensor_list )
+int read_buses()
 {
-  int x;
-  
-  for( x = 0; x <  (num_cs+sensor_list->max); x++ )
+  int x,
+      started[MAX_BUSES];
+
+  if( num_buses == 1 )
+    return read_all( &buses[0] );
+
+  for( x = 0; x < num_buses; x++ )
   {
-    read_device( sensor_list, x );
+    buses[x].threaded = TRUE;
+    buses[x].out_len = 0;
+    started[x] = (pthread_create( &buses[x].thread, NULL, sweep_thread,
+                                  &buses[x] ) == 0);
+    if( !started[x] )
+    {
+      /* No thread, sweep it from here instead */
+      read_all( &buses[x] );
+    }
   }
-  
+
+  for( x = 0; x < num_buses; x++ )
+  {
+    if( started[x] )
+      pthread_join( buses[x].thread, NULL );
+    buses[x].threaded = FALSE;
+
+    if( buses[x].out_len > 0 )
+      log_string( buses[x].out );
+    buses[x].out_len = 0;
+  }
+
   return 0;
 }
 
@@ -1877,6 +3406,10 @@ int read_all( struct _roms *sensor_list )
    TTY <serial>
    LOG <logfilepath>
    READ_TIME <time in mS>
+   CONVERT_TRIES <conversions to try before giving up>
+   READ_TRIES <reads of each conversion on CRC errors>
+   LOG_FLUSH <lines to buffer, 0 writes them after every sample>
+   LOG_FSYNC <seconds between fsyncs of the logfile, 0 never>
    LOG_TYPE <from -o>
    LOG_FORMAT <format string for temperature logging and printing>
    CNT_FORMAT <format string for counter logging and printing>
@@ -1887,20 +3420,37 @@ int read_all( struct _roms *sensor_list )
    v 2.3 additions:
    Multiple COUPLER x <serial number in decimal> lines
    CROM x <COUPLER #> <M or A> <Serial number in decimal>
-   
+
+   RESOLUTION x <9 to 12 bits>
+   INTERVAL x <time between reads in mS>
+
+   Another TTY line starts a new bus. The SENSORS, ROM, COUPLER, CROM,
+   RESOLUTION and INTERVAL lines after it belong to that bus, and its
+   sensors are numbered from 0 again.
    ----------------------------------------------------------------------- */
-int read_rcfile( char *fname, struct _roms *sensor_list )
+int read_rcfile( char *fname )
 {
   FILE	*fp;
   char	temp[1024];
   char	*ptr;
-  int	sensors, x;
+  int	sensors, x,
+	ttys = 0,
+	line = 0;
   struct _coupler *c_ptr, *coupler_end;
-  
+  struct _sensor_info *info;
+  struct _bus *bus;
+  struct _roms *sensor_list;
+
+  /* Everything up to the second TTY line belongs to the first bus */
+  num_buses = 1;
+  bus = &buses[0];
+  sensor_list = &bus->sensor_list;
+
   sensors = 0;
-  num_cs = 0;
-  c_ptr = coupler_top;
-  coupler_end = coupler_top;
+  bus->num_cs = 0;
+  free_sensor_info( bus );
+  c_ptr = bus->coupler_top;
+  coupler_end = bus->coupler_top;
     
   if( ( fp = fopen( fname, "r" ) ) == NULL )
   {
@@ -1910,6 +3460,7 @@ int read_rcfile( char *fname, struct _roms *sensor_list )
   
   while( fgets( temp, sizeof(temp), fp ) != 0 )
   {
+    line++;
     if( (temp[0] == '\n') || (temp[0] == '#') )
       continue;
       
@@ -1917,9 +3468,31 @@ int read_rcfile( char *fname, struct _roms *sensor_list )
     
     if( strncasecmp( "TTY", ptr, 3 ) == 0 )
     {
+      /* Each TTY after the first starts a new bus */
+      if( ttys++ > 0 )
+      {
+        if( num_buses == MAX_BUSES )
+        {
+          fprintf( stderr, "Error, more than %d TTY lines\n", MAX_BUSES );
+          fclose( fp );
+          return -1;
+        }
+        bus = &buses[num_buses];
+        init_bus( bus, num_buses++ );
+        sensor_list = &bus->sensor_list;
+        coupler_end = NULL;
+      }
       ptr = strtok( NULL, " \t\n" );
-      strncpy( serial_port, ptr, sizeof(serial_port)-1 );
-      serial_port[sizeof(serial_port)-1] = 0x00;
+      strncpy( bus->serial_port, ptr, sizeof(bus->serial_port)-1 );
+      bus->serial_port[sizeof(bus->serial_port)-1] = 0x00;
+    } else if( strncasecmp( "LOG_FLUSH", ptr, 9 ) == 0 ) {
+      ptr = strtok( NULL, " \t\n");
+      if( (log_flush_records = atoi( ptr )) < 0 )
+        log_flush_records = 0;
+    } else if( strncasecmp( "LOG_FSYNC", ptr, 9 ) == 0 ) {
+      ptr = strtok( NULL, " \t\n");
+      if( (log_fsync = atoi( ptr )) < 0 )
+        log_fsync = 0;
     } else if( strncasecmp( "LOG_TYPE", ptr, 8 ) == 0 ) {
       ptr = strtok( NULL, " \t\n");
       log_type = atoi( ptr );
@@ -1948,6 +3521,14 @@ int read_rcfile( char *fname, struct _roms *sensor_list )
     } else if( strncasecmp( "READ_TIME", ptr, 9 ) == 0 ) {
       ptr = strtok( NULL, " \t\n");
       read_time = atoi( ptr );
+    } else if( strncasecmp( "READ_TRIES", ptr, 10 ) == 0 ) {
+      ptr = strtok( NULL, " \t\n");
+      if( (read_tries = atoi( ptr )) < 1 )
+        read_tries = 1;
+    } else if( strncasecmp( "CONVERT_TRIES", ptr, 13 ) == 0 ) {
+      ptr = strtok( NULL, " \t\n");
+      if( (convert_tries = atoi( ptr )) < 1 )
+        convert_tries = 1;
     } else if( strncasecmp( "SENSORS", ptr, 7 ) == 0 ) {
       ptr = strtok( NULL, " \t\n" );
       sensors = atoi( ptr );
@@ -1963,6 +3544,39 @@ int read_rcfile( char *fname, struct _roms *sensor_list )
         }
         sensor_list->max = sensors; 
       }
+    } else if( strncasecmp( "RESOLUTION", ptr, 10 ) == 0 ) {
+      /* Resolution of a DS18B20, DS1822 or DS28EA00 in bits */
+      ptr = strtok( NULL, " \t\n" );
+      if( (info = rc_sensor_info( bus, ptr, "RESOLUTION", line )) == NULL )
+      {
+        fclose( fp );
+        return -1;
+      }
+      ptr = strtok( NULL, " \t\n" );
+      x = atoi( ptr );
+      if( (x < 9) || (x > 12) )
+      {
+        fprintf( stderr, "Error, RESOLUTION on line %d must be 9 to 12 bits\n", line );
+        fclose( fp );
+        return -1;
+      }
+      info->resolution = x;
+    } else if( strncasecmp( "INTERVAL", ptr, 8 ) == 0 ) {
+      /* How often to read the sensor in mS */
+      ptr = strtok( NULL, " \t\n" );
+      if( (info = rc_sensor_info( bus, ptr, "INTERVAL", line )) == NULL )
+      {
+        fclose( fp );
+        return -1;
+      }
+      ptr = strtok( NULL, " \t\n" );
+      if( (ptr == NULL) || ((x = atoi( ptr )) < 0) )
+      {
+        fprintf( stderr, "Error, INTERVAL on line %d must be 0 or more mS\n", line );
+        fclose( fp );
+        return -1;
+      }
+      info->interval = x;
     } else if( strncasecmp( "ROM", ptr, 3 ) == 0 ) {
       /* Main LAN sensors */
       ptr = strtok( NULL, " \t\n" );
@@ -1989,13 +3603,7 @@ int read_rcfile( char *fname, struct _roms *sensor_list )
       if( (c_ptr = malloc( sizeof( struct _coupler ) ) ) == NULL )
       {
 	      fprintf( stderr, "Failed to allocate %d bytes for coupler linked list\n", (int) sizeof( struct _coupler ) );
-          free_coupler(0);
-#ifndef OWUSB
-	      owRelease(0);
-#else
-          owRelease(0, temp );
-          fprintf( stderr, "USB ERROR: %s\n", temp );
-#endif /* OWUSB */
+	      close_buses( num_open, 1 );
 	      exit(EXIT_ERR);
       }
 
@@ -2004,11 +3612,13 @@ int read_rcfile( char *fname, struct _roms *sensor_list )
       c_ptr->num_aux = 0;
       c_ptr->main = NULL;
       c_ptr->aux = NULL;
+      c_ptr->power[0] = c_ptr->power[1] = POWER_UNKNOWN;
+      c_ptr->convert_tick[0] = c_ptr->convert_tick[1] = 0;
 
-      if( coupler_top == NULL )
+      if( bus->coupler_top == NULL )
       {
 	/* First coupler, add it to the top of the list */
-	coupler_top = c_ptr;
+	bus->coupler_top = c_ptr;
 	coupler_end = c_ptr;
       } else {
         /* Add the new coupler to the list, point to new end */
@@ -2027,7 +3637,7 @@ int read_rcfile( char *fname, struct _roms *sensor_list )
       }
     } else if( strncasecmp( "CROM", ptr, 4 ) == 0 ) {
       /* Count the number of coupler connected sensors */
-      num_cs++;
+      bus->num_cs++;
 
       /* DS2409 Coupler sensors */    
       /* Ignore sensor #, they are all created in order */
@@ -2038,7 +3648,7 @@ int read_rcfile( char *fname, struct _roms *sensor_list )
        */
       ptr = strtok( NULL, " \t\n" );
       x = atoi(ptr);
-      c_ptr = coupler_top;
+      c_ptr = bus->coupler_top;
       while( c_ptr && (x > 0) )
       {
         c_ptr = c_ptr->next;
@@ -2060,13 +3670,7 @@ int read_rcfile( char *fname, struct _roms *sensor_list )
           if( (c_ptr->main = realloc( c_ptr->main, c_ptr->num_main * 8 ) ) == NULL )
           {
             fprintf( stderr, "Failed to allocate %d bytes for main branch\n", c_ptr->num_main * 8 );
-            free_coupler(0);
-#ifndef OWUSB
-            owRelease(0);
-#else
-            owRelease(0, temp );
-            fprintf( stderr, "USB ERROR: %s\n", temp );
-#endif /* OWUSB */
+            close_buses( num_open, 1 );
             exit(EXIT_ERR);
           }
 	  
@@ -2084,13 +3688,7 @@ int read_rcfile( char *fname, struct _roms *sensor_list )
           if( (c_ptr->aux = realloc( c_ptr->aux, c_ptr->num_aux * 8 ) ) == NULL )
           {
             fprintf( stderr, "Failed to allocate %d bytes for aux branch\n", c_ptr->num_aux * 8 );
-            free_coupler(0);
-#ifndef OWUSB
-            owRelease(0);
-#else
-            owRelease(0, temp );
-            fprintf( stderr, "USB ERROR: %s\n", temp );
-#endif /* OWUSB */
+            close_buses( num_open, 1 );
             exit(EXIT_ERR);
           } /* Allocate more aux space */
 	  
@@ -2116,50 +3714,15 @@ int read_rcfile( char *fname, struct _roms *sensor_list )
 
 
 /* -----------------------------------------------------------------------
-   Write a .digitemprc file, it contains:
-   
-   TTY <serial>
-   LOG <logfilepath>
-   READ_TIME <time in mS>
-   LOG_TYPE <from -o>
-   LOG_FORMAT <format string for temperature logging and printing>
-   CNT_FORMAT <format string for counter logging and printing>
-   ADC_FORMAT <format string for A/D converter logging and printing>
-   SENSORS <number of ROM lines>
-   Multiple ROM x <serial number in bytes> lines
-
-   v 2.3 additions:
-   Multiple COUPLER x <serial number in decimal> lines
-   CROM x <COUPLER #> <M or A> <Serial number in decimal>
-
-   v 2.4 additions:
-   All serial numbers are now in Hex.  Still can read older decimal
-     format. 
-   Added 'ALIAS # <string>'  
+   Write the sensors, couplers and sensor settings of one bus to the
+   .digitemprc file, numbered from 0 for each bus
    ----------------------------------------------------------------------- */
-int write_rcfile( char *fname, struct _roms *sensor_list )
+void write_bus( FILE *fp, struct _bus *bus )
 {
-  FILE	*fp;
-  int	x, y, i;
+  struct _roms    *sensor_list = &bus->sensor_list;
+  int             x, y, i;
   struct _coupler *c_ptr;
 
-  if( ( fp = fopen( fname, "wb" ) ) == NULL )
-  {
-    return -1;
-  }
-  
-  fprintf( fp, "TTY %s\n", serial_port );
-  if( log_file[0] != 0 )
-    fprintf( fp, "LOG %s\n", log_file );
-
-  fprintf( fp, "READ_TIME %d\n", read_time );		/* mSeconds	*/
-
-  fprintf( fp, "LOG_TYPE %d\n", log_type );
-  fprintf( fp, "LOG_FORMAT \"%s\"\n", temp_format );
-  fprintf( fp, "CNT_FORMAT \"%s\"\n", counter_format );
-  fprintf( fp, "HUM_FORMAT \"%s\"\n", humidity_format );
-  fprintf(fp, "ADC_FORMAT \"%s\"\n", adc_format);
-
   fprintf( fp, "SENSORS %d\n", sensor_list->max );
 
   for( x = 0; x < sensor_list->max; x++ )
@@ -2175,7 +3738,7 @@ int write_rcfile( char *fname, struct _roms *sensor_list )
 
   /* If any DS2409 Couplers were found, write out their information too */
   /* Write out the couplers first */
-  c_ptr = coupler_top;
+  c_ptr = bus->coupler_top;
   x =  0;
   while( c_ptr )
   {
@@ -2190,10 +3753,10 @@ int write_rcfile( char *fname, struct _roms *sensor_list )
   } /* Coupler list */
 
   /* Sendor # ID for coupler starts at num_sensors */
-  num_cs = 0;  
+  bus->num_cs = 0;  
 
   /* Start at the top of the coupler list */  
-  c_ptr = coupler_top;
+  c_ptr = bus->coupler_top;
   x =  0;
   while( c_ptr )
   {
@@ -2202,7 +3765,7 @@ int write_rcfile( char *fname, struct _roms *sensor_list )
     {
       for( i = 0; i < c_ptr->num_main; i++ )
       {
-        fprintf( fp, "CROM %d %d M ", sensor_list->max+num_cs++, x );
+        fprintf( fp, "CROM %d %d M ", sensor_list->max+bus->num_cs++, x );
 
         for( y = 0; y < 8; y++ )
         {
@@ -2217,7 +3780,7 @@ int write_rcfile( char *fname, struct _roms *sensor_list )
     {
       for( i = 0; i < c_ptr->num_aux; i++ )
       {
-        fprintf( fp, "CROM %d %d A ", sensor_list->max+num_cs++, x );
+        fprintf( fp, "CROM %d %d A ", sensor_list->max+bus->num_cs++, x );
 
         for( y = 0; y < 8; y++ )
         {
@@ -2230,7 +3793,86 @@ int write_rcfile( char *fname, struct _roms *sensor_list )
     x++;
     c_ptr = c_ptr->next;
   } /* Coupler list */
+
+  /* Write out the sensor resolutions and intervals */
+  for( x = 0; x < bus->sensor_info_max; x++ )
+  {
+    if( bus->sensor_info[x].resolution )
+      fprintf( fp, "RESOLUTION %d %d\n", x, bus->sensor_info[x].resolution );
+    if( bus->sensor_info[x].interval )
+      fprintf( fp, "INTERVAL %d %d\n", x, bus->sensor_info[x].interval );
+  }
+}
+
+
+/* -----------------------------------------------------------------------
+   Write a .digitemprc file, it contains:
+   
+   TTY <serial>
+   LOG <logfilepath>
+   READ_TIME <time in mS>
+   CONVERT_TRIES <conversions to try before giving up>
+   READ_TRIES <reads of each conversion on CRC errors>
+   LOG_FLUSH <lines to buffer, 0 writes them after every sample>
+   LOG_FSYNC <seconds between fsyncs of the logfile, 0 never>
+   LOG_TYPE <from -o>
+   LOG_FORMAT <format string for temperature logging and printing>
+   CNT_FORMAT <format string for counter logging and printing>
+   ADC_FORMAT <format string for A/D converter logging and printing>
+   SENSORS <number of ROM lines>
+   Multiple ROM x <serial number in bytes> lines
+
+   v 2.3 additions:
+   Multiple COUPLER x <serial number in decimal> lines
+   CROM x <COUPLER #> <M or A> <Serial number in decimal>
+
+   v 2.4 additions:
+   All serial numbers are now in Hex.  Still can read older decimal
+     format. 
+   Added 'ALIAS # <string>'  
+
+   RESOLUTION x <9 to 12 bits>
+   INTERVAL x <time between reads in mS>
+
+   Each bus after the first is written as its own TTY line followed by
+   its sensors.
+   ----------------------------------------------------------------------- */
+int write_rcfile( char *fname )
+{
+  FILE	*fp;
+  int	x;
+
+  if( ( fp = fopen( fname, "wb" ) ) == NULL )
+  {
+    return -1;
+  }
   
+  fprintf( fp, "TTY %s\n", buses[0].serial_port );
+  if( log_file[0] != 0 )
+    fprintf( fp, "LOG %s\n", log_file );
+
+  fprintf( fp, "READ_TIME %d\n", read_time );		/* mSeconds	*/
+  fprintf( fp, "CONVERT_TRIES %d\n", convert_tries );
+  fprintf( fp, "READ_TRIES %d\n", read_tries );
+
+  if( log_flush_records )
+    fprintf( fp, "LOG_FLUSH %d\n", log_flush_records );
+  if( log_fsync )
+    fprintf( fp, "LOG_FSYNC %d\n", log_fsync );
+  fprintf( fp, "LOG_TYPE %d\n", log_type );
+  fprintf( fp, "LOG_FORMAT \"%s\"\n", temp_format );
+  fprintf( fp, "CNT_FORMAT \"%s\"\n", counter_format );
+  fprintf( fp, "HUM_FORMAT \"%s\"\n", humidity_format );
+  fprintf(fp, "ADC_FORMAT \"%s\"\n", adc_format);
+
+  write_bus( fp, &buses[0] );
+
+  /* Each of the other buses has its own TTY, followed by its sensors */
+  for( x = 1; x < num_buses; x++ )
+  {
+    fprintf( fp, "TTY %s\n", buses[x].serial_port );
+    write_bus( fp, &buses[x] );
+  }
 
   fclose( fp );
   if( !(opts & OPT_QUIET) )
@@ -2262,7 +3904,7 @@ void printSN( unsigned char *TempSN, int crlf )
    Walk the entire connected 1-wire LAN and display the serial number
    and type of device.
    ----------------------------------------------------------------------- */      
-int Walk1Wire()
+int Walk1Wire( struct _bus *bus )
 {
   unsigned char TempSN[8],
                 InfoByte[3];
@@ -2286,10 +3928,10 @@ int Walk1Wire()
   {
     printf("Turning off all DS2409 Couplers\n");
   }
-  result = owFirst( 0, TRUE, FALSE );
+  result = owFirst( bus->portnum, TRUE, FALSE );
   while(result)
   {
-    owSerialNum( 0, TempSN, TRUE );
+    owSerialNum( bus->portnum, TempSN, TRUE );
     if( !(opts & OPT_QUIET) )
     {
       printf(".");
@@ -2298,7 +3940,7 @@ int Walk1Wire()
     if( TempSN[0] == SWITCH_FAMILY )
     {
       /* Turn off the Coupler */
-      if(!SetSwitch1F(0, TempSN, ALL_LINES_OFF, 0, InfoByte, TRUE))
+      if(!SetSwitch1F(bus->portnum, TempSN, ALL_LINES_OFF, 0, InfoByte, TRUE))
       {
         fprintf( stderr, "Setting Coupler to OFF state failed\n");
 
@@ -2308,7 +3950,7 @@ int Walk1Wire()
         return -1;
       }
     }
-    result = owNext( 0, TRUE, FALSE );
+    result = owNext( bus->portnum, TRUE, FALSE );
   } /* HUB search */
   if( !(opts &OPT_QUIET) )
   {
@@ -2322,10 +3964,10 @@ int Walk1Wire()
   {
     printf("Devices on the Main LAN\n");
   }
-  result = owFirst( 0, TRUE, FALSE );
+  result = owFirst( bus->portnum, TRUE, FALSE );
   while(result)
   {
-    owSerialNum( 0, TempSN, TRUE );
+    owSerialNum( bus->portnum, TempSN, TRUE );
     /* Print the serial number */    
     printSN( TempSN, 0 );
     printf(" : %s\n", device_name( TempSN[0]) );
@@ -2346,10 +3988,10 @@ int Walk1Wire()
 
         return -1;
       }
-      owSerialNum( 0, &coupler_list.roms[(coupler_list.max-1)*8], TRUE );
+      owSerialNum( bus->portnum, &coupler_list.roms[(coupler_list.max-1)*8], TRUE );
         
       /* Turn off the Coupler */
-      if(!SetSwitch1F(0, TempSN, ALL_LINES_OFF, 0, InfoByte, TRUE))
+      if(!SetSwitch1F(bus->portnum, TempSN, ALL_LINES_OFF, 0, InfoByte, TRUE))
       {
         fprintf(stderr, "Setting Switch to OFF state failed\n");
 
@@ -2359,7 +4001,7 @@ int Walk1Wire()
         return -1;
       }
     }
-    result = owNext( 0, TRUE, FALSE );
+    result = owNext( bus->portnum, TRUE, FALSE );
   } /* HUB search */
   if( !(opts & OPT_QUIET) )
   {
@@ -2376,16 +4018,16 @@ int Walk1Wire()
         printf("\nDevices on Main Branch of Coupler : ");
         printSN( &coupler_list.roms[x*8], 1 );
       }
-      result = owBranchFirst( 0, &coupler_list.roms[x * 8], FALSE, TRUE );
+      result = owBranchFirst( bus->portnum, &coupler_list.roms[x * 8], FALSE, TRUE );
       while(result)
       {
-        owSerialNum( 0, TempSN, TRUE );
+        owSerialNum( bus->portnum, TempSN, TRUE );
 
         /* Print the serial number */    
         printSN( TempSN, 0 );
         printf(" : %s\n", device_name( TempSN[0]) );
 
-        result = owBranchNext(0, &coupler_list.roms[x * 8], FALSE, TRUE );
+        result = owBranchNext(bus->portnum, &coupler_list.roms[x * 8], FALSE, TRUE );
       } /* Main branch loop */
       
       if( !(opts & OPT_QUIET) )
@@ -2394,16 +4036,16 @@ int Walk1Wire()
         printf("Devices on Aux Branch of Coupler : ");
         printSN( &coupler_list.roms[x*8], 1 );
       }
-      result = owBranchFirst( 0, &coupler_list.roms[x * 8], FALSE, FALSE );
+      result = owBranchFirst( bus->portnum, &coupler_list.roms[x * 8], FALSE, FALSE );
       while(result)
       {
-        owSerialNum( 0, TempSN, TRUE );
+        owSerialNum( bus->portnum, TempSN, TRUE );
 
         /* Print the serial number */    
         printSN( TempSN, 0 );
         printf(" : %s\n", device_name( TempSN[0]) );
 
-        result = owBranchNext(0, &coupler_list.roms[x * 8], FALSE, FALSE );
+        result = owBranchNext(bus->portnum, &coupler_list.roms[x * 8], FALSE, FALSE );
       } /* Aux Branch loop */
     }  /* Coupler loop */
   } /* num_couplers check */
@@ -2443,17 +4085,29 @@ int sercmp( unsigned char *sn1, unsigned char *sn2 )
 /* -----------------------------------------------------------------------
    Find all the supported temperature sensors on the bus, searching down
    DS2409 hubs on the main bus (but not on other hubs).
+
+   The caller writes the new list of sensors to the rc file once all of
+   the buses have been searched, see init_buses().
    ----------------------------------------------------------------------- */
-int Init1WireLan( struct _roms *sensor_list )
+int Init1WireLan( struct _bus *bus )
 {
+  struct _roms  *sensor_list = &bus->sensor_list;
   unsigned char TempSN[8],
-                InfoByte[3];
+                InfoByte[3],
+                *sn;
   int result,
       x;
   unsigned int found_sensors = 0;
   struct _coupler       *c_ptr,         /* Coupler pointer              */
                         *coupler_end;   /* end of the list              */
 
+  /* Remember which sensor each setting belongs to, the numbers change */
+  for( x = 0; x < bus->sensor_info_max; x++ )
+  {
+    if( (sn = get_sensor_sn( bus, x )) != NULL )
+      memcpy( bus->sensor_info[x].SN, sn, 8 );
+  }
+
   /* Free up anything that was read from .digitemprc */
   if( sensor_list->roms != NULL )
   {
@@ -2461,22 +4115,22 @@ int Init1WireLan( struct _roms *sensor_list )
     sensor_list->roms = NULL;
   }
   sensor_list->max = 0;
-  num_cs = 0;
+  bus->num_cs = 0;
 
   /* Free up the coupler list */
-  free_coupler(0);
+  free_coupler( bus, 0);
 
   /* Initialize the coupler pointer */
-  coupler_end = coupler_top;
+  coupler_end = bus->coupler_top;
 
   if( !(opts & OPT_QUIET) )
   {
     printf("Turning off all DS2409 Couplers\n");
   }
-  result = owFirst( 0, TRUE, FALSE );
+  result = owFirst( bus->portnum, TRUE, FALSE );
   while(result)
   {
-    owSerialNum( 0, TempSN, TRUE );
+    owSerialNum( bus->portnum, TempSN, TRUE );
     if( !(opts & OPT_QUIET) )
     {
       printf(".");
@@ -2485,14 +4139,14 @@ int Init1WireLan( struct _roms *sensor_list )
     if( TempSN[0] == SWITCH_FAMILY )
     {
       /* Turn off the Coupler */
-      if(!SetSwitch1F(0, TempSN, ALL_LINES_OFF, 0, InfoByte, TRUE))
+      if(!SetSwitch1F(bus->portnum, TempSN, ALL_LINES_OFF, 0, InfoByte, TRUE))
       {
         fprintf( stderr, "Setting Coupler to OFF state failed\n");
-        free_coupler(0);
+        free_coupler( bus, 0);
         return -1;
       }
     }
-    result = owNext( 0, TRUE, FALSE );
+    result = owNext( bus->portnum, TRUE, FALSE );
   } /* HUB OFF search */ 
   if( !(opts & OPT_QUIET) )
   {
@@ -2504,10 +4158,10 @@ int Init1WireLan( struct _roms *sensor_list )
     printf("Searching the 1-Wire LAN\n");
   }
   /* Find any DS2409 Couplers and turn them all off */
-  result = owFirst( 0, TRUE, FALSE );
+  result = owFirst( bus->portnum, TRUE, FALSE );
   while(result)
   {
-    owSerialNum( 0, TempSN, TRUE );
+    owSerialNum( bus->portnum, TempSN, TRUE );
 
     if( TempSN[0] == SWITCH_FAMILY )
     {
@@ -2520,23 +4174,25 @@ int Init1WireLan( struct _roms *sensor_list )
       if( (c_ptr = malloc( sizeof( struct _coupler ) ) ) == NULL )
       {
         fprintf( stderr, "Failed to allocate %d bytes for coupler linked list\n", (int) sizeof( struct _coupler ) );
-        free_coupler(0);
+        free_coupler( bus, 0);
         return -1;
       }
 
       /* Write the serial number to the new list entry */
-      owSerialNum( 0, c_ptr->SN, TRUE );
+      owSerialNum( bus->portnum, c_ptr->SN, TRUE );
 
       c_ptr->next = NULL;
       c_ptr->num_main = 0;
       c_ptr->num_aux = 0;
       c_ptr->main = NULL;
       c_ptr->aux = NULL;
+      c_ptr->power[0] = c_ptr->power[1] = POWER_UNKNOWN;
+      c_ptr->convert_tick[0] = c_ptr->convert_tick[1] = 0;
         
-      if( coupler_top == NULL )
+      if( bus->coupler_top == NULL )
       {
         /* First coupler, add it to the top of the list */
-        coupler_top = c_ptr;
+        bus->coupler_top = c_ptr;
         coupler_end = c_ptr;
       } else {
         /* Add the new coupler to the end of the list, point to new end */
@@ -2578,20 +4234,20 @@ int Init1WireLan( struct _roms *sensor_list )
         }
         return -1;
       }
-      owSerialNum( 0, &sensor_list->roms[(sensor_list->max-1)*8], TRUE );
+      owSerialNum( bus->portnum, &sensor_list->roms[(sensor_list->max-1)*8], TRUE );
     }
-    result = owNext( 0, TRUE, FALSE );
+    result = owNext( bus->portnum, TRUE, FALSE );
   }    
 
   /* Now go through each coupler branch and search there */
-  c_ptr = coupler_top;
+  c_ptr = bus->coupler_top;
   while( c_ptr )
   {
     /* Search the Main branch */
-    result = owBranchFirst( 0, c_ptr->SN, FALSE, TRUE );
+    result = owBranchFirst( bus->portnum, c_ptr->SN, FALSE, TRUE );
     while(result)
     {
-      owSerialNum( 0, TempSN, TRUE );
+      owSerialNum( bus->portnum, TempSN, TRUE );
 
       /* Check to see if it is a temperature sensor or a PIO device */
       if( (TempSN[0] == DS1820_FAMILY) ||
@@ -2618,7 +4274,7 @@ int Init1WireLan( struct _roms *sensor_list )
         if( (c_ptr->main = realloc( c_ptr->main, c_ptr->num_main * 8 ) ) == NULL )
         {
           fprintf( stderr, "Failed to allocate %d bytes for main branch\n", c_ptr->num_main * 8 );
-          free_coupler(0);
+          free_coupler( bus, 0);
           if( sensor_list->roms )
           {
             free( sensor_list->roms );
@@ -2626,18 +4282,18 @@ int Init1WireLan( struct _roms *sensor_list )
           }
           return -1;
         }
-        owSerialNum( 0, &c_ptr->main[(c_ptr->num_main-1)*8], TRUE );
+        owSerialNum( bus->portnum, &c_ptr->main[(c_ptr->num_main-1)*8], TRUE );
       } /* Add serial number to list */
         
       /* Find the next device on this branch */
-      result = owBranchNext(0, c_ptr->SN, FALSE, TRUE );
+      result = owBranchNext(bus->portnum, c_ptr->SN, FALSE, TRUE );
     } /* Main branch loop */
       
     /* Search the Aux branch */
-    result = owBranchFirst( 0, c_ptr->SN, FALSE, FALSE );
+    result = owBranchFirst( bus->portnum, c_ptr->SN, FALSE, FALSE );
     while(result)
     {
-      owSerialNum( 0, TempSN, TRUE );
+      owSerialNum( bus->portnum, TempSN, TRUE );
 
       if( (TempSN[0] == DS1820_FAMILY) ||
           (TempSN[0] == DS1822_FAMILY) ||
@@ -2663,7 +4319,7 @@ int Init1WireLan( struct _roms *sensor_list )
         if( (c_ptr->aux = realloc( c_ptr->aux, c_ptr->num_aux * 8 ) ) == NULL )
         {
           fprintf( stderr, "Failed to allocate %d bytes for aux branch\n", c_ptr->num_main * 8 );
-          free_coupler(0);
+          free_coupler( bus, 0);
           if( sensor_list->roms )
           {
             free( sensor_list->roms );
@@ -2671,11 +4327,11 @@ int Init1WireLan( struct _roms *sensor_list )
           }
           return -1;
         }
-        owSerialNum( 0, &c_ptr->aux[(c_ptr->num_aux-1)*8], TRUE );
+        owSerialNum( bus->portnum, &c_ptr->aux[(c_ptr->num_aux-1)*8], TRUE );
       } /* Add serial number to list */
         
       /* Find the next device on this branch */
-      result = owBranchNext(0, c_ptr->SN, FALSE, FALSE );
+      result = owBranchNext(bus->portnum, c_ptr->SN, FALSE, FALSE );
     } /* Aux branch loop */
       
     c_ptr = c_ptr->next;
@@ -2688,18 +4344,21 @@ int Init1WireLan( struct _roms *sensor_list )
   */ 
   if( found_sensors )
   {
+    /* The buses before this one have been searched already */
+    number_buses();
+
     /* Was anything found on the main branch? */
     if( sensor_list->max > 0 )
     {
       for( x = 0; x < sensor_list->max; x++ )
       {
-        printf("ROM #%d : ", x );
+        printf("ROM #%d : ", bus->first + x );
         printSN( &sensor_list->roms[x*8], 1 );
       }
     } /* num_sensors check */
       
     /* Was anything found on any DS2409 couplers? */
-    c_ptr = coupler_top;
+    c_ptr = bus->coupler_top;
     while( c_ptr )      
     {
       /* Check the main branch */
@@ -2707,7 +4366,7 @@ int Init1WireLan( struct _roms *sensor_list )
       {
         for( x = 0; x < c_ptr->num_main; x++ )
         {    
-          printf("ROM #%d : ", sensor_list->max+num_cs++ );
+          printf("ROM #%d : ", bus->first+sensor_list->max+bus->num_cs++ );
           printSN( &c_ptr->main[x*8], 1 );
         }
       }
@@ -2717,7 +4376,7 @@ int Init1WireLan( struct _roms *sensor_list )
       {
         for( x = 0; x < c_ptr->num_aux; x++ )
         {    
-          printf("ROM #%d : ", sensor_list->max+num_cs++ );
+          printf("ROM #%d : ", bus->first+sensor_list->max+bus->num_cs++ );
           printSN( &c_ptr->aux[x*8], 1 );
         }
       }
@@ -2726,13 +4385,51 @@ int Init1WireLan( struct _roms *sensor_list )
       c_ptr = c_ptr->next;
     } /* Coupler list loop */
 
-    /* Write the new list of sensors to the current directory */
-    write_rcfile( conf_file, sensor_list );
+    /* Move the RESOLUTION and INTERVAL settings to the new sensor numbers */
+    renumber_sensor_info( bus );
+  }
+  return 0;
+}
+
+
+/* -----------------------------------------------------------------------
+   Search all of the buses and write the sensors that were found to the
+   rc file
+   ----------------------------------------------------------------------- */
+int init_buses()
+{
+  int x;
+
+  for( x = 0; x < num_buses; x++ )
+  {
+    if( Init1WireLan( &buses[x] ) != 0 )
+      return -1;
   }
+
+  /* Write the new list of sensors to the current directory */
+  if( number_buses() > 0 )
+    write_rcfile( conf_file );
+
   return 0;
 }
 
 
+/* ----------------------------------------------------------------------- *
+   The device file of a port, for checking that it is there. NULL if the
+   adapter doesn't use one, like the DS2490 or a kernel w1 master.
+ * ----------------------------------------------------------------------- */
+char *port_file( char *port )
+{
+#if defined(OWMULTI)
+  return owPortFile( port );
+#elif defined(OWUSB) || defined(OWW1)
+  return NULL;
+#else
+  return port;
+#endif
+}
+
+
 /* ----------------------------------------------------------------------- *
    Check to see if the file actually exists
  * ----------------------------------------------------------------------- */
@@ -2749,6 +4446,243 @@ int file_exists (char * fileName)
 }
 
 
+/* ----------------------------------------------------------------------- *
+   Override the .digitemprc settings with the ones from the command line
+ * ----------------------------------------------------------------------- */
+void apply_options()
+{
+  if (tmp_read_time > 0) {
+	read_time = tmp_read_time;
+  }
+  
+  if (tmp_serial_port[0] != 0) {
+	strncpy( buses[0].serial_port, tmp_serial_port, sizeof(buses[0].serial_port)-1 );
+        buses[0].serial_port[sizeof(buses[0].serial_port)-1] = 0x00;
+  }
+  
+  if (tmp_log_file[0] != 0) {
+	strncpy( log_file, tmp_log_file, sizeof(log_file)-1 );
+        log_file[sizeof(log_file)-1] = 0x00;
+  }
+  
+  if (tmp_log_type != -1) {
+    log_type = tmp_log_type;
+    if ( tmp_log_type == 0 )
+    {
+      strncpy( temp_format, tmp_temp_format, sizeof(temp_format)-1 );
+      temp_format[sizeof(temp_format)-1] = 0x00;
+    }
+  }
+
+  if( tmp_counter_format[0] != 0 ) {
+    strncpy( counter_format, tmp_counter_format, sizeof(counter_format)-1 );
+    counter_format[sizeof(counter_format)-1] = 0x00;
+  }
+  
+  if( tmp_humidity_format[0] != 0 ) {
+    strncpy( humidity_format, tmp_humidity_format, sizeof(humidity_format)-1 );
+    humidity_format[sizeof(humidity_format)-1] = 0x00;
+  }
+  
+  if( tmp_adc_format[0] != 0 ) {
+    strncpy(adc_format, tmp_adc_format, sizeof(adc_format)-1 );
+    adc_format[sizeof(adc_format)-1] = 0x00;
+  }
+}
+
+
+/* -----------------------------------------------------------------------
+   Compile the output formats after they have been read or changed
+   ----------------------------------------------------------------------- */
+void compile_formats()
+{
+  free_formats();
+  temp_prog = fmt_compile( temp_format, FMT_TEMPERATURE );
+  counter_prog = fmt_compile( counter_format, FMT_COUNTER );
+  humidity_prog = fmt_compile( humidity_format, FMT_TEMPERATURE );
+  adc_prog = fmt_compile( adc_format, FMT_ADC );
+}
+
+
+/* -----------------------------------------------------------------------
+   Free the compiled output formats, the log functions go back to parsing
+   the format strings every time.
+   ----------------------------------------------------------------------- */
+void free_formats()
+{
+  fmt_free( temp_prog );
+  fmt_free( counter_prog );
+  fmt_free( humidity_prog );
+  fmt_free( adc_prog );
+  temp_prog = counter_prog = humidity_prog = adc_prog = NULL;
+}
+
+
+/* ----------------------------------------------------------------------- *
+   Save or restore the settings read_rcfile changes
+ * ----------------------------------------------------------------------- */
+void save_rc_state( struct _rc_state *rc )
+{
+  memcpy( rc->buses, buses, sizeof(buses) );
+  rc->num_buses = num_buses;
+  strcpy( rc->log_file, log_file );
+  strcpy( rc->temp_format, temp_format );
+  strcpy( rc->counter_format, counter_format );
+  strcpy( rc->humidity_format, humidity_format );
+  strcpy( rc->adc_format, adc_format );
+  rc->read_time = read_time;
+  rc->read_tries = read_tries;
+  rc->convert_tries = convert_tries;
+  rc->log_type = log_type;
+  rc->log_flush_records = log_flush_records;
+  rc->log_fsync = log_fsync;
+}
+
+void restore_rc_state( struct _rc_state *rc )
+{
+  memcpy( buses, rc->buses, sizeof(buses) );
+  num_buses = rc->num_buses;
+  strcpy( log_file, rc->log_file );
+  strcpy( temp_format, rc->temp_format );
+  strcpy( counter_format, rc->counter_format );
+  strcpy( humidity_format, rc->humidity_format );
+  strcpy( adc_format, rc->adc_format );
+  read_time = rc->read_time;
+  read_tries = rc->read_tries;
+  convert_tries = rc->convert_tries;
+  log_type = rc->log_type;
+  log_flush_records = rc->log_flush_records;
+  log_fsync = rc->log_fsync;
+}
+
+
+/* ----------------------------------------------------------------------- *
+   Re-read the .digitemprc file without closing the serial port
+
+   Called from the daemon loop when SIGHUP is received. The serial port
+   stays open, so a new TTY only takes effect after a restart. Nothing is
+   sent to the bus, the couplers are left the way they are.
+
+   The file is read into empty buses, the old ones and the old settings
+   are only freed once it has been read. If it can't be read everything
+   is put back the way it was and -1 is returned.
+ * ----------------------------------------------------------------------- */
+int reload_rcfile()
+{
+  static struct _rc_state old;
+  int  x;
+
+  save_rc_state( &old );
+  for( x = 0; x < num_buses; x++ )
+    init_bus( &buses[x], x );
+
+  if( read_rcfile( conf_file ) < 0 )
+  {
+    for( x = 0; x < num_buses; x++ )
+      free_bus( &buses[x], 1 );
+    restore_rc_state( &old );
+    return -1;
+  }
+
+  for( x = 0; x < old.num_buses; x++ )
+    free_bus( &old.buses[x], 1 );
+
+  /* LOG may point somewhere else now */
+  log_close();
+  log_secs = -1;
+
+  apply_options();
+  compile_formats();
+
+  /* Only the ports that are already open can be used */
+  for( x = old.num_buses; x < num_buses; x++ )
+  {
+    fprintf( stderr, "Warning: new TTY %s ignored until restart\n", buses[x].serial_port );
+    free_bus( &buses[x], 1 );
+  }
+  if( num_buses > old.num_buses )
+    num_buses = old.num_buses;
+
+  for( x = 0; x < num_buses; x++ )
+  {
+    if( strcmp( old.buses[x].serial_port, buses[x].serial_port ) != 0 )
+    {
+      fprintf( stderr, "Warning: new TTY %s ignored until restart\n", buses[x].serial_port );
+      strcpy( buses[x].serial_port, old.buses[x].serial_port );
+    }
+
+    /* The coupler branch that is on is still on */
+    memcpy( buses[x].Last2409, old.buses[x].Last2409, sizeof(buses[x].Last2409) );
+  }
+  number_buses();
+
+  return 0;
+}
+
+
+/* ----------------------------------------------------------------------- *
+   Signal handler for the daemon loop, just set a flag
+ * ----------------------------------------------------------------------- */
+void daemon_signal( int sig )
+{
+  if( sig == SIGHUP )
+    daemon_reload = 1;
+  else
+    daemon_quit = 1;
+}
+
+
+/* ----------------------------------------------------------------------- *
+   Add msec milliseconds to a timespec
+ * ----------------------------------------------------------------------- */
+void add_msec( struct timespec *ts, long msec )
+{
+  ts->tv_sec += msec / 1000;
+  ts->tv_nsec += (msec % 1000) * 1000000L;
+  if( ts->tv_nsec >= 1000000000L )
+  {
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000L;
+  }
+}
+
+
+/* ----------------------------------------------------------------------- *
+   Return a - b in milliseconds
+ * ----------------------------------------------------------------------- */
+long diff_msec( struct timespec *a, struct timespec *b )
+{
+  return (a->tv_sec - b->tv_sec) * 1000L +
+         (a->tv_nsec - b->tv_nsec) / 1000000L;
+}
+
+
+/* ----------------------------------------------------------------------- *
+   Sleep until an absolute CLOCK_MONOTONIC deadline
+
+   Returns 0 when the deadline is reached, or EINTR if a signal arrived
+ * ----------------------------------------------------------------------- */
+int sleep_until( struct timespec *deadline )
+{
+#ifdef DARWIN
+  /* No clock_nanosleep, sleep for what is left instead */
+  struct timespec now, left;
+  long            msec;
+
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  if( (msec = diff_msec( deadline, &now )) <= 0 )
+    return 0;
+  left.tv_sec = msec / 1000;
+  left.tv_nsec = (msec % 1000) * 1000000L;
+  if( nanosleep( &left, NULL ) < 0 )
+    return errno;
+  return 0;
+#else
+  return clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL );
+#endif /* DARWIN */
+}
+
+
 /* ----------------------------------------------------------------------- *
    DigiTemp main routine
    
@@ -2762,14 +4696,22 @@ int main( int argc, char *argv[] )
   int		sample_delay = 0;	/* Delay between samples (SEC)	*/
   unsigned int	x,
   		num_samples = 1;	/* Number of samples 		*/
-  time_t	last_time,		/* Last time we started samples */
-		start_time;		/* Starting time		*/
-  long int	elapsed_time;		/* Elapsed from start		*/
-  struct _roms  sensor_list;            /* Attached Roms                */
-
-
-  /* Make sure the structure is erased */
-  bzero( &sensor_list, sizeof( struct _roms ) );
+  time_t	start_time;		/* Starting time		*/
+  long int	elapsed_time,		/* Elapsed from start		*/
+		delay_msec,		/* Delay between samples in mS	*/
+		sweep_msec;		/* Time taken to read sensors	*/
+  int		samples_set = 0;	/* -n was given			*/
+  int		bench_sweeps = 0;	/* Sweeps to benchmark		*/
+  struct timespec deadline,		/* When the next sample is due	*/
+		now;
+  struct sigaction sa;
+  sigset_t	daemon_sigs;		/* Signals the daemon handles	*/
+  struct _bus	*bus;			/* Bus the single sensor is on	*/
+  char		*file;			/* Device file of a port	*/
+
+
+  /* Make sure the first bus is erased */
+  init_bus( &buses[0], 0 );
  
 
   if( argc <= 1 )
@@ -2779,10 +4721,12 @@ int main( int argc, char *argv[] )
     return -1;
   }
 
-#ifndef OWUSB
-  serial_port[0] = 0;			/* No default port		*/
+#if defined(OWUSB)
+  strcpy( buses[0].serial_port, "USB" );
+#elif defined(OWW1)
+  strcpy( buses[0].serial_port, "w1_bus_master1" );
 #else
-  strcpy( serial_port, "USB" );
+  buses[0].serial_port[0] = 0;		/* No default port		*/
 #endif
   tmp_serial_port[0] = 0;
   log_file[0] = 0;			/* No default log file		*/
@@ -2807,7 +4751,7 @@ int main( int argc, char *argv[] )
   strcpy( humidity_format, "%b %d %H:%M:%S Sensor %s C: %.2C F: %.2F H: %h%%" );
   strcpy( adc_format, "%b %d %H:%M:%S Sensor %s VDD: %0.2Q AD: %0.2q C: %0.2C");
   strcpy( conf_file, ".digitemprc" );
-  strcpy( option_list, "?ThqiaAvwr:f:s:l:t:d:n:o:c:O:H:V:" );
+  strcpy( option_list, "?ThqiaAvwDr:f:s:l:t:d:n:o:c:O:H:V:B:" );
 
 
   /* Command line options override any .digitemprc options temporarily	*/
@@ -2816,7 +4760,11 @@ int main( int argc, char *argv[] )
 
   opterr = 1;
 
+#ifdef HAVE_GETOPT_LONG
+  while( (c = getopt_long(argc, argv, option_list, long_options, NULL)) != -1 )
+#else
   while( (c = getopt(argc, argv, option_list)) != -1 )
+#endif /* HAVE_GETOPT_LONG */
   {
     /* Process the command line arguments */
     switch( c )
@@ -2876,6 +4824,17 @@ int main( int argc, char *argv[] )
       case 'n': if(optarg)			/* Number of samples 	*/
 		{
 		  num_samples = atoi(optarg);
+		  samples_set = 1;
+		}
+		break;
+
+      case 'D': opts |= OPT_DAEMON;		/* Keep running		*/
+		break;
+
+      case 'B': if(optarg)			/* Benchmark		*/
+		{
+		  bench_sweeps = atoi(optarg);
+		  opts |= OPT_BENCH;
 		}
 		break;
 
@@ -2949,59 +4908,44 @@ int main( int argc, char *argv[] )
 
   /* Run some internal tests */
   if ( opts & OPT_TEST ) {
-    exit(test_build_af());
+    x = test_build_af();
+    x = test_format_prog() || x;
+    exit( x );
   }
 
   /* Require one 1 action command, no more, no less. */
-  if ((opts & (OPT_WALK|OPT_INIT|OPT_SINGLE|OPT_ALL)) == 0 )
+  if ((opts & (OPT_WALK|OPT_INIT|OPT_SINGLE|OPT_ALL|OPT_BENCH)) == 0 )
   {
-    fprintf( stderr, "Error!  You need 1 of the following action commands, -w -a -i -t\n");
+    fprintf( stderr, "Error!  You need 1 of the following action commands, -w -a -i -t -B\n");
     exit(EXIT_HELP);
   }
 
-  if ( read_rcfile( conf_file, &sensor_list ) < 0 ) {
-    exit(EXIT_NORC);
-  }
-
-  /* Now we go through and override with values from the command line */
-  if (tmp_read_time > 0) {
-	read_time = tmp_read_time;
-  }
-  
-  if (tmp_serial_port[0] != 0) {
-	strncpy( serial_port, tmp_serial_port, sizeof(serial_port)-1 );
-        serial_port[sizeof(serial_port)-1] = 0x00;
-  }
-  
-  if (tmp_log_file[0] != 0) {
-	strncpy( log_file, tmp_log_file, sizeof(log_file)-1 );
-        log_file[sizeof(log_file)-1] = 0x00;
-  }
-  
-  if (tmp_log_type != -1) {
-    log_type = tmp_log_type;
-    if ( tmp_log_type == 0 )
+  /* The daemon needs something to read, and runs until it is stopped */
+  if( opts & OPT_DAEMON )
+  {
+    if( (opts & (OPT_SINGLE|OPT_ALL)) == 0 )
     {
-      strncpy( temp_format, tmp_temp_format, sizeof(temp_format)-1 );
-      temp_format[sizeof(temp_format)-1] = 0x00;
+      fprintf( stderr, "Error!  --daemon needs -a or -t\n");
+      exit(EXIT_HELP);
+    }
+    /* Without a delay it would never sleep, and never let in a signal */
+    if( sample_delay <= 0 )
+    {
+      fprintf( stderr, "Error!  --daemon needs a -d delay greater than 0\n");
+      exit(EXIT_HELP);
     }
+    if( !samples_set )
+      num_samples = 0;
   }
 
-  if( tmp_counter_format[0] != 0 ) {
-    strncpy( counter_format, tmp_counter_format, sizeof(counter_format)-1 );
-    counter_format[sizeof(counter_format)-1] = 0x00;
-  }
-  
-  if( tmp_humidity_format[0] != 0 ) {
-    strncpy( humidity_format, tmp_humidity_format, sizeof(humidity_format)-1 );
-    humidity_format[sizeof(humidity_format)-1] = 0x00;
-  }
-  
-  if( tmp_adc_format[0] != 0 ) {
-    strncpy(adc_format, tmp_adc_format, sizeof(adc_format)-1 );
-    adc_format[sizeof(adc_format)-1] = 0x00;
+  if ( read_rcfile( conf_file ) < 0 ) {
+    exit(EXIT_NORC);
   }
 
+  /* Now we go through and override with values from the command line */
+  apply_options();
+  compile_formats();
+
   /* Show the copyright banner? */
   if( !(opts & OPT_QUIET) )
   {
@@ -3009,74 +4953,68 @@ int main( int argc, char *argv[] )
     printf(BANNER_2);
   }
 
-#ifndef OWUSB
-  /* Check to see if the device file actually exists */
-  if( !file_exists( serial_port ) )
+  for( c = 0; c < num_buses; c++ )
   {
-    fprintf( stderr, "Error, serial port '%s' does not exist!\n", serial_port );
-
-    if( sensor_list.roms != NULL )
-      free( sensor_list.roms );
-
-    if( coupler_top != NULL )
-      free_coupler(1);
-
-    exit(EXIT_NOPORT);
-  }
-
-  /* Check to make sure we have permission to access the port */
-  if( access( serial_port, R_OK|W_OK ) < 0 ) {
-    fprintf( stderr, "Error, you don't have +rw permission to access serial port: %s\n", serial_port );
-
-    if( sensor_list.roms != NULL )
-      free( sensor_list.roms );
-
-    if( coupler_top != NULL )
-      free_coupler(1);
+    /* Check to see if the device file actually exists */
+    if( ((file = port_file( buses[c].serial_port )) != NULL) &&
+        !file_exists( file ) )
+    {
+      fprintf( stderr, "Error, serial port '%s' does not exist!\n", file );
+      close_buses( num_open, 1 );
+      exit(EXIT_NOPORT);
+    }
 
-    exit(EXIT_NOPERM);
-  }
-#endif		/* !OWUSB 	*/
+    /* Check to make sure we have permission to access the port */
+    if( (file != NULL) && (access( file, R_OK|W_OK ) < 0) ) {
+      fprintf( stderr, "Error, you don't have +rw permission to access serial port: %s\n", file );
+      close_buses( num_open, 1 );
+      exit(EXIT_NOPERM);
+    }
 
-  /* Connect to the MLan network */
+    /* Connect to the MLan network */
 #ifndef OWUSB
-  if( !owAcquire( 0, serial_port) )
-  {
+    if( !owAcquire( buses[c].portnum, buses[c].serial_port) )
+    {
 #else
-  if( !owAcquire( 0, serial_port, temp ) )
-  {
-    fprintf( stderr, "USB ERROR: %s\n", temp );
+    if( !owAcquire( buses[c].portnum, buses[c].serial_port, temp ) )
+    {
+      fprintf( stderr, "USB ERROR: %s\n", temp );
 #endif
     
-    /* Error connecting, print the error and exit */
-    OWERROR_DUMP(stdout);
+      /* Error connecting, print the error and exit */
+      OWERROR_DUMP(stdout);
+      close_buses( num_open, 1 );
+      exit(EXIT_ERR);
+    }
+    num_open++;
+  }
+  number_buses();
+
 
-    if( sensor_list.roms != NULL )
-      free( sensor_list.roms );
+  /* Time the search, the sweeps and the logging, then quit */
+  if( opts & OPT_BENCH )
+  {
+    x = run_bench( bench_sweeps );
 
-    if( coupler_top != NULL )
-      free_coupler(0);
+    close_buses( num_open, 0 );
+    free_formats();
+    log_close();
 
-    exit(EXIT_ERR);
+    exit( x ? EXIT_ERR : EXIT_OK );
   }
 
 
   /* Should we walk the whole LAN and display all devices? */
   if( opts & OPT_WALK )
   {
-    Walk1Wire();
-
-    if( sensor_list.roms != NULL )
-      free( sensor_list.roms );
-
-    if( coupler_top != NULL )
-      free_coupler(0);
+    for( c = 0; c < num_buses; c++ )
+    {
+      if( num_buses > 1 )
+        printf( "%s:\n", buses[c].serial_port );
+      Walk1Wire( &buses[c] );
+    }
 
-#ifndef OWUSB
-      owRelease(0);
-#else
-      owRelease(0, temp );
-#endif /* OWUSB */
+    close_buses( num_open, 0 );
 
     exit(EXIT_OK);
   }
@@ -3087,22 +5025,10 @@ int main( int argc, char *argv[] )
   /* This should store the serial numbers to the .digitemprc file      */
   if( opts & OPT_INIT )
   {
-    if( Init1WireLan( &sensor_list ) != 0 )
+    if( init_buses() != 0 )
     {
-      if( sensor_list.roms != NULL )
-        free( sensor_list.roms );
-
-      if( coupler_top != NULL )
-        free_coupler(0);
-
-      /* Close the serial port */
-#ifndef OWUSB
-      owRelease(0);
-#else
-      owRelease(0, temp );
-      fprintf( stderr, "USB ERROR: %s\n", temp );
-#endif /* OWUSB */
-
+      /* Close the serial ports */
+      close_buses( num_open, 0 );
       exit(EXIT_ERR);
     }
   }
@@ -3117,11 +5043,41 @@ int main( int argc, char *argv[] )
               break;
   }
 
+  /* The daemon takes the delay in mS, the normal loop in seconds */
+  if( opts & OPT_DAEMON )
+    delay_msec = sample_delay;
+  else
+    delay_msec = sample_delay * 1000L;
+
+  /* Stop cleanly on TERM and INT, re-read the rc file on HUP. They are
+     blocked while reading the sensors so they don't interrupt the serial
+     port I/O, and only let in while sleeping.
+  */
+  if( opts & OPT_DAEMON )
+  {
+    sigemptyset( &daemon_sigs );
+    sigaddset( &daemon_sigs, SIGTERM );
+    sigaddset( &daemon_sigs, SIGINT );
+    sigaddset( &daemon_sigs, SIGHUP );
+    sigprocmask( SIG_BLOCK, &daemon_sigs, NULL );
+
+    bzero( &sa, sizeof( sa ) );
+    sa.sa_handler = daemon_signal;
+    sigemptyset( &sa.sa_mask );
+    sigaction( SIGTERM, &sa, NULL );
+    sigaction( SIGINT, &sa, NULL );
+    sigaction( SIGHUP, &sa, NULL );
+  }
+
+  /* Samples are scheduled on absolute deadlines, so the time it takes
+     to read the sensors doesn't add up over time.
+  */
+  clock_gettime( CLOCK_MONOTONIC, &deadline );
+
   /* Sample the prescribed number of times, 0=infinity */
-  for( x = 0;num_samples==0 || x < num_samples; x++ )
+  for( x = 0;(num_samples==0 || x < num_samples) && !daemon_quit; x++ )
   {
-    last_time = time(NULL);
-    elapsed_time = last_time - start_time;
+    elapsed_time = time(NULL) - start_time;
 
     switch( log_type )
     {
@@ -3142,13 +5098,15 @@ int main( int argc, char *argv[] )
     /* Should we read just one sensor? */
     if( opts & OPT_SINGLE )
     {
-      read_device( &sensor_list, sensor );  
+      c = sensor;
+      bus = find_bus( &c );
+      read_device( bus, c );  
     }
   
     /* Should we read all connected sensors? */
     if( opts & OPT_ALL )
     {
-      read_all( &sensor_list );
+      read_buses();
     }
   
     switch( log_type )
@@ -3164,38 +5122,76 @@ int main( int argc, char *argv[] )
       default:
 		break;
     }
+    log_flush( TRUE );
 
-    /* Wait until we have passed last_time + sample_delay. We do it
-       this way because reading the sensors takes a certain amount
-       of time, and sample_delay may be less then the time needed
-       to read all the sensors. We should complain about this.
+    /* Nothing to wait for after the last sample */
+    if( (delay_msec <= 0) || ((num_samples != 0) && (x + 1 >= num_samples)) )
+      continue;
+
+    /* Wait until we have passed the next deadline. Reading the sensors
+       takes a certain amount of time, and delay_msec may be less then
+       the time needed to read all the sensors. We should complain about
+       this.
     */
-    if( (time(NULL) > last_time + sample_delay) && (sample_delay > 0) )
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    sweep_msec = diff_msec( &now, &deadline );
+    add_msec( &deadline, delay_msec );
+    if( diff_msec( &now, &deadline ) >= 0 )
     {
       fprintf(stderr, "Warning: delay (-d) is less than the time needed to ");
-      fprintf(stderr, "read all of the attached sensors. It took %ld seconds", (long int) time(NULL) - last_time );
+      fprintf(stderr, "read all of the attached sensors. It took %ld mS", sweep_msec );
       fprintf(stderr, " to read the sensors\n" );
+
+      if( opts & OPT_DAEMON )
+      {
+        /* Stay on the schedule, skip the samples that were missed */
+        while( diff_msec( &now, &deadline ) >= 0 )
+          add_msec( &deadline, delay_msec );
+      } else {
+        /* Start the next sample right away */
+        deadline = now;
+        continue;
+      }
     }
 
-    /* Should we delay before the next sample? */
-    if( sample_delay > 0 )
+    if( opts & OPT_DAEMON )
+      sigprocmask( SIG_UNBLOCK, &daemon_sigs, NULL );
+
+    /* Sleep for the remaining time, handling any signals that come in.
+       A signal that arrived while reading the sensors is handled as soon
+       as it is unblocked, before the sleep starts, so check the flags
+       before sleeping and not only when the sleep is interrupted.
+    */
+    for( ;; )
     {
-      /* Sleep for the remaining time, if there is any */
-      if( (time(NULL) - last_time) < sample_delay )
-        sleep( sample_delay - (time(NULL) - last_time) );
+      if( daemon_reload )
+      {
+        daemon_reload = 0;
+        if( reload_rcfile() < 0 )
+          fprintf( stderr, "Error reloading %s, keeping the old settings\n", conf_file );
+      }
+      if( daemon_quit || (sleep_until( &deadline ) != EINTR) )
+        break;
     }
-  }
 
-  if( sensor_list.roms != NULL )
-    free( sensor_list.roms );
+    if( opts & OPT_DAEMON )
+      sigprocmask( SIG_BLOCK, &daemon_sigs, NULL );
 
-  free_coupler(0);
+    /* A SIGHUP right as the sleep ended */
+    if( daemon_reload && !daemon_quit )
+    {
+      daemon_reload = 0;
+      if( reload_rcfile() < 0 )
+        fprintf( stderr, "Error reloading %s, keeping the old settings\n", conf_file );
+    }
+  }
 
-#ifndef OWUSB
-  owRelease(0);
-#else
-  owRelease(0, temp );
-#endif /* OWUSB */
+  if( opts & OPT_VERBOSE )
+    show_adapter_stats();
+
+  close_buses( num_open, 0 );
+  free_formats();
+  log_close();
 
   exit(EXIT_OK);
 }
@@ -3220,22 +5216,23 @@ unsigned short int Get_2800_Pio(int portnum) {
    Read the DS28ea00 temperature or PIO by Tomasz R. Surmacz
    (tsurmacz@ict.pwr.wroc.pl)
    ----------------------------------------------------------------------- */
-int read_pio_ds28ea00( int sensor_family, int sensor )
+int read_pio_ds28ea00( struct _bus *bus, int sensor_family, int sensor )
 {
   unsigned char pio;
   char		temp[1024],
   		    time_format[160];
   time_t	mytime;
+  struct tm	tm;
 
   
   if ( (sensor_family == DS28EA00_FAMILY) || (sensor_family == DS2413_FAMILY) )
   {
-    pio = Get_2800_Pio(0);
+    pio = Get_2800_Pio(bus->portnum);
 
 	if ( ((pio ^ (pio>>4)) &0xf) != 0xf) {
 	  // upper nibble should be complement of lower nibble
           // sprintf( temp, "Sensor %d Read Error (%02x)\n", sensor, pio );
-      fprintf(stderr, "Sensor %d Read Error (%02x)\n", sensor,  pio );
+      fprintf(stderr, "Sensor %d Read Error (%02x)\n", bus->first + sensor,  pio );
 	  return FALSE;
 	}
 
@@ -3252,9 +5249,9 @@ int read_pio_ds28ea00( int sensor_family, int sensor )
                     break;
 
         default:    
-                    sprintf( time_format, "%%b %%d %%H:%%M:%%S Sensor %d PIO: %02x, PIO-A: %s PIO-B: %s", sensor, pio, (pio&0x01)?"ON ":"OFF", (pio&0x04)?"ON ":"OFF" );
+                    sprintf( time_format, "%%b %%d %%H:%%M:%%S Sensor %d PIO: %02x, PIO-A: %s PIO-B: %s", bus->first + sensor, pio, (pio&0x01)?"ON ":"OFF", (pio&0x04)?"ON ":"OFF" );
                     /* Handle the time format tokens */
-                    strftime( temp, 1024, time_format, localtime( &mytime ) );
+                    strftime( temp, 1024, time_format, localtime_r( &mytime, &tm ) );
                     strcat( temp, "\n" );
                     break;
       } /* switch( log_type ) */
@@ -3263,7 +5260,7 @@ int read_pio_ds28ea00( int sensor_family, int sensor )
     }
 
     /* Log it to stdout, logfile or both */
-    log_string( temp );
+    bus_string( bus, temp );
   }
 
   return FALSE;
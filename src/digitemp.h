@@ -31,6 +31,8 @@
 #define OPT_DS2438   0x0040
 #define OPT_SORT     0x0080
 #define OPT_TEST     0x0100
+#define OPT_DAEMON   0x0200
+#define OPT_BENCH    0x0400
 
 
 /* Family codes for supported devices */
@@ -66,8 +68,31 @@
 #define EXIT_DEVERR 6    /* Error getting serial device        */
 #define EXIT_NOPORT 7    /* Port device file doesn't exists    */
 
-/* Number of tries to read a sensor before giving up */
-#define MAX_READ_TRIES	3
+/* Default number of conversions to try before giving up on a sensor,
+   and number of times to re-read its result before converting again */
+#define DEFAULT_CONVERT_TRIES	3
+#define DEFAULT_READ_TRIES	3
+
+/* Logfile output is collected in a buffer this big before writing it */
+#define LOG_BUF_SIZE	8192
+
+/* Most TTY lines in one .digitemprc, each one is a 1-Wire bus on its own
+   adapter port. No more than MAX_PORTNUM in userial/ownet.h.
+*/
+#define MAX_BUSES	16
+
+/* Highest sensor number on one bus that RESOLUTION and INTERVAL lines in
+   .digitemprc can use
+*/
+#define MAX_RC_SENSOR	1023
+
+/* Sensor power supply, from Read Power Supply (0xB4) */
+#define POWER_UNKNOWN   0
+#define POWER_PARASITE  1
+#define POWER_EXTERNAL  2
+
+/* DS1923 forced conversion time in mS */
+#define DS1923_CONV_TIME  666
 
 struct _roms {
         unsigned char   *roms;                  /* Array of 8 bytes     */
@@ -81,13 +106,95 @@ struct _coupler {
   
   unsigned char *main;			/* Array of 8 byte serial nums */
   unsigned char *aux;			/* Array of 8 byte serial nums */
+
+  int power[2];				/* Power supply of main and aux */
+  long convert_tick[2];			/* When a Skip ROM convert was sent */
+  int convert_time[2];			/* How long it takes in mS */
   
   struct _coupler *next;
 };
 
+/* Cached state for each sensor, indexed by sensor number */
+struct _sensor_info {
+  unsigned char SN[8];			/* Serial # when renumbering */
+  int power;				/* POWER_UNKNOWN, _PARASITE, _EXTERNAL */
+  int resolution;			/* 9-12 bits, 0 leaves it alone */
+  int resolution_set;			/* Config register has been written */
+  int interval;				/* mS between reads, 0 is every sample */
+  int due;				/* Read it in the current sweep */
+  struct timespec next_read;		/* When it is due again */
+};
+
+/* One 1-Wire bus, from a TTY line in .digitemprc. Sensor numbers in the
+   output start at first, the sensors on the bus are numbered from 0.
+ */
+struct _bus {
+  int portnum;				/* Adapter port number */
+  char serial_port[1024];		/* Path to the serial port */
+  struct _roms sensor_list;		/* Sensors on the main segment */
+  struct _coupler *coupler_top;		/* Linked list of couplers */
+  int num_cs;				/* Number of sensors on cplr */
+  int first;				/* Output number of sensor 0 */
+
+  unsigned char Last2409[9];		/* Last selected coupler */
+  int converted;			/* Skip ROM convert was sent */
+  int power;				/* Main segment power supply */
+  struct _sensor_info *sensor_info;	/* Per-sensor cached state */
+  int sensor_info_max;
+  struct timespec sweep_time;		/* When the current sweep started */
+
+  int threaded;				/* Output goes to out, not the log */
+  char *out;				/* Output of the current sweep */
+  int out_len;
+  int out_size;
+  pthread_t thread;
+};
+
+/* The settings read_rcfile changes, kept so a failed reload can be undone */
+struct _rc_state {
+  struct _bus buses[MAX_BUSES];		/* Buses and their sensor lists */
+  int num_buses;
+  char log_file[1024];
+  char temp_format[80];
+  char counter_format[80];
+  char humidity_format[80];
+  char adc_format[80];
+  int read_time;
+  int read_tries;
+  int convert_tries;
+  int log_type;
+  int log_flush_records;
+  int log_fsync;
+};
+
+/* Counters kept by the adapter, for --bench */
+struct _adapter_stats {
+  double bus_us;			/* Time spent on the 1-Wire bus */
+  double delay_us;			/* Time spent in msDelay() */
+  long transactions;			/* Round trips to the adapter */
+  long syscalls;			/* System calls made by the adapter */
+  long crc_errors;			/* CRC errors injected */
+  double response_us;			/* Average adapter response time */
+  long timeout_ms;			/* Current read timeout, 0 if fixed */
+};
+
+/* Where a --bench test started */
+struct _bench {
+  struct timespec start;
+  struct _adapter_stats stats;
+  int have_stats;			/* The adapter keeps counters */
+  long log_bytes;
+  long log_syscalls;
+};
+
 /* Prototypes */
 void usage();
-void free_coupler();
+void free_coupler( struct _bus *bus, int free_only );
+void init_bus( struct _bus *bus, int portnum );
+void free_bus( struct _bus *bus, int free_only );
+int number_buses();
+struct _bus *find_bus( int *sensor );
+void close_buses( int num_open, int free_only );
 float c2f( float temp );
 int build_tf( char *time_format, char *format, int sensor, 
               float temp_c, int humidity, unsigned char *sn );
@@ -97,31 +204,83 @@ int build_af(char *time_format, size_t tf_size, char *format,
              int sensor, float temp_c, float vdd, float ad, float vsens,
              unsigned char *sn);
 int log_string( char *line );
-int log_temp( int sensor, float temp_c, unsigned char *sn );
-int log_counter( int sensor, int page, unsigned long counter, unsigned char *sn );
-int log_humidity( int sensor, double temp_c, int humidity, unsigned char *sn );
-int log_temperature_voltage(int sensor, double temp_c,
-                            float vdd, float ad, float vsens,
-                            unsigned char *sn);
+int bus_string( struct _bus *bus, char *line );
+int log_bucket_secs( char *fmt );
+int log_open( time_t now );
+int log_flush( int sweep );
+void log_close();
+int log_temp( struct _bus *bus, int sensor, float temp_c, unsigned char *sn );
+int log_counter( struct _bus *bus, int sensor, int page, unsigned long counter, unsigned char *sn );
+int log_humidity( struct _bus *bus, int sensor, double temp_c, int humidity, unsigned char *sn );
+int log_temperature_voltage( struct _bus *bus, int sensor, double temp_c,
+                             float vdd, float ad, float vsens,
+                             unsigned char *sn );
 int cmpSN( unsigned char *sn1, unsigned char *sn2, int branch );
-void show_scratchpad( unsigned char *scratchpad, int sensor_family );
-int read_temperature( int sensor_family, int sensor );
-int read_counter( int sensor_family, int sensor );
-int read_ds2438( int sensor_family, int sensor );
-int read_humidity( int sensor_family, int sensor );
-int read_device( struct _roms *sensor_list, int sensor );
-int read_all( struct _roms *sensor_list );
-int read_rcfile( char *fname, struct _roms *sensor_list );
-int write_rcfile( char *fname, struct _roms *sensor_list );
+void show_scratchpad( struct _bus *bus, unsigned char *scratchpad, int sensor_family );
+int read_scratchpad( struct _bus *bus, unsigned char *scratchpad, int sensor_family );
+struct _sensor_info *get_sensor_info( struct _bus *bus, int sensor );
+struct _sensor_info *rc_sensor_info( struct _bus *bus, char *ptr, char *keyword, int line );
+void free_sensor_info( struct _bus *bus );
+void renumber_sensor_info( struct _bus *bus );
+unsigned char *get_sensor_sn( struct _bus *bus, int sensor );
+int read_power_supply( struct _bus *bus, int skip_rom );
+int set_resolution( struct _bus *bus, int sensor_family, int power, int resolution );
+int setup_sensor( struct _bus *bus, int sensor_family, int sensor, int power );
+int conversion_time( struct _bus *bus, int sensor_family, int sensor );
+int plan_sweep( struct _bus *bus );
+int sensor_due( struct _bus *bus, int sensor );
+int segment_due( struct _bus *bus, int first, int num );
+void sensor_done( struct _bus *bus, int sensor );
+void read_skipped( struct _bus *bus, int sensor );
+int read_scheduled( struct _bus *bus, int sensor );
+int wait_conversion( struct _bus *bus, int power, int msec );
+int read_temperature( struct _bus *bus, int sensor_family, int sensor );
+int read_counter( struct _bus *bus, int sensor_family, int sensor );
+int read_ds2438( struct _bus *bus, int sensor_family, int sensor );
+int read_humidity( struct _bus *bus, int sensor_family, int sensor );
+int read_DS1923_result( struct _bus *bus, float *temp_c, float *humidity );
+int read_temperature_DS1923( struct _bus *bus, int sensor_family, int sensor );
+int read_device( struct _bus *bus, int sensor );
+int setup_convert( struct _bus *bus, unsigned char *roms, int num, int first, int power );
+int send_convert( struct _bus *bus, int power );
+int start_convert( struct _bus *bus, unsigned char *roms, int num, int first, int power );
+int convert_segment( struct _bus *bus, unsigned char *roms, int num, int first, int *power );
+int convert_all( struct _bus *bus );
+int select_branch( struct _bus *bus, struct _coupler *c_ptr, int branch );
+int read_all( struct _bus *bus );
+void *sweep_thread( void *arg );
+int read_buses();
+int read_rcfile( char *fname );
+int write_rcfile( char *fname );
 void printSN( unsigned char *TempSN, int crlf );
-int Walk1Wire();
+int Walk1Wire( struct _bus *bus );
 int sercmp( unsigned char *sn1, unsigned char *sn2 );
-int Init1WireLan( struct _roms *sensor_list );
-int read_pio_ds28ea00( int sensor_family, int sensor );
+int Init1WireLan( struct _bus *bus );
+int init_buses();
+char *port_file( char *port );
+int read_pio_ds28ea00( struct _bus *bus, int sensor_family, int sensor );
+void apply_options();
+void compile_formats();
+void free_formats();
+void save_rc_state( struct _rc_state *rc );
+void restore_rc_state( struct _rc_state *rc );
+int reload_rcfile();
+void daemon_signal( int sig );
+int sleep_until( struct timespec *deadline );
+void add_msec( struct timespec *ts, long msec );
+long diff_msec( struct timespec *a, struct timespec *b );
+void bench_start( struct _bench *bench );
+void bench_report( char *name, struct _bench *bench, int loops, int sensors );
+int run_bench( int sweeps );
+void show_adapter_stats();
 
 /* From ds2438.c */
 int get_ibl_type(int portnum, unsigned char page, int offset);
 
+/* From ds9097.c, ds9097u.c, ds2490.c, sim.c or w1.c */
+int adapter_stats( struct _adapter_stats *stats );
+int adapter_convert( int portnum, int msec );
+
 /* Local Variables: */
 /* mode: C */
 /* compile-command: "cd ..; make -k" */
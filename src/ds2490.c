@@ -1 +1,17 @@
+#include <time.h>
+#include <pthread.h>
+#include "digitemp.h"
+
 const char dtlib[] = "DS2490";
+
+/* The DS2490 adapter doesn't keep any counters */
+int adapter_stats( struct _adapter_stats *stats )
+{
+  return 0;
+}
+
+/* Conversions are started with Skip ROM and Convert T */
+int adapter_convert( int portnum, int msec )
+{
+  return 0;
+}
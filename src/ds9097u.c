@@ -1 +1,33 @@
+#include <time.h>
+#include <pthread.h>
+#include "digitemp.h"
+
 const char dtlib[] = "DS9097U";
+
+/* From userial/ds9097u/linuxlnk.c */
+long   ReadCOMTimeout( int portnum );
+double ReadCOMResponse( int portnum );
+void   ReadCOMStats( long *syscalls, long *writes, double *wait_us,
+                     double *delay_us );
+
+/* Counters from the serial port code, added up over all the ports. The
+   bus time is the time spent waiting for the DS2480 to answer, and the
+   response time is its smoothed time to the first byte of an answer on
+   the first port.
+*/
+int adapter_stats( struct _adapter_stats *stats )
+{
+  ReadCOMStats( &stats->syscalls, &stats->transactions,
+                &stats->bus_us, &stats->delay_us );
+  stats->crc_errors = 0;
+  stats->response_us = ReadCOMResponse( 0 );
+  stats->timeout_ms = ReadCOMTimeout( 0 );
+
+  return 1;
+}
+
+/* Conversions are started with Skip ROM and Convert T */
+int adapter_convert( int portnum, int msec )
+{
+  return 0;
+}
@@ -0,0 +1,413 @@
+/* -----------------------------------------------------------------------
+   DigiTemp output formats
+
+   Copyright 1996-2005 by Brian C. Lane <bcl@brianlane.com>
+   All Rights Reserved
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the Free
+   Software Foundation; either version 2 of the License, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+   more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA
+
+   The LOG_FORMAT, CNT_FORMAT, HUM_FORMAT and ADC_FORMAT strings are
+   compiled once into a list of tokens. Literal text, digitemp fields and
+   runs of strftime fields are split apart, so printing a reading doesn't
+   parse the format again. The strftime runs are only rendered when the
+   second changes, which is once per sweep for most setups.
+
+   The tokens are split up the same way build_tf(), build_cf() and
+   build_af() do it, so the output is the same.
+   ----------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include "format.h"
+
+
+/* -----------------------------------------------------------------------
+   Add a token to the end of a program
+
+   text is copied, len is its length.
+   ----------------------------------------------------------------------- */
+static int fmt_add( struct _fmt_prog *prog, int type, char *text, int len )
+{
+  struct _fmt_token *tokens, *tk;
+
+  if( (tokens = realloc( prog->tokens,
+                         (prog->num+1) * sizeof( struct _fmt_token ) )) == NULL )
+    return 0;
+  prog->tokens = tokens;
+
+  tk = &prog->tokens[prog->num];
+  tk->type = type;
+  tk->len = len;
+  tk->cache = NULL;
+  tk->text = NULL;
+
+  if( text != NULL )
+  {
+    if( (tk->text = malloc( len+1 )) == NULL )
+      return 0;
+    memcpy( tk->text, text, len );
+    tk->text[len] = 0;
+  }
+
+  if( type == FMT_TIME )
+  {
+    if( (tk->cache = malloc( FMT_TIME_SIZE )) == NULL )
+    {
+      free( tk->text );
+      return 0;
+    }
+    tk->cache[0] = 0;
+    tk->len = 0;
+  }
+
+  prog->num++;
+  return 1;
+}
+
+
+/* -----------------------------------------------------------------------
+   Add the text collected so far as a literal or a strftime run
+   ----------------------------------------------------------------------- */
+static int fmt_add_run( struct _fmt_prog *prog, char *run, int *run_len )
+{
+  int ret;
+
+  if( *run_len == 0 )
+    return 1;
+
+  ret = fmt_add( prog, memchr( run, '%', *run_len ) ? FMT_TIME : FMT_TEXT,
+                 run, *run_len );
+  *run_len = 0;
+
+  return ret;
+}
+
+
+/* -----------------------------------------------------------------------
+   Compile a format string into a token program
+
+   flavour is FMT_TEMPERATURE, FMT_COUNTER or FMT_ADC and selects which
+   digitemp tokens are recognized.
+
+   Returns the new program or NULL if it ran out of memory
+   ----------------------------------------------------------------------- */
+struct _fmt_prog *fmt_compile( char *format, int flavour )
+{
+  struct _fmt_prog *prog;
+  char             *run,
+                   token[80],
+                   *spec;
+  int              run_len = 0,
+                   tk_len,
+                   type;
+
+  if( format == NULL )
+    return NULL;
+
+  if( (prog = calloc( 1, sizeof( struct _fmt_prog ) )) == NULL )
+    return NULL;
+
+  /* Nothing in the format can grow when it is split up */
+  if( (run = malloc( strlen( format )+1 )) == NULL )
+  {
+    free( prog );
+    return NULL;
+  }
+
+  while( *format )
+  {
+    if( *format != '%' )
+    {
+      run[run_len++] = *format++;
+      continue;
+    }
+
+    /* Take numbers, astrix, period and letters. Counter formats take
+       everything up to the next space, the others stop after the first
+       letter.
+    */
+    tk_len = 0;
+    while( (isalnum( *format ) || (*format == '.') ||
+            (*format == '*') || (*format == '%')) &&
+           (tk_len < sizeof(token)-2) )
+    {
+      token[tk_len++] = *format++;
+      if( (flavour != FMT_COUNTER) && isalpha( token[tk_len-1] ) )
+        break;
+    }
+    token[tk_len] = 0;
+
+    type = -1;
+    switch( token[tk_len-1] )
+    {
+      case 's':
+        type = FMT_SENSOR;
+        token[tk_len-1] = 'd';
+        break;
+
+      case 'h':
+        if( flavour == FMT_TEMPERATURE )
+        {
+          type = FMT_HUMIDITY;
+          token[tk_len-1] = 'd';
+        }
+        break;
+
+      case 'n':
+        if( flavour == FMT_COUNTER )
+        {
+          type = FMT_PAGE;
+          token[tk_len-1] = 'd';
+        }
+        break;
+
+      case 'C':
+        if( flavour == FMT_COUNTER )
+        {
+          type = FMT_COUNT;
+          token[tk_len-1] = 'l';
+          token[tk_len++] = 'd';
+          token[tk_len] = 0;
+        } else {
+          type = FMT_TEMP_C;
+          token[tk_len-1] = 'f';
+        }
+        break;
+
+      case 'F':
+        /* Counters have no temperature, it prints nothing */
+        if( flavour == FMT_COUNTER )
+        {
+          tk_len = 0;
+          continue;
+        }
+        type = FMT_TEMP_F;
+        token[tk_len-1] = 'f';
+        break;
+
+      case 'Q':
+      case 'q':
+      case 'J':
+        if( flavour == FMT_ADC )
+        {
+          type = (token[tk_len-1] == 'Q') ? FMT_VDD :
+                 (token[tk_len-1] == 'q') ? FMT_AD : FMT_VSENS;
+          token[tk_len-1] = 'f';
+        }
+        break;
+
+      case 'R':
+        type = FMT_SN;
+        break;
+
+      case 'N':
+        /* Seconds since Epoch, strftime does this one */
+        token[tk_len-1] = 's';
+        break;
+    }
+
+    if( type == -1 )
+    {
+      /* Not something for us, it goes into the strftime run */
+      memcpy( &run[run_len], token, tk_len );
+      run_len += tk_len;
+      continue;
+    }
+
+    spec = (type == FMT_SN) ? NULL : token;
+    if( !fmt_add_run( prog, run, &run_len ) ||
+        !fmt_add( prog, type, spec, spec ? tk_len : 0 ) )
+    {
+      free( run );
+      fmt_free( prog );
+      return NULL;
+    }
+  }
+
+  if( !fmt_add_run( prog, run, &run_len ) )
+  {
+    free( run );
+    fmt_free( prog );
+    return NULL;
+  }
+  free( run );
+
+  return prog;
+}
+
+
+/* -----------------------------------------------------------------------
+   Free a compiled format
+   ----------------------------------------------------------------------- */
+void fmt_free( struct _fmt_prog *prog )
+{
+  int x;
+
+  if( prog == NULL )
+    return;
+
+  for( x = 0; x < prog->num; x++ )
+  {
+    if( prog->tokens[x].text != NULL )
+      free( prog->tokens[x].text );
+    if( prog->tokens[x].cache != NULL )
+      free( prog->tokens[x].cache );
+  }
+  if( prog->tokens != NULL )
+    free( prog->tokens );
+  free( prog );
+}
+
+
+/* -----------------------------------------------------------------------
+   localtime() that is only called once for each second
+   ----------------------------------------------------------------------- */
+struct tm *fmt_localtime( time_t now )
+{
+  static time_t    last = 0;
+  static struct tm tm;
+
+  if( (now != last) || (last == 0) )
+  {
+    tm = *localtime( &now );
+    last = now;
+  }
+
+  return &tm;
+}
+
+
+/* -----------------------------------------------------------------------
+   Print one reading with a compiled format
+
+   out is size bytes long and is always terminated. A field that doesn't
+   fit is left out, like build_af() does.
+
+   Returns the length of the output
+   ----------------------------------------------------------------------- */
+int fmt_render( struct _fmt_prog *prog, char *out, int size,
+                struct _fmt_values *values, time_t now )
+{
+  static const char hex[] = "0123456789ABCDEF";
+  struct _fmt_token *tk;
+  struct tm         *tm;
+  int               x,
+                    i,
+                    len = 0,
+                    needed;
+  char              *src;
+
+  if( (out == NULL) || (size <= 0) )
+    return 0;
+  out[0] = 0;
+  if( prog == NULL )
+    return 0;
+
+  /* Render the time fields once a second */
+  if( prog->cached != now )
+  {
+    tm = fmt_localtime( now );
+    for( x = 0; x < prog->num; x++ )
+    {
+      tk = &prog->tokens[x];
+      if( tk->type == FMT_TIME )
+        tk->len = strftime( tk->cache, FMT_TIME_SIZE, tk->text, tm );
+    }
+    prog->cached = now;
+  }
+
+  for( x = 0; x < prog->num; x++ )
+  {
+    tk = &prog->tokens[x];
+    needed = -1;
+    switch( tk->type )
+    {
+      case FMT_TEXT:
+      case FMT_TIME:
+        src = (tk->type == FMT_TEXT) ? tk->text : tk->cache;
+        i = tk->len;
+        if( i > size-1-len )
+          i = size-1-len;
+        memcpy( &out[len], src, i );
+        len += i;
+        break;
+
+      case FMT_SENSOR:
+        needed = snprintf( &out[len], size-len, tk->text, values->sensor );
+        break;
+
+      case FMT_HUMIDITY:
+        needed = snprintf( &out[len], size-len, tk->text, values->humidity );
+        break;
+
+      case FMT_TEMP_C:
+        needed = snprintf( &out[len], size-len, tk->text, values->temp_c );
+        break;
+
+      case FMT_TEMP_F:
+        needed = snprintf( &out[len], size-len, tk->text,
+                           32 + ((values->temp_c*9)/5) );
+        break;
+
+      case FMT_PAGE:
+        needed = snprintf( &out[len], size-len, tk->text, values->page );
+        break;
+
+      case FMT_COUNT:
+        needed = snprintf( &out[len], size-len, tk->text, values->count );
+        break;
+
+      case FMT_VDD:
+        needed = snprintf( &out[len], size-len, tk->text, values->vdd );
+        break;
+
+      case FMT_AD:
+        needed = snprintf( &out[len], size-len, tk->text, values->ad );
+        break;
+
+      case FMT_VSENS:
+        needed = snprintf( &out[len], size-len, tk->text, values->vsens );
+        break;
+
+      case FMT_SN:
+        if( values->sn == NULL )
+        {
+          needed = snprintf( &out[len], size-len, "null" );
+          break;
+        }
+        if( len + 16 < size )
+        {
+          for( i = 0; i < 8; i++ )
+          {
+            out[len++] = hex[values->sn[i] >> 4];
+            out[len++] = hex[values->sn[i] & 0x0F];
+          }
+        }
+        break;
+    }
+
+    /* Leave out a field that didn't fit */
+    if( needed >= 0 )
+    {
+      if( needed < size-len )
+        len += needed;
+    }
+    out[len] = 0;
+  }
+
+  return len;
+}
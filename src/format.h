@@ -0,0 +1,74 @@
+/* ------------------------------------------------------------------------
+   DigiTemp
+
+   Copyright 1996-2005 by Brian C. Lane <bcl@brianlane.com>
+   All Rights Reserved
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the Free
+   Software Foundation; either version 2 of the License, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+   FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+   more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA
+   ------------------------------------------------------------------------ */
+
+/* Which set of digitemp tokens the format string uses */
+#define FMT_TEMPERATURE	0	/* LOG_FORMAT and HUM_FORMAT, like build_tf */
+#define FMT_COUNTER	1	/* CNT_FORMAT, like build_cf		    */
+#define FMT_ADC		2	/* ADC_FORMAT, like build_af		    */
+
+/* Token types in a compiled format */
+#define FMT_TEXT	0	/* Literal text				*/
+#define FMT_TIME	1	/* strftime run, rendered once a second	*/
+#define FMT_SENSOR	2	/* %s sensor number			*/
+#define FMT_HUMIDITY	3	/* %h relative humidity			*/
+#define FMT_TEMP_C	4	/* %C degrees Centigrade		*/
+#define FMT_TEMP_F	5	/* %F degrees Fahrenheit		*/
+#define FMT_PAGE	6	/* %n counter number			*/
+#define FMT_COUNT	7	/* %C counter value			*/
+#define FMT_SN		8	/* %R ROM serial number			*/
+#define FMT_VDD		9	/* %Q supply voltage			*/
+#define FMT_AD		10	/* %q A/D input voltage			*/
+#define FMT_VSENS	11	/* %J current sense voltage		*/
+
+/* Largest strftime run output */
+#define FMT_TIME_SIZE	1024
+
+struct _fmt_token {
+  int  type;
+  char *text;				/* Literal, strftime or printf format */
+  int  len;				/* Length of the literal or cached run */
+  char *cache;				/* Rendered strftime run */
+};
+
+struct _fmt_prog {
+  int               num;
+  struct _fmt_token *tokens;
+  time_t            cached;		/* When the strftime runs were rendered */
+};
+
+/* Everything a format can print */
+struct _fmt_values {
+  int           sensor;
+  float         temp_c;
+  int           humidity;
+  int           page;
+  unsigned long count;
+  float         vdd;
+  float         ad;
+  float         vsens;
+  unsigned char *sn;
+};
+
+struct _fmt_prog *fmt_compile( char *format, int flavour );
+void fmt_free( struct _fmt_prog *prog );
+struct tm *fmt_localtime( time_t now );
+int fmt_render( struct _fmt_prog *prog, char *out, int size,
+                struct _fmt_values *values, time_t now );
@@ -0,0 +1,27 @@
+#include <time.h>
+#include <pthread.h>
+#include "digitemp.h"
+#include "sim/simbus.h"
+
+const char dtlib[] = "SIM";
+
+/* Counters from the simulated bus */
+int adapter_stats( struct _adapter_stats *stats )
+{
+  struct sim_stats s;
+
+  sim_get_stats( &s );
+  stats->bus_us = s.bus_us;
+  stats->delay_us = s.delay_us;
+  stats->transactions = s.transactions;
+  stats->syscalls = s.syscalls;
+  stats->crc_errors = s.crc_errors;
+
+  return 1;
+}
+
+/* The simulated bus converts them with Skip ROM like any other */
+int adapter_convert( int portnum, int msec )
+{
+  return 0;
+}
@@ -0,0 +1,27 @@
+#include <time.h>
+#include <pthread.h>
+#include "digitemp.h"
+
+const char dtlib[] = "W1";
+
+/* From userial/w1/w1lnk.c and w1sysfs.c */
+void w1_stats( long *transactions, long *syscalls );
+int  w1_convert_all( int portnum, int msec );
+
+/* Transactions and system calls of the kernel's w1 masters, added up over
+   all the ports. The kernel doesn't say how long the bus took.
+*/
+int adapter_stats( struct _adapter_stats *stats )
+{
+  w1_stats( &stats->transactions, &stats->syscalls );
+
+  return 1;
+}
+
+/* The kernel converts all of a master's thermometers with therm_bulk_read,
+   and powers the parasite ones itself
+*/
+int adapter_convert( int portnum, int msec )
+{
+  return w1_convert_all( portnum, msec );
+}
@@ -36,6 +36,7 @@
 
 
 extern int   owBlock(int,int,uchar *,int);
+extern int   owAccessBlock(int,int,uchar *,int);
 extern void  setcrc8(int,uchar);
 extern uchar docrc8(int,uchar);
 extern int   owReadByte(int);
@@ -47,8 +48,9 @@ extern int   owAccess(int);
 
 
 int Volt_AD(int portnum, int vdd);
-float Volt_Reading(int portnum, int vdd, int *cad);
-double Get_Temperature(int portnum);
+float Volt_Reading(int portnum, int vdd, int *cad, int reads);
+double Get_Temperature(int portnum, int reads);
+static int Read_Page0(int portnum, uchar *send_block);
 
 int Volt_AD(int portnum, int vdd)
 {
@@ -70,110 +72,151 @@ int Volt_AD(int portnum, int vdd)
    // Page to Recall
    send_block[send_cnt++] = 0x00;
 
-   if(!owBlock(portnum,FALSE,send_block,send_cnt))
+   if(!owAccessBlock(portnum,FALSE,send_block,send_cnt))
       return FALSE;
 
    send_cnt = 0;
 
-   if(owAccess(portnum))
-   {
-      // Read the Status/Configuration byte
-      // Read scratchpad command
-      send_block[send_cnt++] = 0xBE;
+   // Read the Status/Configuration byte
+   // Read scratchpad command
+   send_block[send_cnt++] = 0xBE;
 
-      // Page for the Status/Configuration byte
-      send_block[send_cnt++] = 0x00;
+   // Page for the Status/Configuration byte
+   send_block[send_cnt++] = 0x00;
 
-      for(i=0;i<9;i++)
-         send_block[send_cnt++] = 0xFF;
+   for(i=0;i<9;i++)
+      send_block[send_cnt++] = 0xFF;
 
-      if(owBlock(portnum,FALSE,send_block,send_cnt))
-      {
-         setcrc8(portnum,0);
+   if(owAccessBlock(portnum,FALSE,send_block,send_cnt))
+   {
+      setcrc8(portnum,0);
 
-         for(i=2;i<send_cnt;i++)
-            lastcrc8 = docrc8(portnum,send_block[i]);
+      for(i=2;i<send_cnt;i++)
+         lastcrc8 = docrc8(portnum,send_block[i]);
 
-         if(lastcrc8 != 0x00)
-            return FALSE;
-      }//Block
-      else
+      if(lastcrc8 != 0x00)
          return FALSE;
+   }//Block
+   else
+      return FALSE;
 
-      /*
-       * Avoid writing to status if needed --ro
-       */
+   /*
+    * Avoid writing to status if needed --ro
+    */
 
-      test = send_block[2] & 0x08;
-      if(((test == 0x08) && vdd) || ((test == 0x00) && !(vdd)))
-         return TRUE;
-   }//Access
+   test = send_block[2] & 0x08;
+   if(((test == 0x08) && vdd) || ((test == 0x00) && !(vdd)))
+      return TRUE;
+
+   send_cnt = 0;
+   // Write the Status/Configuration byte
+   // Write scratchpad command
+   send_block[send_cnt++] = 0x4E;
+
+   // Write page
+   send_block[send_cnt++] = 0x00;
 
-   if(owAccess(portnum))
+   if(vdd)
+      send_block[send_cnt++] = send_block[2] | 0x08;
+   else
+      send_block[send_cnt++] = send_block[2] & 0xF7;
+
+   for(i=0;i<7;i++)
+      send_block[send_cnt++] = send_block[i+4];
+
+   /*
+    * Turn on CAD sampling and turn off CA and EE functions 
+    * for our use for less glitches
+    */
+
+   send_block[2] |= 0x1;
+   send_block[2] &= ~0x4;
+   send_block[2] &= ~0x2;
+
+   if(owAccessBlock(portnum,FALSE,send_block,send_cnt))
    {
       send_cnt = 0;
-      // Write the Status/Configuration byte
-      // Write scratchpad command
-      send_block[send_cnt++] = 0x4E;
 
-      // Write page
+      // Copy the Status/Configuration byte
+      // Copy scratchpad command
+      send_block[send_cnt++] = 0x48;
+
+      // Copy page
       send_block[send_cnt++] = 0x00;
 
-      if(vdd)
-         send_block[send_cnt++] = send_block[2] | 0x08;
-      else
-         send_block[send_cnt++] = send_block[2] & 0xF7;
+      if(owAccessBlock(portnum,FALSE,send_block,send_cnt))
+      {
+         busybyte = owReadByte(portnum);
+   
+         while(busybyte == 0)
+            busybyte = owReadByte(portnum);
+
+         return TRUE;
+      }//Block
+   }//Block
+
+   return FALSE;
+}
+      
 
-      for(i=0;i<7;i++)
-         send_block[send_cnt++] = send_block[i+4];
+//--------------------------------------------------------------------------
+// Recall page 0 into the scratchpad and read it back with its CRC.
+// The page data is returned in send_block[2] to send_block[9].
+//
+// Returns: TRUE if the page was read and the CRC8 is correct
+//
+static int Read_Page0(int portnum, uchar *send_block)
+{
+   int send_cnt=0;
+   int i;
+   ushort lastcrc8=255;
 
-      /*
-       * Turn on CAD sampling and turn off CA and EE functions 
-       * for our use for less glitches
-       */
+   // Recall the Status/Configuration page
+   // Recall command
+   send_block[send_cnt++] = 0xB8;
 
-      send_block[2] |= 0x1;
-      send_block[2] &= ~0x4;
-      send_block[2] &= ~0x2;
+   // Page to Recall
+   send_block[send_cnt++] = 0x00;
 
-      if(owBlock(portnum,FALSE,send_block,send_cnt))
-      {
-         send_cnt = 0;
+   if(!owAccessBlock(portnum,FALSE,send_block,send_cnt))
+      return FALSE;
 
-         if(owAccess(portnum))
-         {
-            // Copy the Status/Configuration byte
-            // Copy scratchpad command
-            send_block[send_cnt++] = 0x48;
+   send_cnt = 0;
 
-            // Copy page
-            send_block[send_cnt++] = 0x00;
+   // Read the Status/Configuration byte
+   // Read scratchpad command
+   send_block[send_cnt++] = 0xBE;
 
-            if(owBlock(portnum,FALSE,send_block,send_cnt))
-            {
-               busybyte = owReadByte(portnum);
-         
-               while(busybyte == 0)
-                  busybyte = owReadByte(portnum);
+   // Page for the Status/Configuration byte
+   send_block[send_cnt++] = 0x00;
 
-               return TRUE;
-            }//Block
-         }//Access
-      }//Block
+   for(i=0;i<9;i++)
+      send_block[send_cnt++] = 0xFF;
 
-   }//Access
+   if(!owAccessBlock(portnum,FALSE,send_block,send_cnt))
+      return FALSE;
 
-   return FALSE;
+   setcrc8(portnum,0);
+
+   for(i=2;i<send_cnt;i++)
+      lastcrc8 = docrc8(portnum,send_block[i]);
+
+   return (lastcrc8 == 0x00);
 }
-      
 
-float Volt_Reading(int portnum, int vdd, int *cad)
+
+//--------------------------------------------------------------------------
+// Convert and read Vdd (vdd = 1) or Vad (vdd = 0). A CRC error on the
+// read doesn't spoil the conversion, so the page is re-read up to 'reads'
+// times before giving up.
+//
+// Returns: the voltage, or -1.0 if it couldn't be read
+//
+float Volt_Reading(int portnum, int vdd, int *cad, int reads)
 {
    uchar send_block[50];
-   int send_cnt=0;
    int i;
    int busybyte; 
-   ushort lastcrc8=255;
    ushort volts;
    float ret=-1.0;
    int done = TRUE;
@@ -184,10 +227,11 @@ float Volt_Reading(int portnum, int vdd, int *cad)
       if(Volt_AD(portnum,vdd))
       {
 
-         if(owAccess(portnum))
+	 /*  Convert V */
+         send_block[0] = 0xB4;
+         if(owAccessBlock(portnum,FALSE,send_block,1))
          {
-	   /*  Convert V */
-            if(!owWriteByte(portnum,0xB4))
+            if(send_block[0] != 0xB4)
             {
 /*               output_status(LV_ALWAYS,(char *)"DIDN'T WRITE CORRECTLY\n"); */
                return ret;
@@ -199,66 +243,32 @@ float Volt_Reading(int portnum, int vdd, int *cad)
                busybyte = owReadByte(portnum);
          }
 
-         if(owAccess(portnum))
+         for(i=0;i<reads;i++)
          {
-            // Recall the Status/Configuration page
-            // Recall command
-            send_block[send_cnt++] = 0xB8;
-
-            // Page to Recall
-            send_block[send_cnt++] = 0x00;
-
-            if(!owBlock(portnum,FALSE,send_block,send_cnt))
-               return ret;
+            if(Read_Page0(portnum,send_block))
+               break;
          }
+         if(i == reads)
+            return ret;
 
-         send_cnt = 0;
-
-         if(owAccess(portnum))
-         {
-            // Read the Status/Configuration byte
-            // Read scratchpad command
-            send_block[send_cnt++] = 0xBE;
-
-            // Page for the Status/Configuration byte
-            send_block[send_cnt++] = 0x00;
-
-            for(i=0;i<9;i++)
-               send_block[send_cnt++] = 0xFF;
-
-            if(owBlock(portnum,FALSE,send_block,send_cnt))
-            {
-               setcrc8(portnum,0);
-
-               for(i=2;i<send_cnt;i++)
-                  lastcrc8 = docrc8(portnum,send_block[i]);
-
-               if(lastcrc8 != 0x00)
-                  return ret;
-
-            }
-            else
-               return ret;    
-      
-            if((!vdd) && ((send_block[2] & 0x08) == 0x08))
-	      continue;
-            else
-               done = TRUE;
+         if((!vdd) && ((send_block[2] & 0x08) == 0x08))
+	   continue;
+         else
+            done = TRUE;
 
-            volts = (send_block[6] << 8) | send_block[5];
-            ret = (float) volts/100;
+         volts = (send_block[6] << 8) | send_block[5];
+         ret = (float) volts/100;
 
-	    if(cad) {
+	 if(cad) {
 
-	      /* Get Current reading as well */
-	      c = send_block[8] & 0x3;
+	   /* Get Current reading as well */
+	   c = send_block[8] & 0x3;
 
-	      *cad =  (c << 8) | send_block[7];
-	      if(send_block[8] & 0x4) *cad =  - *cad;
+	   *cad =  (c << 8) | send_block[7];
+	   if(send_block[8] & 0x4) *cad =  - *cad;
 
-	      //	      printf("CAD=%d\n", *cad);
-	    }
-         }//Access
+	   //	      printf("CAD=%d\n", *cad);
+	 }
       }
    } while(!done);
 
@@ -266,78 +276,44 @@ float Volt_Reading(int portnum, int vdd, int *cad)
 
 }
 
-/* Return the temperature (in C) or -999.0 if there was a problem */
-double Get_Temperature(int portnum)
+/* Return the temperature (in C) or -999.0 if there was a problem.
+ * The result is re-read up to 'reads' times on CRC errors.
+ */
+double Get_Temperature(int portnum, int reads)
 {
    double ret=-999.0;
    uchar send_block[50];
-   int send_cnt=0;
    int i;
-   ushort lastcrc8=255;
 
    /* 01/08/2004 [bcl] DigiTemp does this before calling the function
     * owSerialNum(portnum,SNum,FALSE);
     */
 
-   if(owAccess(portnum))
-      // Convert Temperature command
-      owWriteByte(portnum,0x44);
+   // Convert Temperature command
+   send_block[0] = 0x44;
+   owAccessBlock(portnum,FALSE,send_block,1);
 
    msDelay(10);
 
-   if(owAccess(portnum))
+   for(i=0;i<reads;i++)
    {
-      // Recall the Status/Configuration page
-      // Recall command
-      send_block[send_cnt++] = 0xB8;
-
-      // Page to Recall
-      send_block[send_cnt++] = 0x00;
-
-      if(!owBlock(portnum,FALSE,send_block,send_cnt))
-         return ret;
-
-      send_cnt = 0;
+      if(Read_Page0(portnum,send_block))
+         break;
    }
+   if(i == reads)
+      return ret;
 
-   if(owAccess(portnum))
-   {
-      // Read the Status/Configuration byte
-      // Read scratchpad command
-      send_block[send_cnt++] = 0xBE;
-
-      // Page for the Status/Configuration byte
-      send_block[send_cnt++] = 0x00;
-
-      for(i=0;i<9;i++)
-         send_block[send_cnt++] = 0xFF;
-
-      if(owBlock(portnum,FALSE,send_block,send_cnt))
-      {
-         setcrc8(portnum,0);
-
-         for(i=2;i<send_cnt;i++)
-            lastcrc8 = docrc8(portnum,send_block[i]);
-
-         if(lastcrc8 != 0x00)
-            return ret;
-
-      }
-      else
-         return ret;    
-      
 /* Doesn't handle negative properly
-      ret = (((send_block[4] << 8) | send_block[3]) >> 3) * 0.03125;
+   ret = (((send_block[4] << 8) | send_block[3]) >> 3) * 0.03125;
 */
-     ret = ((((send_block[4] & 0x7F) << 8) | send_block[3]) >> 3);
-
-     if( send_block[4] & 0x80 )
-     {
-       /* Negative, take 2's complement and make it negative */
-       ret = -1 * (0x1000 - ret);
-     }
-     ret =  ret * 0.03125;
-   }//Access
+   ret = ((((send_block[4] & 0x7F) << 8) | send_block[3]) >> 3);
+
+   if( send_block[4] & 0x80 )
+   {
+     /* Negative, take 2's complement and make it negative */
+     ret = -1 * (0x1000 - ret);
+   }
+   ret =  ret * 0.03125;
 
    return ret;
 }
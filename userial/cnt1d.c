@@ -32,12 +32,11 @@
 #include "ownet.h"
 
 // external One Wire functions from nework layer
-extern SMALLINT owAccess(int);
 extern void     owSerialNum(int,uchar *,SMALLINT);
 extern SMALLINT owVerify(int,SMALLINT);
 
 // external One Wire functions from transaction layer
-extern SMALLINT owBlock(int,SMALLINT,uchar *,SMALLINT);
+extern SMALLINT owAccessBlock(int,SMALLINT,uchar *,SMALLINT);
 
 // external functions defined in crcutil.c
 extern void setcrc16(int,ushort);
@@ -74,42 +73,38 @@ SMALLINT ReadCounter(int portnum, int CounterPage,  unsigned long *Count)
 /* 2/12/2003 [bcl] DigiTemp does this before calling the routine */
 /*   owSerialNum(portnum,SerialNum,FALSE); */
 
-   // access the device
-   if (owAccess(portnum))
+   // create a block to send that reads the counter
+   // read memory and counter command
+   send_block[send_cnt++] = 0xA5;
+   docrc16(portnum,0xA5);
+   // address of last data byte before counter
+   address = (CounterPage << 5) + 31;  // (1.02)
+   send_block[send_cnt++] = (uchar)(address & 0xFF);
+   docrc16(portnum,(ushort)(address & 0xFF));
+   send_block[send_cnt++] = (uchar)(address >> 8);
+   docrc16(portnum,(ushort)(address >> 8));
+   // now add the read bytes for data byte,counter,zero bits, crc16
+   for (i = 0; i < 11; i++)
+      send_block[send_cnt++] = 0xFF;
+
+   // access the device and send the block in one transaction
+   if (owAccessBlock(portnum,FALSE,send_block,send_cnt))
    {
-      // create a block to send that reads the counter
-      // read memory and counter command
-      send_block[send_cnt++] = 0xA5;
-      docrc16(portnum,0xA5);
-      // address of last data byte before counter
-      address = (CounterPage << 5) + 31;  // (1.02)
-      send_block[send_cnt++] = (uchar)(address & 0xFF);
-      docrc16(portnum,(ushort)(address & 0xFF));
-      send_block[send_cnt++] = (uchar)(address >> 8);
-      docrc16(portnum,(ushort)(address >> 8));
-      // now add the read bytes for data byte,counter,zero bits, crc16
-      for (i = 0; i < 11; i++)
-         send_block[send_cnt++] = 0xFF;
+      // perform the CRC16 on the last 11 bytes of packet
+      for (i = send_cnt - 11; i < send_cnt; i++)
+         lastcrc16 = docrc16(portnum,send_block[i]);
 
-      // now send the block
-      if (owBlock(portnum,FALSE,send_block,send_cnt))
+      // verify CRC16 is correct
+      if (lastcrc16 == 0xB001)
       {
-         // perform the CRC16 on the last 11 bytes of packet
-         for (i = send_cnt - 11; i < send_cnt; i++)
-            lastcrc16 = docrc16(portnum,send_block[i]);
-
-         // verify CRC16 is correct
-         if (lastcrc16 == 0xB001)
+         // success
+         rt = TRUE;
+         // extract the counter value
+         *Count = 0;
+         for (i = send_cnt - 7; i >= send_cnt - 10; i--)
          {
-            // success
-            rt = TRUE;
-            // extract the counter value
-            *Count = 0;
-            for (i = send_cnt - 7; i >= send_cnt - 10; i--)
-            {
-               *Count <<= 8;
-               *Count |= send_block[i];
-            }
+            *Count <<= 8;
+            *Count |= send_block[i];
          }
       }
    }
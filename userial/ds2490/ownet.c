@@ -35,15 +35,25 @@
 //           1.03 -> 2.00  Changed 'MLan' to 'ow'. Added support for
 //                         multiple ports.
 //           2.00 -> 2.01  Added support for owError library
+//           2.01 -> 2.02  owAccess resets and sends Match ROM with one
+//                         owBlock
+//           2.02 -> 2.03  Searches with a reset use the DS2490's
+//                         SEARCH_ACCESS and hand out the ROMs it found
 //
 
 #include <stdio.h>
+#include <string.h>
 #include "ownet.h"
 #include "owproto.h"
+#include "usblnk.h"
 
 // External funcs
 extern SMALLINT owTouchBit(int,SMALLINT);
 extern SMALLINT owSpeed(int,SMALLINT);
+extern int owSearchAccess(int,SMALLINT,uchar *,uchar *,SMALLINT *);
+
+// Most ROMs kept from one search of the 1-Wire Net
+#define SEARCH_MAX 256
 
 // exportable functions defined in ownet.c
 SMALLINT bitacc(SMALLINT,SMALLINT,SMALLINT,uchar *);
@@ -54,6 +64,17 @@ static SMALLINT LastFamilyDiscrepancy[MAX_PORTNUM];
 static SMALLINT LastDevice[MAX_PORTNUM];
 uchar SerialNum[MAX_PORTNUM][8];
 
+// ROMs from the last SEARCH_ACCESS search, handed out by owNext
+static uchar SearchROM[MAX_PORTNUM][SEARCH_MAX][8];
+static int SearchCount[MAX_PORTNUM];
+static int SearchPos[MAX_PORTNUM];
+static SMALLINT SearchValid[MAX_PORTNUM];
+static SMALLINT SearchAlarm[MAX_PORTNUM];
+static SMALLINT SearchSeek[MAX_PORTNUM];
+
+static SMALLINT owSearchAll(int,SMALLINT);
+static SMALLINT owSearchNext(int,SMALLINT);
+
 //--------------------------------------------------------------------------
 // The 'owFirst' finds the first device on the 1-Wire Net  This function
 // contains one parameter 'alarm_only'.  When
@@ -79,6 +100,8 @@ SMALLINT owFirst(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
    LastDiscrepancy[portnum] = 0;
    LastDevice[portnum] = FALSE;
    LastFamilyDiscrepancy[portnum] = 0;
+   SearchValid[portnum] = FALSE;
+   SearchSeek[portnum] = FALSE;
 
    return owNext(portnum,do_reset,alarm_only);
 }
@@ -93,6 +116,11 @@ SMALLINT owFirst(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
 // Using the find alarm command 0xEC will limit the search to only
 // 1-Wire devices that are in an 'alarm' state.
 //
+// With a reset the DS2490 searches the whole 1-Wire Net itself the first
+// time, and the rest of the devices come from what it found.  Without one
+// (a DS2409 branch that was just switched on) the search is done a bit
+// at a time.
+//
 // 'portnum'    - number 0 to MAX_PORTNUM-1.  This number is provided to
 //                indicate the symbolic port number.
 // 'do_reset'   - TRUE (1) perform reset before search, FALSE (0) do not
@@ -113,6 +141,13 @@ SMALLINT owNext(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
    uchar serial_byte_mask;
    uchar lastcrc8=0;
 
+   if (do_reset)
+      return owSearchNext(portnum,alarm_only);
+
+   // the bit by bit search doesn't follow the saved ROMs
+   SearchValid[portnum] = FALSE;
+   SearchSeek[portnum] = FALSE;
+
    // initialize for search
    bit_number = 1;
    last_zero = 0;
@@ -124,22 +159,6 @@ SMALLINT owNext(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
    // if the last call was not the last one
    if (!LastDevice[portnum])
    {
-      // check if reset first is requested
-      if (do_reset)
-      {
-         // reset the 1-wire
-         // if there are no parts on 1-wire, return FALSE
-         if (!owTouchReset(portnum))
-         {
-            // printf("owTouchReset failed\r\n");
-            // reset the search
-            LastDiscrepancy[portnum] = 0;
-            LastFamilyDiscrepancy[portnum] = 0;
-            OWERROR(OWERROR_NO_DEVICES_ON_NET);
-            return FALSE;
-         }
-      }
-
       // If finding alarming devices issue a different command
       if (alarm_only)
          owWriteByte(portnum,0xEC);  // issue the alarming search command
@@ -288,6 +307,10 @@ void owFamilySearchSetup(int portnum, SMALLINT search_family)
       SerialNum[portnum][i] = 0;
    LastDiscrepancy[portnum] = 64;
    LastDevice[portnum] = FALSE;
+
+   // search again and start with the first ROM of the family
+   SearchValid[portnum] = FALSE;
+   SearchSeek[portnum] = TRUE;
 }
 
 //--------------------------------------------------------------------------
@@ -304,6 +327,15 @@ void owSkipFamily(int portnum)
    // check for end of list
    if (LastDiscrepancy[portnum] == 0)
       LastDevice[portnum] = TRUE;
+
+   // step over the saved ROMs of the same family
+   if (SearchValid[portnum] && (SearchPos[portnum] > 0))
+   {
+      while ((SearchPos[portnum] < SearchCount[portnum]) &&
+             (SearchROM[portnum][SearchPos[portnum]][0] ==
+              SearchROM[portnum][SearchPos[portnum] - 1][0]))
+         SearchPos[portnum]++;
+   }
 }
 
 //--------------------------------------------------------------------------
@@ -325,36 +357,28 @@ SMALLINT owAccess(int portnum)
    uchar sendpacket[9];
    uchar i;
 
-   // reset the 1-wire
-   if (owTouchReset(portnum))
+   // create a buffer to use with block function
+   // match Serial Number command 0x55
+   sendpacket[0] = 0x55;
+   // Serial Number
+   for (i = 1; i < 9; i++)
+      sendpacket[i] = SerialNum[portnum][i-1];
+
+   // reset and send/recieve the transfer buffer with one command
+   if (owBlock(portnum,TRUE,sendpacket,9))
    {
-      // create a buffer to use with block function
-      // match Serial Number command 0x55
-      sendpacket[0] = 0x55;
-      // Serial Number
+      // verify that the echo of the writes was correct
       for (i = 1; i < 9; i++)
-         sendpacket[i] = SerialNum[portnum][i-1];
-
-      // send/recieve the transfer buffer
-      if (owBlock(portnum,FALSE,sendpacket,9))
-      {
-         // verify that the echo of the writes was correct
-         for (i = 1; i < 9; i++)
-            if (sendpacket[i] != SerialNum[portnum][i-1])
-               return FALSE;
-         if (sendpacket[0] != 0x55)
-         {
-            OWERROR(OWERROR_WRITE_VERIFY_FAILED);
+         if (sendpacket[i] != SerialNum[portnum][i-1])
             return FALSE;
-         }
-         else
-            return TRUE;
+      if (sendpacket[0] != 0x55)
+      {
+         OWERROR(OWERROR_WRITE_VERIFY_FAILED);
+         return FALSE;
       }
       else
-         OWERROR(OWERROR_BLOCK_FAILED);
+         return TRUE;
    }
-   else
-      OWERROR(OWERROR_NO_DEVICES_ON_NET);
 
    // reset or match echo failed
    return FALSE;
@@ -532,3 +556,117 @@ SMALLINT bitacc(SMALLINT op, SMALLINT state, SMALLINT loc, uchar *buf)
       return ((buf[nbyt] >> nbit) & 0x01);
 }
 
+//--------------------------------------------------------------------------
+// Search the whole 1-Wire Net with SEARCH_ACCESS and save the ROMs that
+// have a good CRC8, in the order the search found them.  This is the
+// same order as the bit by bit search.
+//
+// Returns:   TRUE (1) : at least one device was found
+//            FALSE (0): no devices, or the search failed
+//
+static SMALLINT owSearchAll(int portnum, SMALLINT alarm_only)
+{
+   uchar rom_path[8];
+   uchar roms[SEARCH_ROMS * 8];
+   uchar lastcrc8=0;
+   SMALLINT more;
+   int num,i,j;
+
+   SearchCount[portnum] = 0;
+   SearchPos[portnum] = 0;
+   SearchAlarm[portnum] = alarm_only;
+   SearchValid[portnum] = FALSE;
+
+   memset(rom_path,0,8);
+   do
+   {
+      num = owSearchAccess(portnum,alarm_only,rom_path,roms,&more);
+      if (num < 0)
+      {
+         OWERROR(OWERROR_SEARCH_ERROR);
+         return FALSE;
+      }
+
+      for (i = 0; (i < num) && (SearchCount[portnum] < SEARCH_MAX); i++)
+      {
+         setcrc8(portnum,0);
+         for (j = 0; j < 8; j++)
+            lastcrc8 = docrc8(portnum,roms[i * 8 + j]);
+         if (lastcrc8 || !roms[i * 8])
+            continue;
+
+         memcpy(SearchROM[portnum][SearchCount[portnum]++],&roms[i * 8],8);
+      }
+   }
+   while (more && (SearchCount[portnum] < SEARCH_MAX));
+
+   if (SearchCount[portnum] == 0)
+   {
+      OWERROR(OWERROR_NO_DEVICES_ON_NET);
+      return FALSE;
+   }
+
+   SearchValid[portnum] = TRUE;
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// Compare two ROMs in search order, the first bit sent is the first
+// compared.
+//
+static int rom_order(uchar *a, uchar *b)
+{
+   int i,ba,bb;
+
+   for (i = 0; i < 64; i++)
+   {
+      ba = (a[i / 8] >> (i % 8)) & 0x01;
+      bb = (b[i / 8] >> (i % 8)) & 0x01;
+      if (ba != bb)
+         return ba - bb;
+   }
+
+   return 0;
+}
+
+//--------------------------------------------------------------------------
+// owNext with a reset, the next ROM from the last SEARCH_ACCESS search.
+// The first call searches, and so does a call after the last ROM was
+// handed out.  After owFamilySearchSetup it starts with the first ROM
+// that the bit by bit search would have found from SerialNum[portnum].
+//
+static SMALLINT owSearchNext(int portnum, SMALLINT alarm_only)
+{
+   if (!SearchValid[portnum] || (SearchAlarm[portnum] != alarm_only))
+   {
+      if (!owSearchAll(portnum,alarm_only))
+      {
+         LastDiscrepancy[portnum] = 0;
+         LastDevice[portnum] = FALSE;
+         LastFamilyDiscrepancy[portnum] = 0;
+         SearchSeek[portnum] = FALSE;
+         return FALSE;
+      }
+   }
+
+   if (SearchSeek[portnum])
+   {
+      while ((SearchPos[portnum] < SearchCount[portnum]) &&
+             (rom_order(SearchROM[portnum][SearchPos[portnum]],SerialNum[portnum]) < 0))
+         SearchPos[portnum]++;
+      SearchSeek[portnum] = FALSE;
+   }
+
+   // the last one was handed out, the next call is like a first
+   if (SearchPos[portnum] >= SearchCount[portnum])
+   {
+      SearchValid[portnum] = FALSE;
+      LastDiscrepancy[portnum] = 0;
+      LastDevice[portnum] = FALSE;
+      LastFamilyDiscrepancy[portnum] = 0;
+      return FALSE;
+   }
+
+   memcpy(SerialNum[portnum],SearchROM[portnum][SearchPos[portnum]++],8);
+   return TRUE;
+}
@@ -31,11 +31,22 @@
 //  History: 1.03 -> 2.00  Changed 'MLan' to 'ow'. Added support for
 //                         multiple ports.
 //           2.00 -> 2.01  Added support for owError library
+//           2.01 -> 2.02  Added owAccessBlock
+//           2.02 -> 2.03  owBlock sends the whole block, and the reset,
+//                         with the DS2490's BLOCK_IO command.
+//                         owAccessBlock sends Match ROM with the block.
 //
 
+#include <string.h>
 #include "ownet.h"
 #include "owproto.h"
 
+// global serial number of the current device, from ownet.c
+extern uchar SerialNum[MAX_PORTNUM][8];
+
+// external functions defined in usblnk.c
+extern SMALLINT owBlockIO(int,SMALLINT,uchar *,int);
+
 
 //--------------------------------------------------------------------------
 // The 'owBlock' transfers a block of data to and from the
@@ -60,8 +71,6 @@
 //
 SMALLINT owBlock(int portnum, SMALLINT do_reset, uchar *tran_buf, SMALLINT tran_len)
 {
-   uchar i;
-
    // check for a block too big
    if (tran_len > 160)
    {
@@ -69,21 +78,88 @@ SMALLINT owBlock(int portnum, SMALLINT do_reset, uchar *tran_buf, SMALLINT tran_
       return FALSE;
    }
 
-   // check if need to do a owTouchReset first
-   if (do_reset)
+   // the reset and the whole block in one go
+   if (!owBlockIO(portnum,do_reset,tran_buf,tran_len))
    {
-      if (!owTouchReset(portnum))
-      {
+      if (do_reset)
          OWERROR(OWERROR_NO_DEVICES_ON_NET);
+      else
+         OWERROR(OWERROR_BLOCK_FAILED);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// The 'owAccessBlock' resets the 1-Wire Net, selects the current device
+// with Match ROM and transfers a block of data to and from it.  The
+// result is returned in the same buffer.
+//
+// 'power'    - turn on the strong pullup after the last byte TRUE(1)
+//              or not FALSE(0)
+// 'tran_buf' - pointer to a block of unsigned
+//              chars of length 'tran_len' that will be sent
+//              to the 1-Wire Net
+// 'tran_len' - length in bytes to transfer
+// Supported devices: all
+//
+// Returns:   TRUE (1) : The device answered the reset and the Match ROM
+//                       echo was correct.  With 'power' the strong
+//                       pullup is now on.
+//            FALSE (0): The device could not be selected or the
+//                       transfer failed.
+//
+SMALLINT owAccessBlock(int portnum, SMALLINT power, uchar *tran_buf, SMALLINT tran_len)
+{
+   uchar sendpacket[9 + 160];
+   uchar i;
+
+   if (!power)
+   {
+      // check for a block too big
+      if (tran_len > 160)
+      {
+         OWERROR(OWERROR_BLOCK_TOO_BIG);
+         return FALSE;
+      }
+
+      // reset, Match ROM and the block all with one BLOCK_IO command
+      sendpacket[0] = 0x55;
+      for (i = 1; i < 9; i++)
+         sendpacket[i] = SerialNum[portnum][i-1];
+      memcpy(&sendpacket[9],tran_buf,tran_len);
+
+      if (!owBlockIO(portnum,TRUE,sendpacket,9 + tran_len))
+      {
+         OWERROR(OWERROR_ACCESS_FAILED);
          return FALSE;
       }
+
+      // verify that the echo of the Match ROM was correct
+      for (i = 0; i < 9; i++)
+      {
+         if (sendpacket[i] != ((i == 0) ? 0x55 : SerialNum[portnum][i-1]))
+         {
+            OWERROR(OWERROR_WRITE_VERIFY_FAILED);
+            return FALSE;
+         }
+      }
+
+      memcpy(tran_buf,&sendpacket[9],tran_len);
+      return TRUE;
    }
 
-   // send and receive the buffer
-   for (i = 0; i < tran_len; i++)
-      tran_buf[i] = (uchar)owTouchByte(portnum,tran_buf[i]);
+   if (!owAccess(portnum))
+      return FALSE;
 
-   return TRUE;
+   // the last byte goes out with the strong pullup
+   if (tran_len < 1)
+      return FALSE;
+   if ((tran_len > 1) && !owBlock(portnum,FALSE,tran_buf,tran_len - 1))
+      return FALSE;
+
+   return owWriteBytePower(portnum,tran_buf[tran_len - 1]);
 }
 
 //--------------------------------------------------------------------------
@@ -32,12 +32,21 @@
 //           3.00 -> 3.10:  bcl	  Implemented strong pullup and program pulse
 //                                support that was keeping it from working
 //                                correctly using owWriteBytePower()
+//           3.10 -> 3.20:        Added owBlockIO(), a whole block with one
+//                                BLOCK_IO command and the bulk endpoints
+//                                instead of a control transfer per byte
+//           3.20 -> 3.30:        Added owSearchAccess(), the DS2490's own
+//                                ROM search
+//           3.30 -> 4.00:        Moved to libusb-1.0.  A status transfer
+//                                stays queued on the interrupt endpoint
+//                                and wakes the commands waiting for it,
+//                                instead of polling with a 1ms sleep
 // 
 #include "ownet.h"
-#include "usb.h"
+#include <libusb.h>
 #include <errno.h>
 #include <time.h>
-#include <assert.h>
+#include <pthread.h>
 #include "usblnk.h"
 
 /* wrap in Linux? */
@@ -47,8 +56,33 @@
 
 #define TIMEOUT_VALUE	5000
 
+/* status packets to wait for the result of a reset, about 1ms each */
+#define RESET_PACKETS	20
+
 /* the structure we'll use to access other devices */
-extern struct usb_dev_handle *usb_dev_handle_list[MAX_PORTNUM];
+extern libusb_context *usb_ctx;
+extern libusb_device_handle *usb_dev_handle_list[MAX_PORTNUM];
+
+/* what the status transfer of a port has seen */
+struct ds2490_status {
+	struct libusb_transfer *transfer;
+	unsigned char buffer[0x20];
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int active;		/* the transfer is queued */
+	unsigned long packets;	/* status packets so far */
+	int idle;		/* idle bit of the last one */
+	int results;		/* result codes since the last command */
+	int got_result;
+};
+
+static struct ds2490_status ds_status[MAX_PORTNUM];
+
+/* the thread that handles libusb's events, while a port is open */
+static pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t event_thread;
+static int event_ports = 0;
+static int event_exit = 0;
 
 // exportable link-level functions
 SMALLINT owTouchReset(int);
@@ -66,6 +100,14 @@ SMALLINT hasOverDrive(int);
 SMALLINT hasProgramPulse(int);
 SMALLINT owWriteBytePower(int,SMALLINT);
 SMALLINT owReadBitPower(int, SMALLINT);
+SMALLINT owBlockIO(int,SMALLINT,uchar *,int);
+int owSearchAccess(int,SMALLINT,uchar *,uchar *,SMALLINT *);
+int ds2490_status_start(int);
+void ds2490_status_stop(int);
+
+static int ds2490_command(int,int,int,int,unsigned long *);
+static int ds2490_wait(int,unsigned long,int,int *);
+static int ds2490_bulk(int,unsigned char,uchar *,int);
 
 //--------------------------------------------------------------------------
 // Reset all of the devices on the 1-Wire Net and return the result.
@@ -78,68 +120,25 @@ SMALLINT owReadBitPower(int, SMALLINT);
 //
 int owTouchReset(int portnum)
 {
-	int result; 
-	char buffer[0x20];
-	int count = 20;
-	int got_result = 0;
-	struct timespec to_wait = {0, 1000000}; // Wait for 1ms between polls
-	int keep_going = 1;
+	unsigned long mark;
+	int results;
 
 	/* issue the 1-wire reset. Ensure the NTF bit is set so we can
 	   get results. */
-	result = usb_control_msg(usb_dev_handle_list[portnum], 0x40,
-			COMM_CMD, 0x0443, 0x0000, NULL, 0x0, TIMEOUT_VALUE);
-	//printf("result is %d\n", result);
-
-	/* repeat until:
-		- an error occurs, or
-		- the unit is idle, and we've either got a result, or
-			waited long enough that none is likely to come */
-	do {
-		memset(buffer, 0x00, sizeof(buffer));
-		/* get the status */
-		result = usb_interrupt_read(usb_dev_handle_list[portnum], 0x81,
-				buffer, 0x20, TIMEOUT_VALUE);
-		//printf("result is %d\n", result);
-		if (result < 0) {
-			keep_going = 0;
-		} else {
-			assert(result >= 0x10);
-			if (result > 0x10) {
-				got_result = 1;
-			}
-			if (buffer[0x08] & 0x20) {
-				/* Device is idle. Finish if we have a result
-				   or if we give up. */
-				if (got_result) {
-					keep_going = 0;
-				} else {
-					count--;
-					if (count == 0) {
-						keep_going = 0;
-					}
-				}
-			}
-		}
-		if (keep_going) {
-			nanosleep(&to_wait, NULL);
-		}
-
-		//for (result = 0; result < 0x20; result++) {
-		//	printf("%02X: %02X\n", result, buffer[result]);
-		//}
-	} while (keep_going);
+	if (ds2490_command(portnum, COMM_CMD, 0x0443, 0x0000, &mark) < 0)
+		return FALSE;
 
-	if (result < 0)
+	/* wait until the unit is idle, and we've either got a result, or
+	   waited long enough that none is likely to come */
+	if (!ds2490_wait(portnum, mark, TRUE, &results))
 		return FALSE;
 
-        /* Only declare there was nothing on the bus if we got a result
-           otherwise we may just have missed it due to timing issues */
-	if (got_result && (buffer[0x10] & 0x01)) {
+	/* Only declare there was nothing on the bus if we got a result
+	   otherwise we may just have missed it due to timing issues */
+	if (results & RESULT_NRS)
 		return FALSE;
-	} else {
+	else
 		return TRUE;
-	}
 }
 
 //--------------------------------------------------------------------------
@@ -157,36 +156,20 @@ int owTouchReset(int portnum)
 //
 int owTouchBit(int portnum, SMALLINT sendbit)
 {
-	int result; 
-	char retval;
-	char buffer[0x20];
+	unsigned long mark;
+	int results;
+	uchar retval = 0;
 
 	/* issue the bit i/o command */
-	result = usb_control_msg(usb_dev_handle_list[portnum], 0x40,
-			COMM_CMD, 0x0021 | (sendbit << 3), 0x0000, NULL, 0x0, TIMEOUT_VALUE);
-	//printf("result is %d\n", result);
-
-	/* repeat until the unit is not idle */
-	do {
-		memset(buffer, 0x00, sizeof(buffer));
-		/* get the status */
-		result = usb_bulk_read(usb_dev_handle_list[portnum], 0x81,
-				buffer, 0x20, TIMEOUT_VALUE);
-		//printf("result is %d\n", result);
-
-		//for (result = 0; result < 0x20; result++) {
-		//	printf("%02X: %02X\n", result, buffer[result]);
-		//}
-	} while (!(buffer[0x08] & 0x20) && !(result < 0));
+	if (ds2490_command(portnum, COMM_CMD, 0x0021 | (sendbit << 3),
+			0x0000, &mark) < 0)
+		return 0;
 
-	/* get the data */
-	result = usb_bulk_read(usb_dev_handle_list[portnum], 0x83,
-			&retval, 0x1, 1000);
-	if (result == -1) {
-		printf ("owTouchBit: clearing halt\n");
-		usb_clear_halt(usb_dev_handle_list[portnum], 0x83);
-	}
+	/* wait until the unit is idle */
+	ds2490_wait(portnum, mark, FALSE, &results);
 
+	/* get the data */
+	ds2490_bulk(portnum, EP_DATA_IN, &retval, 1);
 
 	/* return the data */
 	return retval;
@@ -206,35 +189,20 @@ int owTouchBit(int portnum, SMALLINT sendbit)
 //
 int owTouchByte(int portnum, SMALLINT sendbyte)
 {
-	int result; 
-	char retval;
-	char buffer[0x20];
+	unsigned long mark;
+	int results;
+	uchar retval = 0;
 
 	/* issue the byte i/o command */
-	result = usb_control_msg(usb_dev_handle_list[portnum], 0x40,
-			COMM_CMD, 0x0053, 0x0000 | sendbyte, NULL, 0x0, TIMEOUT_VALUE);
-	//printf("result is %d\n", result);
-
-	/* repeat until the unit is not idle */
-	do {
-		memset(buffer, 0x00, sizeof(buffer));
-		/* get the status */
-		result = usb_bulk_read(usb_dev_handle_list[portnum], 0x81,
-				buffer, 0x20, TIMEOUT_VALUE);
-		//printf("result is %d\n", result);
-
-		//for (result = 0; result < 0x20; result++) {
-		//	printf("%02X: %02X\n", result, buffer[result]);
-		//}
-	} while (!(buffer[0x08] & 0x20) && !(result < 0));
+	if (ds2490_command(portnum, COMM_CMD, 0x0053, 0x0000 | sendbyte,
+			&mark) < 0)
+		return 0;
+
+	/* wait until the unit is idle */
+	ds2490_wait(portnum, mark, FALSE, &results);
 
 	/* get the data */
-	result = usb_bulk_read(usb_dev_handle_list[portnum], 0x83,
-			&retval, 0x1, 1000);
-	if (result == -1) {
-		printf ("owTouchByte: clearing halt\n");
-		usb_clear_halt(usb_dev_handle_list[portnum], 0x83);
-	}
+	ds2490_bulk(portnum, EP_DATA_IN, &retval, 1);
 
 	/* return the data */
 	return retval;
@@ -284,44 +252,18 @@ int owReadByte(int portnum)
 //
 int owSpeed(int portnum, SMALLINT new_speed)
 {
-	int result; 
-	char buffer[0x20];
+	unsigned long mark;
+	int results;
 
 	/* issue the command to enable speed changes */
-	result = usb_control_msg(usb_dev_handle_list[portnum], 0x40,
-			MODE_CMD, MOD_SPEED_CHANGE_EN, 0x0001, NULL, 0x0, TIMEOUT_VALUE);
-	//printf("result is %d\n", result);
-
-	/* repeat until the unit is not idle */
-	do {
-		memset(buffer, 0x00, sizeof(buffer));
-		/* get the status */
-		result = usb_bulk_read(usb_dev_handle_list[portnum], 0x81,
-				buffer, 0x20, TIMEOUT_VALUE);
-		//printf("result is %d\n", result);
-
-		//for (result = 0; result < 0x20; result++) {
-		//	printf("%02X: %02X\n", result, buffer[result]);
-		//}
-	} while (!(buffer[0x08] & 0x20) && !(result < 0));
+	if (ds2490_command(portnum, MODE_CMD, MOD_SPEED_CHANGE_EN, 0x0001,
+			&mark) >= 0)
+		ds2490_wait(portnum, mark, FALSE, &results);
 
 	/* issue the command to change the speed */
-	result = usb_control_msg(usb_dev_handle_list[portnum], 0x40,
-			MODE_CMD, MOD_1WIRE_SPEED, new_speed ? 0x0002 : 0x0000, NULL, 0x0, TIMEOUT_VALUE);
-	//printf("result is %d\n", result);
-
-	/* repeat until the unit is not idle */
-	do {
-		memset(buffer, 0x00, sizeof(buffer));
-		/* get the status */
-		result = usb_bulk_read(usb_dev_handle_list[portnum], 0x81,
-				buffer, 0x20, TIMEOUT_VALUE);
-		//printf("result is %d\n", result);
-
-		//for (result = 0; result < 0x20; result++) {
-		//	printf("%02X: %02X\n", result, buffer[result]);
-		//}
-	} while (!(buffer[0x08] & 0x20) && !(result < 0));
+	if (ds2490_command(portnum, MODE_CMD, MOD_1WIRE_SPEED,
+			new_speed ? 0x0002 : 0x0000, &mark) >= 0)
+		ds2490_wait(portnum, mark, FALSE, &results);
 
 	/* return the data */
 	return new_speed;
@@ -344,7 +286,8 @@ int owSpeed(int portnum, SMALLINT new_speed)
 int owLevel(int portnum, SMALLINT new_level)
 {
 	int result; 
-	char buffer[0x20];
+	unsigned long mark;
+	int results;
 	unsigned int  pulse;
 	
 	switch( new_level )
@@ -366,23 +309,10 @@ int owLevel(int portnum, SMALLINT new_level)
 	  	break;
 	}
 
-	/* issue the command to enable speed changes */
-	result = usb_control_msg(usb_dev_handle_list[portnum], 0x40,
-			MODE_CMD, MOD_PULSE_EN, pulse, NULL, 0x0, TIMEOUT_VALUE);
-	//printf("result is %d\n", result);
-
-	/* repeat until the unit is not idle */
-	do {
-		memset(buffer, 0x00, sizeof(buffer));
-		/* get the status */
-		result = usb_bulk_read(usb_dev_handle_list[portnum], 0x81,
-				buffer, 0x20, TIMEOUT_VALUE);
-		//printf("result is %d\n", result);
-
-		//for (result = 0; result < 0x20; result++) {
-		//	printf("%02X: %02X\n", result, buffer[result]);
-		//}
-	} while (!(buffer[0x08] & 0x20) && !(result < 0));
+	/* issue the command to enable the pulse */
+	result = ds2490_command(portnum, MODE_CMD, MOD_PULSE_EN, pulse, &mark);
+	if ((result >= 0) && !ds2490_wait(portnum, mark, FALSE, &results))
+		result = -1;
 
 	/* return the data */
 	return (result < 0) ? result : new_level;
@@ -531,3 +461,334 @@ SMALLINT hasProgramPulse(int portnum)
    return TRUE;
 }
 
+//--------------------------------------------------------------------------
+// A status packet came in, or the status transfer ended.  Note what it
+// said, wake whoever is waiting for it and queue the transfer again.
+//
+static void LIBUSB_CALL ds2490_status_cb(struct libusb_transfer *transfer)
+{
+	struct ds2490_status *st = transfer->user_data;
+	int i;
+
+	pthread_mutex_lock(&st->lock);
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+		st->idle = (transfer->actual_length > 0x08) &&
+				(st->buffer[0x08] & STATUS_IDLE);
+
+		/* anything after the 16 status bytes is a result code */
+		for (i = 0x10; i < transfer->actual_length; i++) {
+			st->results |= st->buffer[i];
+			st->got_result = 1;
+		}
+		st->packets++;
+
+		if (libusb_submit_transfer(transfer) < 0)
+			st->active = 0;
+	} else {
+		/* cancelled by ds2490_status_stop(), or the device is gone */
+		st->active = 0;
+	}
+	pthread_cond_broadcast(&st->cond);
+	pthread_mutex_unlock(&st->lock);
+}
+
+//--------------------------------------------------------------------------
+// Handle libusb's events until the last port is closed
+//
+static void *ds2490_events(void *arg)
+{
+	while (!event_exit)
+		libusb_handle_events_completed(usb_ctx, &event_exit);
+
+	return NULL;
+}
+
+//--------------------------------------------------------------------------
+// Queue the status transfer of a port that was just opened, and start
+// handling libusb's events if it is the first one.
+//
+// Returns:  TRUE  the status transfer is queued
+//           FALSE it couldn't be
+//
+int ds2490_status_start(int portnum)
+{
+	struct ds2490_status *st = &ds_status[portnum];
+
+	memset(st, 0, sizeof(struct ds2490_status));
+	pthread_mutex_init(&st->lock, NULL);
+	pthread_cond_init(&st->cond, NULL);
+
+	st->transfer = libusb_alloc_transfer(0);
+	if (st->transfer == NULL)
+		return FALSE;
+	libusb_fill_interrupt_transfer(st->transfer,
+			usb_dev_handle_list[portnum], EP_STATUS, st->buffer,
+			sizeof(st->buffer), ds2490_status_cb, st, 0);
+
+	pthread_mutex_lock(&event_lock);
+	if (event_ports == 0) {
+		event_exit = 0;
+		if (pthread_create(&event_thread, NULL, ds2490_events, NULL)) {
+			pthread_mutex_unlock(&event_lock);
+			libusb_free_transfer(st->transfer);
+			st->transfer = NULL;
+			return FALSE;
+		}
+	}
+	event_ports++;
+	pthread_mutex_unlock(&event_lock);
+
+	st->active = 1;
+	if (libusb_submit_transfer(st->transfer) < 0) {
+		st->active = 0;
+		ds2490_status_stop(portnum);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// Cancel the status transfer of a port before it is closed, and stop
+// handling events after the last one.
+//
+void ds2490_status_stop(int portnum)
+{
+	struct ds2490_status *st = &ds_status[portnum];
+
+	if (st->transfer == NULL)
+		return;
+
+	pthread_mutex_lock(&st->lock);
+	if (st->active)
+		libusb_cancel_transfer(st->transfer);
+	while (st->active)
+		pthread_cond_wait(&st->cond, &st->lock);
+	pthread_mutex_unlock(&st->lock);
+
+	libusb_free_transfer(st->transfer);
+	st->transfer = NULL;
+
+	pthread_mutex_lock(&event_lock);
+	if (--event_ports == 0) {
+		event_exit = 1;
+		libusb_interrupt_event_handler(usb_ctx);
+		pthread_join(event_thread, NULL);
+	}
+	pthread_mutex_unlock(&event_lock);
+
+	pthread_cond_destroy(&st->cond);
+	pthread_mutex_destroy(&st->lock);
+}
+
+//--------------------------------------------------------------------------
+// Send a command to the DS2490.  'mark' is set to the number of status
+// packets seen once it was taken, the one that says it is done comes
+// after that.
+//
+// Returns:  the control transfer's result, < 0 if it failed
+//
+static int ds2490_command(int portnum, int request, int value, int index,
+		unsigned long *mark)
+{
+	struct ds2490_status *st = &ds_status[portnum];
+	int result;
+
+	pthread_mutex_lock(&st->lock);
+	st->results = 0;
+	st->got_result = 0;
+	pthread_mutex_unlock(&st->lock);
+
+	result = libusb_control_transfer(usb_dev_handle_list[portnum], 0x40,
+			request, value, index, NULL, 0x0, TIMEOUT_VALUE);
+
+	pthread_mutex_lock(&st->lock);
+	*mark = st->packets;
+	pthread_mutex_unlock(&st->lock);
+
+	return result;
+}
+
+//--------------------------------------------------------------------------
+// Sleep until a status packet after 'mark' says the DS2490 is idle.  With
+// 'need_result' also wait for a result code, for up to RESET_PACKETS
+// packets.  The result codes since the command are ORed into 'results'.
+//
+// Returns:  TRUE  the adapter is idle
+//           FALSE the status transfer stopped or timed out
+//
+static int ds2490_wait(int portnum, unsigned long mark, int need_result,
+		int *results)
+{
+	struct ds2490_status *st = &ds_status[portnum];
+	struct timespec deadline;
+	int ok = TRUE;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += TIMEOUT_VALUE / 1000;
+
+	pthread_mutex_lock(&st->lock);
+	for (;;) {
+		if ((st->packets > mark) && st->idle &&
+				(!need_result || st->got_result ||
+				 (st->packets - mark >= RESET_PACKETS)))
+			break;
+
+		if (!st->active || (pthread_cond_timedwait(&st->cond,
+				&st->lock, &deadline) == ETIMEDOUT)) {
+			ok = FALSE;
+			break;
+		}
+	}
+	*results = st->results;
+	pthread_mutex_unlock(&st->lock);
+
+	return ok;
+}
+
+//--------------------------------------------------------------------------
+// Bulk transfer on one of the data endpoints, clearing a stall.
+//
+// Returns:  bytes transferred, or -1 if it failed
+//
+static int ds2490_bulk(int portnum, unsigned char endpoint, uchar *buf,
+		int len)
+{
+	int result;
+	int done = 0;
+
+	result = libusb_bulk_transfer(usb_dev_handle_list[portnum], endpoint,
+			buf, len, &done, TIMEOUT_VALUE);
+	if (result == LIBUSB_ERROR_PIPE) {
+		printf("ds2490_bulk: clearing halt\n");
+		libusb_clear_halt(usb_dev_handle_list[portnum], endpoint);
+	}
+	if ((result < 0) && (result != LIBUSB_ERROR_TIMEOUT))
+		return -1;
+
+	return done;
+}
+
+//--------------------------------------------------------------------------
+// Send a block to the 1-Wire Net and read back what came back, with one
+// BLOCK_IO command for each FIFO full.  The bytes go out on the bulk OUT
+// endpoint and come back on the bulk IN endpoint, instead of a control
+// transfer and status polling for every byte.
+//
+// 'portnum'    - number 0 to MAX_PORTNUM-1.  This number is provided to
+//                indicate the symbolic port number.
+// 'do_reset'   - reset the 1-Wire Net before the first byte TRUE(1) or
+//                not FALSE(0)
+// 'tran_buf'   - bytes to send, replaced by the bytes read
+// 'tran_len'   - number of bytes
+//
+// Returns:  TRUE  the block was sent and read back
+//           FALSE there was no presence pulse after the reset, or the
+//                 transfer failed
+//
+SMALLINT owBlockIO(int portnum, SMALLINT do_reset, uchar *tran_buf, int tran_len)
+{
+	unsigned long mark;
+	int results;
+	int len;
+	int done = 0;
+	int cmd;
+
+	while (done < tran_len)
+	{
+		len = tran_len - done;
+		if (len > FIFO_SIZE)
+			len = FIFO_SIZE;
+
+		/* queue the bytes */
+		if (ds2490_bulk(portnum, EP_DATA_OUT, &tran_buf[done], len) != len)
+			return FALSE;
+
+		/* send them all with one command, the reset goes first */
+		cmd = COMM_BLOCK_IO | COMM_IM;
+		if (do_reset && (done == 0))
+			cmd |= COMM_RST;
+		if (ds2490_command(portnum, COMM_CMD, cmd, len, &mark) < 0)
+			return FALSE;
+
+		if (!ds2490_wait(portnum, mark, FALSE, &results))
+			return FALSE;
+		if ((cmd & COMM_RST) && (results & (RESULT_NRS | RESULT_SH)))
+		{
+			/* clear out what was read anyway */
+			ds2490_bulk(portnum, EP_DATA_IN, &tran_buf[done], len);
+			return FALSE;
+		}
+
+		/* get what came back */
+		if (ds2490_bulk(portnum, EP_DATA_IN, &tran_buf[done], len) != len)
+			return FALSE;
+
+		done += len;
+	}
+
+	return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// Reset the 1-Wire Net and search it with the DS2490's SEARCH_ACCESS
+// command.  The adapter runs the search algorithm itself and returns up
+// to SEARCH_ROMS serial numbers, and the path to take next when there are
+// more, with one command instead of three bit transfers per ROM bit.
+//
+// 'portnum'    - number 0 to MAX_PORTNUM-1.  This number is provided to
+//                indicate the symbolic port number.
+// 'alarm_only' - TRUE (1) the find alarm command 0xEC is
+//                sent instead of the normal search command 0xF0
+// 'rom_path'   - 8 bytes, where the search starts, all zeros for the first
+//                pass.  Replaced with the start of the next pass.
+// 'roms'       - serial numbers found, SEARCH_ROMS * 8 bytes
+// 'more'       - set to TRUE(1) when there are more devices to find with
+//                the new 'rom_path'
+//
+// Returns:  number of serial numbers found, 0 when nothing answered the
+//           reset, or -1 if the transfer failed
+//
+int owSearchAccess(int portnum, SMALLINT alarm_only, uchar *rom_path,
+		uchar *roms, SMALLINT *more)
+{
+	unsigned long mark;
+	int result;
+	int results;
+	int num;
+	int index;
+	uchar buffer[(SEARCH_ROMS + 1) * 8];
+
+	*more = FALSE;
+
+	/* where to start */
+	if (ds2490_bulk(portnum, EP_DATA_OUT, rom_path, 8) != 8)
+		return -1;
+
+	/* search command in the low byte, number of ROMs in the high byte */
+	index = (alarm_only ? 0xEC : 0xF0) | (SEARCH_ROMS << 8);
+	if (ds2490_command(portnum, COMM_CMD, COMM_SEARCH_ACCESS | COMM_IM |
+			COMM_RST | COMM_SM | COMM_F | COMM_RTS, index, &mark) < 0)
+		return -1;
+
+	if (!ds2490_wait(portnum, mark, FALSE, &results))
+		return -1;
+	if (results & (RESULT_NRS | RESULT_SH))
+		return 0;
+
+	/* the ROMs, and the next path after them if there are more */
+	result = ds2490_bulk(portnum, EP_DATA_IN, buffer, sizeof(buffer));
+	if (result < 0)
+		return -1;
+
+	num = result / 8;
+	if (num > SEARCH_ROMS)
+	{
+		memcpy(rom_path, &buffer[SEARCH_ROMS * 8], 8);
+		*more = TRUE;
+		num = SEARCH_ROMS;
+	}
+	memcpy(roms, buffer, num * 8);
+
+	return num;
+}
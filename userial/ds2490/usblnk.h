@@ -23,3 +23,24 @@
 #define MOD_WRITE1_LOWTIME	0x0006
 #define MOD_DSOW0_TREC		0x0007
 
+
+#define COMM_BLOCK_IO		0x0074
+#define COMM_IM			0x0001
+#define COMM_RST		0x0100
+#define COMM_SPU		0x1000
+#define COMM_SEARCH_ACCESS	0x00F4
+#define COMM_SM			0x0008
+#define COMM_F			0x0800
+#define COMM_RTS		0x4000
+
+#define EP_STATUS		0x81
+#define EP_DATA_OUT		0x02
+#define EP_DATA_IN		0x83
+
+#define FIFO_SIZE		128	/* Data FIFOs, each way */
+#define SEARCH_ROMS		15	/* ROMs per SEARCH_ACCESS, and the next
+					   path, fill the FIFO */
+
+#define STATUS_IDLE		0x20	/* Status byte 0x08 */
+#define RESULT_NRS		0x01	/* No presence pulse after a reset */
+#define RESULT_SH		0x02	/* 1-Wire short */
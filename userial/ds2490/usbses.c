@@ -26,11 +26,19 @@
 //  usb_sessuin.c - General 1-Wire session layer for the DS2490 on Linux 
 //
 //  Version: 3.00B
+//
+//           3.00 -> 4.00:  Moved to libusb-1.0.  The status transfer of
+//                          each port is started when it is acquired.
+//                          The device is picked by the port name, not by
+//                          the port number
 // 
 
 #include "ownet.h"
-#include <usb.h>
+#include <libusb.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <pthread.h>
 #include "digitemp.h"
 
 
@@ -38,11 +46,20 @@ SMALLINT owAcquire(int,char *, char *);
 void owRelease(int,char *);
 static void usb_ds2490_init(void);
 
-struct usb_dev_handle *usb_dev_handle_list[MAX_PORTNUM];
-struct usb_device *usb_dev_list[MAX_PORTNUM];
+// from usblnk.c
+extern int ds2490_status_start(int);
+extern void ds2490_status_stop(int);
+
+libusb_context *usb_ctx = NULL;
+libusb_device_handle *usb_dev_handle_list[MAX_PORTNUM];
+libusb_device *usb_dev_list[MAX_PORTNUM];
 int usb_num_devices = -1;
 int initted_flag = 0;
 
+// device of each acquired port, -1 when it isn't open
+static int usb_port_dev[MAX_PORTNUM];
+static int usb_dev_open[MAX_PORTNUM];
+
 extern int opts;            // Command line options
 
 
@@ -51,34 +68,68 @@ extern int opts;            // Command line options
 //
 void usb_ds2490_init(void)
 {
-	struct usb_bus *bus;
-	struct usb_device *dev;
+	libusb_device **list;
+	struct libusb_device_descriptor desc;
+	ssize_t count, i;
+
+	initted_flag = 1;
+
+	for (i = 0; i < MAX_PORTNUM; i++)
+		usb_port_dev[i] = -1;
 
 	// initialize USB subsystem
-	usb_init();
-	usb_set_debug(0);
-	usb_find_busses();
-	usb_find_devices();
+	if (libusb_init(&usb_ctx) < 0)
+		return;
+
+	count = libusb_get_device_list(usb_ctx, &list);
+	if (count < 0)
+		return;
 
       	//printf("bus/device  idVendor/idProduct\n");
-	for (bus = usb_busses; bus; bus = bus->next) {
-		for (dev = bus->devices; dev; dev = dev->next) {
-			//printf("%s/%s     %04X/%04X\n", bus->dirname, dev->filename,
-			//		dev->descriptor.idVendor, dev->descriptor.idProduct);
-			if (dev->descriptor.idVendor == 0x04FA &&
-					dev->descriptor.idProduct == 0x2490) {
-                ++usb_num_devices;
-				usb_dev_list[usb_num_devices] = dev;
-
-				if( !(opts & OPT_QUIET) )
-  				    printf("Found DS2490 device #%d at %s/%s\n", usb_num_devices + 1,
-						    bus->dirname, dev->filename);
-			}
+	for (i = 0; i < count; i++) {
+		if (libusb_get_device_descriptor(list[i], &desc) < 0)
+			continue;
+		if (desc.idVendor == 0x04FA && desc.idProduct == 0x2490) {
+			if (usb_num_devices + 1 >= MAX_PORTNUM)
+				break;
+			++usb_num_devices;
+			usb_dev_list[usb_num_devices] = libusb_ref_device(list[i]);
+
+			if( !(opts & OPT_QUIET) )
+				printf("Found DS2490 device #%d at %03d/%03d\n", usb_num_devices + 1,
+						libusb_get_bus_number(list[i]),
+						libusb_get_device_address(list[i]));
 		}
 	}
 
-	initted_flag = 1;
+	libusb_free_device_list(list, 1);
+}
+
+//---------------------------------------------------------------------------
+// The device named by 'port_zstr', 'USB1' for the first DS2490 found and
+// so on.  'USB', or nothing, is the first one that isn't open yet.
+//
+// Returns: the index in usb_dev_list, -1 if there is no such device
+//
+static int usb_find_device(char *port_zstr)
+{
+	char *end;
+	int dev;
+
+	if ((*port_zstr == 0) || !strcasecmp(port_zstr, "USB")) {
+		for (dev = 0; dev <= usb_num_devices; dev++) {
+			if (!usb_dev_open[dev])
+				return dev;
+		}
+		return -1;
+	}
 
+	if (strncasecmp(port_zstr, "USB", 3))
+		return -1;
+	dev = strtol(&port_zstr[3], &end, 10) - 1;
+	if ((*end != 0) || (dev < 0) || (dev > usb_num_devices))
+		return -1;
+	return dev;
 }
 
 //---------------------------------------------------------------------------
@@ -86,68 +137,80 @@ void usb_ds2490_init(void)
 //
 // 'portnum'    - number 0 to MAX_PORTNUM-1.  This number is provided to
 //                indicate the symbolic port number.
-// 'port_zstr'  - zero terminated port name.  
+// 'port_zstr'  - zero terminated port name, USB, USB1, USB2...
 // 'return_msg' - zero terminated return message. 
 //
 // Returns: TRUE - success, port opened
 //
 SMALLINT owAcquire(int portnum, char *port_zstr, char *return_msg)
 {
+	libusb_device_handle *h;
+	int result, dev;
+
 	if (!initted_flag)
 		usb_ds2490_init();
 	
 	/* check the port string */
-	if (strcmp (port_zstr, "USB")) {
-		strcpy(return_msg, "owAcquire called with invalid port string\n");
-	      	return 0;
-	}
-	
-	/* check to see if the portnumber is valid */
-	if (usb_num_devices < portnum) {
-		strcpy(return_msg, "Attempted to select invalid port number\n");
-		return FALSE;
+	if ((dev = usb_find_device(port_zstr)) < 0) {
+		strcpy(return_msg, "No DS2490 device for that port\n");
+	      	return FALSE;
 	}
 
 	/* check to see if opening the device is valid */
-	if (usb_dev_handle_list[portnum] != NULL) {
+	if ((usb_dev_handle_list[portnum] != NULL) || usb_dev_open[dev]) {
 		strcpy(return_msg, "Device allready open\n");
 		return FALSE;
 	}
 
 	/* open the device */
-	usb_dev_handle_list[portnum] = usb_open(usb_dev_list[portnum]);
-	if (usb_dev_handle_list[portnum] == NULL) {
+	result = libusb_open(usb_dev_list[dev], &h);
+	if (result < 0) {
 		strcpy(return_msg, "Failed to open usb device\n");
-		printf("%s\n", usb_strerror());
+		printf("%s\n", libusb_error_name(result));
 		return FALSE;
 	}
 
 	/* set the configuration */
-	if (usb_set_configuration(usb_dev_handle_list[portnum], 1)) {
+	result = libusb_set_configuration(h, 1);
+	if (result < 0) {
 		strcpy(return_msg, "Failed to set configuration\n");
-		printf("%s\n", usb_strerror());
-		usb_close(usb_dev_handle_list[portnum]);
+		printf("%s\n", libusb_error_name(result));
+		libusb_close(h);
 		return FALSE;
 	}
 
 	/* claim the interface */
-	if (usb_claim_interface(usb_dev_handle_list[portnum], 0)) {
+	result = libusb_claim_interface(h, 0);
+	if (result < 0) {
 		strcpy(return_msg, "Failed to claim interface\n");
-		printf("%s\n", usb_strerror());
-		usb_close(usb_dev_handle_list[portnum]);
+		printf("%s\n", libusb_error_name(result));
+		libusb_close(h);
 		return FALSE;
 	}
 
 	/* set the alt interface */
-	if (usb_set_altinterface(usb_dev_handle_list[portnum], 3)) {
+	result = libusb_set_interface_alt_setting(h, 0, 3);
+	if (result < 0) {
 		strcpy(return_msg, "Failed to set altinterface\n");
-		printf("%s\n", usb_strerror());
-		usb_release_interface(usb_dev_handle_list[portnum], 0);
-		usb_close(usb_dev_handle_list[portnum]);
+		printf("%s\n", libusb_error_name(result));
+		libusb_release_interface(h, 0);
+		libusb_close(h);
+		return FALSE;
+	}
+
+	/* keep a status transfer queued */
+	usb_dev_handle_list[portnum] = h;
+	if (!ds2490_status_start(portnum)) {
+		strcpy(return_msg, "Failed to start the status transfer\n");
+		libusb_release_interface(h, 0);
+		libusb_close(h);
+		usb_dev_handle_list[portnum] = NULL;
 		return FALSE;
 	}
 
 	/* we're all set here! */
+	usb_port_dev[portnum] = dev;
+	usb_dev_open[dev] = TRUE;
 	strcpy(return_msg, "DS2490 successfully acquired by USB driver\n");
 	return TRUE;
 }
@@ -161,10 +224,12 @@ SMALLINT owAcquire(int portnum, char *port_zstr, char *return_msg)
 //
 void owRelease(int portnum, char *return_msg)
 {
-	usb_release_interface(usb_dev_handle_list[portnum], 0);
-	usb_close(usb_dev_handle_list[portnum]);
+	ds2490_status_stop(portnum);
+	libusb_release_interface(usb_dev_handle_list[portnum], 0);
+	libusb_close(usb_dev_handle_list[portnum]);
 	usb_dev_handle_list[portnum] = NULL;
+	if (usb_port_dev[portnum] >= 0)
+		usb_dev_open[usb_port_dev[portnum]] = FALSE;
+	usb_port_dev[portnum] = -1;
 	strcpy(return_msg, "DS2490 successfully released by USB driver\n");
 }
-
-
@@ -26,6 +26,16 @@
  * SUCH DAMAGE.
  * 
  * 
+ * linuxlnk.c (0.22)
+ *
+ *   * The reset and data settings of the serial port are made once, in
+ *     owLinkInit(), and tcsetattr() is only called when the line has to
+ *     change from one to the other. The input is only flushed after a
+ *     transfer timed out.
+ *
+ *   * owTouchBlock() expands bytes to bits with a 256 entry table, and
+ *     reads back each UART_FIFO_SIZE chunk with one read().
+ * 
  * linuxlnk.c (0.21)
  * 
  *   * Fixed strong pullup return codes so that it doesn't make higer level
@@ -66,6 +76,7 @@
 #include <termios.h>
 #include <sys/time.h>
 #include <time.h>
+#include <string.h>
 
 #ifdef LINUX
 #include <linux/serial.h>
@@ -87,6 +98,32 @@
 #define UART_FIFO_SIZE 160
 
 #define TIMEOUT 5
+
+/* The settings the serial port switches between. A 0xF0 byte at 9600 baud
+ * is the reset pulse, and at 115200 baud each byte is one bit. The data
+ * bits are 8 for both, what the line always ended up with after the first
+ * reset. */
+#define LINE_UNKNOWN 0
+#define LINE_RESET   1
+#define LINE_DATA    2
+
+static struct termios term_reset[MAX_PORTNUM];
+static struct termios term_data[MAX_PORTNUM];
+static int line_mode[MAX_PORTNUM];
+static int line_dirty[MAX_PORTNUM];   /* input may have stale bytes */
+
+/* The bytes sent for each bit of a byte, least significant bit first */
+#define BIT(b,n)  ((((b) >> (n)) & 0x01) ? 0xFF : 0x00)
+#define EXP1(b)   { BIT(b,0), BIT(b,1), BIT(b,2), BIT(b,3), \
+                    BIT(b,4), BIT(b,5), BIT(b,6), BIT(b,7) }
+#define EXP4(b)   EXP1(b), EXP1((b)+1), EXP1((b)+2), EXP1((b)+3)
+#define EXP16(b)  EXP4(b), EXP4((b)+4), EXP4((b)+8), EXP4((b)+12)
+#define EXP64(b)  EXP16(b), EXP16((b)+16), EXP16((b)+32), EXP16((b)+48)
+
+static const unsigned char expand_bits[256][8] = {
+   EXP64(0), EXP64(64), EXP64(128), EXP64(192)
+};
+
 /* exportable link-level functions */
 SMALLINT owTouchReset(int);
 SMALLINT owTouchBit(int,SMALLINT);
@@ -103,8 +140,66 @@ SMALLINT hasOverDrive(int);
 SMALLINT hasProgramPulse(int);
 SMALLINT owWriteBytePower(int,SMALLINT);
 SMALLINT owReadBitPower(int, SMALLINT);
+void owLinkInit(int);
 
 extern int fd[MAX_PORTNUM];
+extern struct termios term[MAX_PORTNUM];
+
+
+/* Make the reset and data settings from the ones owAcquire() set up on
+ * 'portnum'. The line is in neither of them yet. */
+void owLinkInit(int portnum)
+{
+   term_reset[portnum] = term[portnum];
+   term_reset[portnum].c_cflag = (term_reset[portnum].c_cflag & ~CSIZE) | CS8;
+   cfsetispeed(&term_reset[portnum], B9600);
+   cfsetospeed(&term_reset[portnum], B9600);
+
+   /* the reset reads back one byte */
+   term_reset[portnum].c_cc[VMIN] = 1;
+   term_reset[portnum].c_cc[VTIME] = 0;
+
+   term_data[portnum] = term_reset[portnum];
+   cfsetispeed(&term_data[portnum], B115200);
+   cfsetospeed(&term_data[portnum], B115200);
+
+   /* a read waits for all of a chunk, or 0.1s after the last byte */
+   term_data[portnum].c_cc[VMIN] = UART_FIFO_SIZE;
+   term_data[portnum].c_cc[VTIME] = 1;
+
+   line_mode[portnum] = LINE_UNKNOWN;
+   line_dirty[portnum] = FALSE;
+}
+
+/* Switch the line to 'mode' unless it is already there. Returns FALSE if
+ * tcsetattr failed. */
+static int set_line(int portnum, int mode)
+{
+   if (line_mode[portnum] == mode)
+     return TRUE;
+
+   if (tcsetattr(fd[portnum], TCSANOW, (mode == LINE_RESET) ?
+		 &term_reset[portnum] : &term_data[portnum]) < 0)
+     {
+	OWERROR(OWERROR_SYSTEM_RESOURCE_INIT_FAILED);
+	perror("set_line: Error with tcsetattr");
+	line_mode[portnum] = LINE_UNKNOWN;
+	return FALSE;
+     }
+
+   line_mode[portnum] = mode;
+   return TRUE;
+}
+
+/* Throw away what is left of a transfer that timed out */
+static void flush_line(int portnum)
+{
+   if (line_dirty[portnum])
+     {
+	tcflush(fd[portnum], TCIOFLUSH);
+	line_dirty[portnum] = FALSE;
+     }
+}
 
 /* Reset all of the devices on the 1-Wire Net and return the result. Returns
  * TRUE if presense pulse(s) was detected and devices(s) reset, otherwise
@@ -117,26 +212,12 @@ SMALLINT owTouchReset(int portnum)
    int stat = 0;
    unsigned char wbuff;
    unsigned char result = 0;
-   //extern int global_msec, global_msec_max;
-   extern struct termios term[MAX_PORTNUM];
 
-   /* Flush the input and output buffers */
-   tcflush(fd[portnum], TCIOFLUSH);
-   
-   /* 8 data bits */
-   term[portnum].c_cflag |= CS8; 
-   
-   /* Set input and output speed to 9.6k */
-   cfsetispeed(&term[portnum], B9600);
-   cfsetospeed(&term[portnum], B9600);
-   
-   if(tcsetattr(fd[portnum], TCSANOW, &term[portnum]) < 0 )
-     {
-	OWERROR(OWERROR_SYSTEM_RESOURCE_INIT_FAILED);
-	perror("owTouchReset: Error with tcsetattr 1");
-	close(fd[portnum]);
-	return FALSE;
-     }
+   /* 9.6k, 8 data bits, unless the last thing done was a reset too */
+   if (!set_line(portnum, LINE_RESET))
+     return FALSE;
+
+   flush_line(portnum);
    
    /* Send the reset pulse */
    wbuff = 0xF0;
@@ -177,76 +258,62 @@ SMALLINT owTouchReset(int portnum)
 	  }
      } else {
 	/* Timed out*/
+	line_dirty[portnum] = TRUE;
 	stat = FALSE;
      }
-   
-  
-   /* Set input and output speed to 115.2k */
-   cfsetispeed(&term[portnum], B115200);
-   cfsetospeed(&term[portnum], B115200);
-   
-   /* set to 6 data bits */
-   term[portnum].c_cflag |= CS6; 
-
-   if (tcsetattr(fd[portnum], TCSANOW, &term[portnum] ) < 0 )
-     {
-	OWERROR(OWERROR_SYSTEM_RESOURCE_INIT_FAILED);
-	perror("Reset: Error with tcsetattr 2");
-	close(fd[portnum]);
-	return FALSE;
-     }
 
+   /* The line stays at 9.6k until the next bit is sent */
    return stat;
 }
 
 
 
 
+/* Send 'nbits' bits from 'transfer_buf', least significant bit of each
+ * byte first, and replace them with the bits read back. A last partial
+ * byte keeps its bits in the low end. */
 void owTouchBlock( int portnum, int timeout, int nbits, uchar *transfer_buf)
 {
    fd_set readset;
-   char *buf;
+   unsigned char buf[UART_FIFO_SIZE];
    struct timeval timeout_tv;
 
-   unsigned char inch = 0;
-   unsigned int i;
-   unsigned int bit_counter = 0;
-   unsigned int nretrieved_bits;
-   unsigned int nread_bits;
-   
-   int nbits2;
+   unsigned char inch;
+   int i, n, got, ret;
+   int bit = 0;
 
    if (nbits == 0)
      return;
 
-   /* Allocate 'nbits' number of bytes for buf */
-   /* alloca() should be faster then malloc but ... */
-   buf = alloca(nbits);
-   if (buf == NULL) {
-      fprintf(stderr, "owTouchBlock: Could not allocate %d bytes of memory.\n", nbits);
-      return;
-   }
+   /* 115.2k, one byte for each bit */
+   if (!set_line(portnum, LINE_DATA))
+     return;
 
-   /* Flush the input and output buffers */
-   tcflush(fd[portnum], TCIOFLUSH);
-   
-   /* Construct string of bytes representing bits to be sent */
-   for (i = 0; i < nbits; i++)
-     buf[i] = (transfer_buf[i/8] & (1 << (i & 0x7))) ? 0xFF : 0x00;
+   flush_line(portnum);
    
-   /* send and receive blocks of UART_FIFO_SIZE or less */
-   while (nbits != 0) {
-      /* Make sure we don't send buffers bigger then UART_FIFO_SIZE */
-      nbits2 = (nbits < UART_FIFO_SIZE) ? nbits : UART_FIFO_SIZE;
-      nbits -= nbits2;
-      
-      /* write nbits2 bits of buffer to network */
-      write(fd[portnum], buf, nbits2);
+   /* send and receive chunks of UART_FIFO_SIZE or less, a whole number of
+    * bytes each but the last */
+   while (bit < nbits) {
+      n = ((nbits - bit) < UART_FIFO_SIZE) ? (nbits - bit) : UART_FIFO_SIZE;
       
-      /* read N bytes (bits) paired with above write */
-      nretrieved_bits = 0;
+      /* the bytes representing the bits to be sent */
+      for (i = 0; i + 8 <= n; i += 8)
+	memcpy(&buf[i], expand_bits[transfer_buf[(bit + i) / 8]], 8);
+      for (; i < n; i++)
+	buf[i] = expand_bits[transfer_buf[(bit + i) / 8]][i & 0x07];
+
+      /* write them to the network */
+      for (got = 0; got < n; got += ret) {
+	 ret = write(fd[portnum], &buf[got], n - got);
+	 if (ret <= 0) {
+	    line_dirty[portnum] = TRUE;
+	    return;
+	 }
+      }
 
-      while (nretrieved_bits < nbits2) {
+      /* read the bits paired with above write, VMIN lets one read() wait
+       * for all of them */
+      for (got = 0; got < n; got += ret) {
 	 /* Initialize readset */
 	 FD_ZERO(&readset);
 	 FD_SET(fd[portnum], &readset);
@@ -256,46 +323,37 @@ void owTouchBlock( int portnum, int timeout, int nbits, uchar *transfer_buf)
 	 timeout_tv.tv_sec = timeout;
 	 
 	 /* Read bytes if it doesn't timeout first */
-	 if (select(fd[portnum]+1, &readset, NULL, NULL, &timeout_tv) > 0)
-	   {
-	      /* Is there something to read? */
-	      if (FD_ISSET(fd[portnum], &readset)) {
-		 /* read it into buf */
-		 nread_bits = read(fd[portnum], buf, nbits2 - nretrieved_bits);
-		 
-		 /* loop over the buffer and extract the least significant bits
-		  * and put it in inch */
-		 for (i = 0; i < nread_bits; i++) {
-		    inch >>= 1;
-		    /* mask bit 1 of buf, if bit is a '1' set bit 8 of inch,
-		     * if bit is a '0' leave bit 8 of inch unset */
-		    inch |= (buf[i] & 0x01) ? 0x80 : 0x00;
-		    nretrieved_bits++;
-		    bit_counter++;
-		    
-		    if ((bit_counter % 8) == 0) {
-		       /* we have a full byte */
-		       *transfer_buf = inch;
-		       transfer_buf++;
-		       inch = 0;
-		    }
-		 }
-	      } else {
-		 /* Wicked?, some signal or something */
-		 printf("b0rked\n");
-		 return;
-	      }
-	   } else {
-	      /* Timed out */
-	      return;
-	   }
+	 if (select(fd[portnum]+1, &readset, NULL, NULL, &timeout_tv) <= 0) {
+	    /* Timed out */
+	    line_dirty[portnum] = TRUE;
+	    return;
+	 }
+
+	 ret = read(fd[portnum], &buf[got], n - got);
+	 if (ret <= 0) {
+	    /* Wicked?, some signal or something */
+	    printf("b0rked\n");
+	    line_dirty[portnum] = TRUE;
+	    return;
+	 }
+      }
+
+      /* the least significant bit of each byte read is the bit */
+      for (i = 0; i + 8 <= n; i += 8)
+	transfer_buf[(bit + i) / 8] =
+	  (buf[i] & 0x01) | ((buf[i+1] & 0x01) << 1) |
+	  ((buf[i+2] & 0x01) << 2) | ((buf[i+3] & 0x01) << 3) |
+	  ((buf[i+4] & 0x01) << 4) | ((buf[i+5] & 0x01) << 5) |
+	  ((buf[i+6] & 0x01) << 6) | ((buf[i+7] & 0x01) << 7);
+      if (i < n) {
+	 /* this is not a full byte */
+	 for (inch = 0; i < n; i++)
+	   inch |= (buf[i] & 0x01) << (i & 0x07);
+	 transfer_buf[(bit + i - 1) / 8] = inch;
       }
-      buf += nbits2;
+
+      bit += n;
    }
-   
-   if ((bit_counter % 8) != 0)
-     /* this is not a full byte */
-     *transfer_buf = inch;
 }
 
 
@@ -329,8 +387,11 @@ SMALLINT owTouchBit(int portnum, SMALLINT sbit)
    fd_set readset;
    struct timeval tv;
 
-   /* Flush the input and output buffers */
-   tcflush( fd[portnum], TCIOFLUSH );
+   /* 115.2k, one byte for each bit */
+   if (!set_line(portnum, LINE_DATA))
+     return 0xFF;
+
+   flush_line(portnum);
    
    /* Get the bit ready to be sent */
    sendbit = (sbit & 0x01) ? 0xFF : 0x00;
@@ -362,6 +423,7 @@ SMALLINT owTouchBit(int portnum, SMALLINT sbit)
 	       }
 	     
 	  } else {
+	     line_dirty[portnum] = TRUE;
 	     return 0xFF;
 	  }  
  
@@ -26,6 +26,10 @@
  * SUCH DAMAGE.
  * 
  * 
+ * linuxses.c (0.21)
+ *
+ *   * owAcquire() has the link layer set up its reset and data settings.
+ *
  * linuxses.c (0.20)
  * 
  *   * Cleaned up everything.
@@ -45,6 +49,9 @@
 SMALLINT owAcquire(int,char *);
 void     owRelease(int);
 
+/* from linuxlnk.c */
+void     owLinkInit(int);
+
 
 int fd[MAX_PORTNUM]; /* a list of filedescriptors for serial ports */
 struct termios term[MAX_PORTNUM]; /* Current termios settings */
@@ -111,6 +118,9 @@ SMALLINT owAcquire(int portnum, char *port_zstr)
       
    /* Flush the input and output buffers */
    tcflush(fd[portnum], TCIOFLUSH);
+
+   /* Settings for the reset pulse and for the data */
+   owLinkInit(portnum);
    
    return TRUE;
 }
@@ -35,16 +35,26 @@
 //           1.03 -> 2.00  Changed 'MLan' to 'ow'. Added support for
 //                         multiple ports.
 //           2.00 -> 2.01  Added support for owError library
+//           2.01 -> 2.02  owNext sends the search in owTouchBlock
+//                         transfers, one per triplet and one for all of
+//                         the directions known from the last search
 //
 
 #include <stdio.h>
+#include <string.h>
 
 #include <ownet.h>
 #include <owproto.h>
 
+// external functions defined in the link layer, linuxlnk.c or simlnk.c
+extern void owTouchBlock(int,int,int,uchar *);
+
 // exportable functions defined in ownet.c
 SMALLINT bitacc(SMALLINT,SMALLINT,SMALLINT,uchar *);
 
+// local functions
+static int owSearchROM(int,SMALLINT,int,uchar *);
+
 // global variables for this module to hold search state information
 static SMALLINT LastDiscrepancy[MAX_PORTNUM];
 static SMALLINT LastFamilyDiscrepancy[MAX_PORTNUM];
@@ -105,18 +115,8 @@ SMALLINT owFirst(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
 //
 SMALLINT owNext(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
 {
-   uchar bit_test, search_direction, bit_number;
-   uchar last_zero, serial_byte_number, next_result;
-   uchar serial_byte_mask;
-   uchar lastcrc8=0;
-
-   // initialize for search
-   bit_number = 1;
-   last_zero = 0;
-   serial_byte_number = 0;
-   serial_byte_mask = 1;
-   next_result = 0;
-   setcrc8(portnum,0);
+   uchar last_zero = 0, next_result = 0;
+   int result;
 
    // if the last call was not the last one
    if (!LastDevice[portnum])
@@ -128,7 +128,6 @@ SMALLINT owNext(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
          // if there are no parts on 1-wire, return FALSE
          if (!owTouchReset(portnum))
          {
-            // printf("owTouchReset failed\r\n");
             // reset the search
             LastDiscrepancy[portnum] = 0;
             LastFamilyDiscrepancy[portnum] = 0;
@@ -137,78 +136,18 @@ SMALLINT owNext(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
          }
       }
 
-      // If finding alarming devices issue a different command
-      if (alarm_only)
-         owWriteByte(portnum,0xEC);  // issue the alarming search command
-      else
-         owWriteByte(portnum,0xF0);  // issue the search command
-
-      //pause before beginning the search
-      //usDelay(100);
+      // Send the directions up to the last discrepancy with the command.
+      // A wrong guess can only be searched again after a reset.
+      result = owSearchROM(portnum,alarm_only,
+                           do_reset ? LastDiscrepancy[portnum] : 0,&last_zero);
 
-      // loop to do the search
-      do
-      {
-         // read a bit and its compliment
-         bit_test = owTouchBit(portnum,1) << 1;
-         bit_test |= owTouchBit(portnum,1);
-
-         // check for no devices on 1-wire
-         if (bit_test == 3)
-            break;
-         else
-         {
-            // all devices coupled have 0 or 1
-            if (bit_test > 0)
-              search_direction = !(bit_test & 0x01);  // bit write value for search
-            else
-            {
-               // if this discrepancy if before the Last Discrepancy
-               // on a previous next then pick the same as last time
-               if (bit_number < LastDiscrepancy[portnum])
-                  search_direction = ((SerialNum[portnum][serial_byte_number] & serial_byte_mask) > 0);
-               else
-                  // if equal to last pick 1, if not then pick 0
-                  search_direction = (bit_number == LastDiscrepancy[portnum]);
-
-               // if 0 was picked then record its position in LastZero
-               if (search_direction == 0)
-                  last_zero = bit_number;
-
-               // check for Last discrepancy in family
-               if (last_zero < 9)
-                  LastFamilyDiscrepancy[portnum] = last_zero;
-            }
-
-            // set or clear the bit in the SerialNum[portnum] byte serial_byte_number
-            // with mask serial_byte_mask
-            if (search_direction == 1)
-              SerialNum[portnum][serial_byte_number] |= serial_byte_mask;
-            else
-              SerialNum[portnum][serial_byte_number] &= ~serial_byte_mask;
-
-            // serial number search direction write bit
-            owTouchBit(portnum,search_direction);
-
-            // increment the byte counter bit_number
-            // and shift the mask serial_byte_mask
-            bit_number++;
-            serial_byte_mask <<= 1;
-
-            // if the mask is 0 then go to new SerialNum[portnum] byte serial_byte_number
-            // and reset mask
-            if (serial_byte_mask == 0)
-            {
-                lastcrc8 = docrc8(portnum,SerialNum[portnum][serial_byte_number]);  // accumulate the CRC
-                serial_byte_number++;
-                serial_byte_mask = 1;
-            }
-         }
-      }
-      while(serial_byte_number < 8);  // loop until through all SerialNum[portnum] bytes 0-7
+      // the devices changed since the last search, do it again a
+      // triplet at a time
+      if ((result < 0) && owTouchReset(portnum))
+         result = owSearchROM(portnum,alarm_only,0,&last_zero);
 
       // if the search was successful then
-      if (!((bit_number < 65) || lastcrc8))
+      if (result > 0)
       {
          // search successful so set LastDiscrepancy[portnum],LastDevice[portnum],next_result
          LastDiscrepancy[portnum] = last_zero;
@@ -230,6 +169,115 @@ SMALLINT owNext(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
    return next_result;
 }
 
+//--------------------------------------------------------------------------
+// Send the search command and go through the 64 bits of the search.
+// The command and the triplets (bit, complement, direction) of the first
+// 'known' bits go out in one owTouchBlock, with each direction taken as if
+// the bit was a discrepancy.  After them each owTouchBlock writes one
+// direction and reads the two bits of the next.
+//
+// 'portnum'    - number 0 to MAX_PORTNUM-1.  This number is provided to
+//                indicate the symbolic port number.
+// 'alarm_only' - TRUE (1) the find alarm command 0xEC is
+//                sent instead of the normal search command 0xF0
+// 'known'      - number of bits sent ahead, up to LastDiscrepancy[portnum]
+// 'last_zero'  - set to the last discrepancy where 0 was picked
+//
+// Returns:   1 : a device was found and its Serial Number placed in
+//                SerialNum[portnum]
+//            0 : no device answered, or its CRC8 was wrong
+//           -1 : a bit sent ahead was not a discrepancy and went the
+//                wrong way
+//
+static int owSearchROM(int portnum, SMALLINT alarm_only, int known, uchar *last_zero)
+{
+   uchar block[26];     // command, 64 triplets and the next two bits
+   uchar id_bit, cmp_bit, guess, search_direction;
+   uchar lastcrc8=0;
+   int bit_number, nbits, pos;
+
+   // pick 1 at the last discrepancy, before it the same as last time and
+   // after it 0
+#define GUESS(n) (((n) < LastDiscrepancy[portnum]) ? \
+                  bitacc(READ_FUNCTION,0,(n) - 1,&SerialNum[portnum][0]) : \
+                  ((n) == LastDiscrepancy[portnum]))
+
+   // If finding alarming devices issue a different command
+   memset(block,0,sizeof(block));
+   block[0] = alarm_only ? 0xEC : 0xF0;
+   nbits = 8;
+
+   // the triplets sent ahead, and the two bits after them
+   for (bit_number = 1; bit_number <= known; bit_number++)
+   {
+      bitacc(WRITE_FUNCTION,1,nbits++,block);
+      bitacc(WRITE_FUNCTION,1,nbits++,block);
+      bitacc(WRITE_FUNCTION,GUESS(bit_number),nbits++,block);
+   }
+   if (known < 64)
+   {
+      bitacc(WRITE_FUNCTION,1,nbits++,block);
+      bitacc(WRITE_FUNCTION,1,nbits++,block);
+   }
+   owTouchBlock(portnum,5,nbits,block);
+
+   *last_zero = 0;
+   setcrc8(portnum,0);
+   pos = 8;
+   for (bit_number = 1; bit_number <= 64; bit_number++)
+   {
+      // the bit and its compliment
+      id_bit = bitacc(READ_FUNCTION,0,pos,block);
+      cmp_bit = bitacc(READ_FUNCTION,0,pos + 1,block);
+
+      // check for no devices on 1-wire
+      if (id_bit && cmp_bit)
+         return 0;
+
+      guess = GUESS(bit_number);
+      if (id_bit != cmp_bit)
+         // all devices coupled have 0 or 1
+         search_direction = id_bit;
+      else
+      {
+         search_direction = guess;
+
+         // if 0 was picked then record its position in LastZero
+         if (search_direction == 0)
+            *last_zero = bit_number;
+
+         // check for Last discrepancy in family
+         if (*last_zero < 9)
+            LastFamilyDiscrepancy[portnum] = *last_zero;
+      }
+
+      if (bit_number <= known)
+      {
+         // the direction went out already
+         if (search_direction != guess)
+            return -1;
+         pos += 3;
+      }
+      else
+      {
+         // write the direction, and read the next bit and its compliment
+         block[0] = search_direction ? 0x07 : 0x06;
+         owTouchBlock(portnum,5,(bit_number < 64) ? 3 : 1,block);
+         pos = 1;
+      }
+
+      // set or clear the bit in the SerialNum[portnum]
+      bitacc(WRITE_FUNCTION,search_direction,bit_number - 1,&SerialNum[portnum][0]);
+
+      // accumulate the CRC of each byte
+      if ((bit_number % 8) == 0)
+         lastcrc8 = docrc8(portnum,SerialNum[portnum][(bit_number / 8) - 1]);
+   }
+#undef GUESS
+
+   return lastcrc8 ? 0 : 1;
+}
+
 //--------------------------------------------------------------------------
 // The 'owSerialNum' function either reads or sets the SerialNum buffer
 // that is used in the search functions 'owFirst' and 'owNext'.
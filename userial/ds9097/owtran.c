@@ -31,11 +31,16 @@
 //  History: 1.03 -> 2.00  Changed 'MLan' to 'ow'. Added support for
 //                         multiple ports.
 //           2.00 -> 2.01  Added support for owError library
+//           2.01 -> 2.02  Added owAccessBlock
+//           2.02 -> 2.03  owBlock sends the whole block with one
+//                         owTouchBlock
 //
 
 #include <ownet.h>
 #include <owproto.h>
 
+// external functions defined in the link layer, linuxlnk.c or simlnk.c
+extern void owTouchBlock(int,int,int,uchar *);
 
 //--------------------------------------------------------------------------
 // The 'owBlock' transfers a block of data to and from the
@@ -60,8 +65,6 @@
 //
 SMALLINT owBlock(int portnum, SMALLINT do_reset, uchar *tran_buf, SMALLINT tran_len)
 {
-   uchar i;
-
    // check for a block too big
    if (tran_len > 160)
    {
@@ -79,13 +82,48 @@ SMALLINT owBlock(int portnum, SMALLINT do_reset, uchar *tran_buf, SMALLINT tran_
       }
    }
 
-   // send and receive the buffer
-   for (i = 0; i < tran_len; i++)
-      tran_buf[i] = (uchar)owTouchByte(portnum,tran_buf[i]);
+   // send and receive the buffer, a bit for each byte to the UART
+   owTouchBlock(portnum,5,tran_len * 8,tran_buf);
 
    return TRUE;
 }
 
+//--------------------------------------------------------------------------
+// The 'owAccessBlock' resets the 1-Wire Net, selects the current device
+// with Match ROM and transfers a block of data to and from it.  The
+// result is returned in the same buffer.
+//
+// 'power'    - turn on the strong pullup after the last byte TRUE(1)
+//              or not FALSE(0)
+// 'tran_buf' - pointer to a block of unsigned
+//              chars of length 'tran_len' that will be sent
+//              to the 1-Wire Net
+// 'tran_len' - length in bytes to transfer
+// Supported devices: all
+//
+// Returns:   TRUE (1) : The device answered the reset and the Match ROM
+//                       echo was correct.  With 'power' the strong
+//                       pullup is now on.
+//            FALSE (0): The device could not be selected or the
+//                       transfer failed.
+//
+SMALLINT owAccessBlock(int portnum, SMALLINT power, uchar *tran_buf, SMALLINT tran_len)
+{
+   if (!owAccess(portnum))
+      return FALSE;
+
+   if (!power)
+      return owBlock(portnum,FALSE,tran_buf,tran_len);
+
+   // the last byte goes out with the strong pullup
+   if (tran_len < 1)
+      return FALSE;
+   if ((tran_len > 1) && !owBlock(portnum,FALSE,tran_buf,tran_len - 1))
+      return FALSE;
+
+   return owWriteBytePower(portnum,tran_buf[tran_len - 1]);
+}
+
 //--------------------------------------------------------------------------
 // Write a byte to an EPROM 1-Wire device.
 //
@@ -48,6 +48,7 @@
 // external COM functions defined in system specific link file
 extern SMALLINT WriteCOM(int,int,uchar *);
 extern void     FlushCOM(int);
+extern void     DrainCOM(int);
 extern int      ReadCOM(int,int,uchar *);
 extern void     BreakCOM(int);
 extern void     SetBaudCOM(int,uchar);
@@ -118,6 +119,9 @@ SMALLINT DS2480Try( int portnum )
       return FALSE;
    }
 
+   // the timing byte has to be sent before the flush below
+   DrainCOM(portnum);
+
    // delay to let line settle
    msDelay(4);
 
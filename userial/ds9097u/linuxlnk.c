@@ -82,6 +82,18 @@
 //                         return values to OpenCOM.  Replace 'makeraw' call.
 //                         Should now be POSIX.
 //           2.00 -> 2.01  Added support for owError library.
+//           2.01 -> 2.02  ReadCOM() reads everything that is available
+//                         each time poll() wakes up, with one deadline
+//                         for the whole transfer. Count the system calls
+//                         for DigiTemp's --bench.
+//           2.02 -> 2.03  The ReadCOM() deadline comes from a per-port
+//                         estimate of the adapter's response time.
+//           2.03 -> 2.04  WriteCOM() no longer waits for the output to
+//                         drain, ReadCOM() collects the response while
+//                         the command is still going out.
+//           2.04 -> 2.05  Saved termios settings and the --bench counters
+//                         are kept per port, so several ports can be used
+//                         from different threads.
 //
 
 #include <unistd.h>
@@ -94,6 +106,7 @@
 #include <errno.h>
 #include <sys/time.h>
 #include <sys/file.h>
+#include <poll.h>
 
 #include "ds2480.h"
 #include "ownet.h"
@@ -103,15 +116,51 @@ SMALLINT  OpenCOM(int, char*);
 SMALLINT  WriteCOM(int, int, uchar*);
 void      CloseCOM(int);
 void      FlushCOM(int);
+void      DrainCOM(int);
 int       ReadCOM(int, int, uchar*);
 void      BreakCOM(int);
 void      SetBaudCOM(int, uchar);
 void      msDelay(int);
 long      msGettick(void);
+long      ReadCOMTimeout(int);
+double    ReadCOMResponse(int);
+void      ReadCOMStats(long*, long*, double*, double*);
+
+// ReadCOM() deadline limits in ms. Until a port has been measured it
+// waits READCOM_MAX_MS, and each byte after the first gets
+// READCOM_BYTE_MS more, as does each byte WriteCOM() queued that may
+// still be going out.
+#define READCOM_MIN_MS    50
+#define READCOM_MAX_MS    1000
+#define READCOM_BYTE_MS   2
+
+// Time to the first byte of a response, per port, in uS. Smoothed like
+// the TCP retransmit timer (RFC 6298): the deadline is the average plus
+// 4 times the mean deviation, and it doubles after each timeout.
+static struct {
+   double srtt;                   // smoothed response time
+   double rttvar;                 // its mean deviation
+   int    samples;                // responses measured
+   int    backoff;                // timeouts since the last response
+} rtt[MAX_PORTNUM];
+
+// Bytes written since the last ReadCOM(), per port
+static int tx_pending[MAX_PORTNUM];
 
 // LinuxLNK global
 int fd[MAX_PORTNUM];
-struct termios origterm;
+struct termios origterm[MAX_PORTNUM];
+
+// Counters for DigiTemp's --bench, per port
+static struct {
+   long   syscalls;               // System calls on the port and in msDelay
+   long   writes;                 // Packets written to the DS2480
+   double wait_us;                // Time spent waiting for the DS2480
+   double delay_us;               // Time spent in msDelay
+} com_stats[MAX_PORTNUM];
+
+// Port the calling thread last used, msDelay() counts against it
+static __thread int com_port = 0;
 
 //---------------------------------------------------------------------------
 // Attempt to open a com port.
@@ -164,7 +213,7 @@ SMALLINT OpenCOM(int portnum, char *port_zstr)
    // Get terminal parameters. (2.00) removed raw
    tcgetattr(fd[portnum],&t);
    // Save original settings.
-   origterm = t;
+   origterm[portnum] = t;
 
    // Set to non-canonical mode, and no RTS/CTS handshaking
    t.c_iflag &= ~(BRKINT|ICRNL|IGNCR|INLCR|INPCK|ISTRIP|IXON|IXOFF|PARMRK);
@@ -202,15 +251,20 @@ SMALLINT OpenCOM(int portnum, char *port_zstr)
 void CloseCOM(int portnum)
 {
    // restore tty settings
-   tcsetattr(fd[portnum], TCSAFLUSH, &origterm);
+   tcsetattr(fd[portnum], TCSAFLUSH, &origterm[portnum]);
    FlushCOM(portnum);
    close(fd[portnum]);
 }
 
 
 //--------------------------------------------------------------------------
-// Write an array of bytes to the COM port, verify that it was
-// sent out.  Assume that baud rate has been set.
+// Write an array of bytes to the COM port.  Assume that baud rate has
+// been set.
+//
+// The bytes are only queued, WriteCOM() doesn't wait for them to go out
+// with tcdrain().  The adapter starts answering before the whole command
+// has been sent, so the caller goes straight to ReadCOM() and the two
+// overlap.  Only waits if the output buffer is full.
 //
 // 'portnum'   - number 0 to MAX_PORTNUM-1.  This number provided will
 //               be used to indicate the port number desired when calling
@@ -219,77 +273,186 @@ void CloseCOM(int portnum)
 //
 SMALLINT WriteCOM(int portnum, int outlen, uchar *outbuf)
 {
-   long count = outlen;
-   int i = write(fd[portnum], outbuf, outlen);
+   struct pollfd pfd;
+   int           cnt = 0,
+                 n;
 
-   tcdrain(fd[portnum]);
-   return (i == count);
+   com_port = portnum;
+   pfd.fd = fd[portnum];
+   pfd.events = POLLOUT;
+
+   while (cnt < outlen)
+   {
+      n = write(fd[portnum], &outbuf[cnt], outlen - cnt);
+      com_stats[portnum].syscalls++;
+      if (n > 0)
+      {
+         cnt += n;
+         continue;
+      }
+      if ((n < 0) && (errno != EAGAIN) && (errno != EINTR))
+         break;
+
+      // the port is non-blocking, wait for room in the output buffer
+      n = poll(&pfd, 1, READCOM_MAX_MS);
+      com_stats[portnum].syscalls++;
+      if ((n == 0) || ((n < 0) && (errno != EINTR)))
+         break;
+   }
+
+   tx_pending[portnum] += cnt;
+   com_stats[portnum].writes++;
+   return (cnt == outlen);
+}
+
+
+//--------------------------------------------------------------------------
+// Feed the time it took for the first byte of a response to arrive into
+// the estimate for the port.
+//
+static void ReadCOMSample(int portnum, double us)
+{
+   double err;
+
+   if (rtt[portnum].samples++ == 0)
+   {
+      rtt[portnum].srtt = us;
+      rtt[portnum].rttvar = us / 2;
+   }
+   else
+   {
+      err = us - rtt[portnum].srtt;
+      rtt[portnum].srtt += err / 8;
+      rtt[portnum].rttvar += ((err < 0 ? -err : err) - rtt[portnum].rttvar) / 4;
+   }
+   rtt[portnum].backoff = 0;
 }
 
+//--------------------------------------------------------------------------
+// How long ReadCOM() waits for the first byte of a response, in ms
+//
+// 'portnum'  - number 0 to MAX_PORTNUM-1.  This number was provided to
+//              OpenCOM to indicate the port number.
+//
+long ReadCOMTimeout(int portnum)
+{
+   long msec;
+
+   if (rtt[portnum].samples == 0)
+      return READCOM_MAX_MS;
+
+   msec = (long)((rtt[portnum].srtt + 4 * rtt[portnum].rttvar) / 1000) + 1;
+   msec <<= (rtt[portnum].backoff < 8) ? rtt[portnum].backoff : 8;
+
+   if (msec < READCOM_MIN_MS)
+      msec = READCOM_MIN_MS;
+   if (msec > READCOM_MAX_MS)
+      msec = READCOM_MAX_MS;
+   return msec;
+}
 
 //--------------------------------------------------------------------------
-// Read an array of bytes to the COM port, verify that it was
-// sent out.  Assume that baud rate has been set.
+// The smoothed time to the first byte of a response in uS, 0 if nothing
+// has been measured yet
 //
 // 'portnum'  - number 0 to MAX_PORTNUM-1.  This number was provided to
 //              OpenCOM to indicate the port number.
-// 'outlen'   - number of bytes to write to COM port
-// 'outbuf'   - pointer ot an array of bytes to write
+//
+double ReadCOMResponse(int portnum)
+{
+   return rtt[portnum].srtt;
+}
+
+//--------------------------------------------------------------------------
+// Read an array of bytes from the COM port.  Assume that baud rate has
+// been set.
+//
+// Waits with poll() and then reads everything that has arrived, so a
+// response usually takes one or two wakeups instead of one per byte.
+// The whole transfer has one deadline, from ReadCOMTimeout() plus
+// READCOM_BYTE_MS for each byte after the first and for each byte of
+// the command that WriteCOM() may still be sending.
+//
+// 'portnum'  - number 0 to MAX_PORTNUM-1.  This number was provided to
+//              OpenCOM to indicate the port number.
+// 'inlen'    - number of bytes to read from the COM port
+// 'inbuf'    - pointer to an array of bytes to read into
 //
 // Returns:  Number of bytes actually read
 //
 int ReadCOM(int portnum, int inlen, uchar *inbuf)
 {
-   fd_set         filedescr;
-   struct timeval tval;
-   int            cnt;
-   int            sel;
-   int            msec = 0;
-   extern int     global_msec,
-                  global_msec_max;
+   struct pollfd   pfd;
+   struct timespec start, now;
+   long            timeout,
+                   msec;
+   int             cnt = 0,
+                   n;
+
+   com_port = portnum;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   timeout = ReadCOMTimeout(portnum) +
+             (inlen - 1 + tx_pending[portnum]) * READCOM_BYTE_MS;
+   tx_pending[portnum] = 0;
+
+   pfd.fd = fd[portnum];
+   pfd.events = POLLIN;
+
+   while (cnt < inlen)
+   {
+      // time left until the deadline, rounded up
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      msec = timeout - ((now.tv_sec - start.tv_sec) * 1000 +
+                        (now.tv_nsec - start.tv_nsec) / 1000000);
+      if (msec <= 0)
+         break;
+
+      n = poll(&pfd, 1, msec);
+      com_stats[portnum].syscalls++;
+      if (n < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         break;
+      }
+      if (n == 0)
+         break;         // timed out
 
+      if (pfd.revents & (POLLERR|POLLHUP|POLLNVAL))
+         break;
 
-   // loop to wait until each byte is available and read it
-   for (cnt = 0; cnt < inlen; cnt++)
-   {
-      if( msec < global_msec )
-         msec = global_msec;
-
-      // set a descriptor to wait for a character available
-      FD_ZERO(&filedescr);
-      FD_SET(fd[portnum],&filedescr);
-      // set initial timeout to global_msec ms
-      tval.tv_sec = 1;
-      tval.tv_usec = 1000 * msec;
-
-      // if byte available read or return bytes read
-      sel = select(fd[portnum]+1,&filedescr,NULL,NULL,&tval);
-      if ( sel > 0 )
+      // the port is non-blocking, take whatever is there
+      n = read(fd[portnum], &inbuf[cnt], inlen - cnt);
+      com_stats[portnum].syscalls++;
+      if (n > 0)
       {
-         if (read(fd[portnum],&inbuf[cnt],1) != 1)
+         if (cnt == 0)
          {
-            /* Received something, return it */
-            return cnt;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            ReadCOMSample(portnum, (now.tv_sec - start.tv_sec) * 1000000.0 +
+                                   (now.tv_nsec - start.tv_nsec) / 1000.0);
          }
-      } else if( sel == 0 ) {
-         /* We timed out waiting for a character, so increase the limit */
-         global_msec++;
-         cnt = -1;
+         cnt += n;
+      }
+      else if ((n < 0) && (errno != EAGAIN) && (errno != EINTR))
+         break;
+   }
+
+   // nothing came back, wait longer next time
+   if (cnt == 0)
+      rtt[portnum].backoff++;
 
 #ifdef DEBUG_USERIAL
-         fprintf(stderr, "Increasing delay to %ld\n", global_msec * 1000 );
+   if (cnt < inlen)
+      fprintf(stderr, "ReadCOM: timed out with %d of %d bytes after %ld ms\n",
+              cnt, inlen, timeout);
 #endif /* DEBUG_USERIAL */
 
-         /* don't go too high, just return an error (0) */
-         if( global_msec > global_msec_max )
-           return 0;
-      } else {
-         return cnt;
-      } /* select if */
-   } /* count loop */
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   com_stats[portnum].wait_us += (now.tv_sec - start.tv_sec) * 1000000.0 +
+                  (now.tv_nsec - start.tv_nsec) / 1000.0;
 
-   // success, so return desired length
-   return inlen;
+   return cnt;
 }
 
 
@@ -303,6 +466,23 @@ int ReadCOM(int portnum, int inlen, uchar *inbuf)
 void FlushCOM(int portnum)
 {
    tcflush(fd[portnum], TCIOFLUSH);
+   tx_pending[portnum] = 0;
+   com_stats[portnum].syscalls++;
+}
+
+
+//--------------------------------------------------------------------------
+//  Description:
+//     Wait for the bytes WriteCOM() queued to be sent, so a FlushCOM()
+//     after it can't throw them away
+//
+// 'portnum'  - number 0 to MAX_PORTNUM-1.  This number was provided to
+//              OpenCOM to indicate the port number.
+//
+void DrainCOM(int portnum)
+{
+   tcdrain(fd[portnum]);
+   com_stats[portnum].syscalls++;
 }
 
 
@@ -391,7 +571,8 @@ long msGettick(void)
 
 //--------------------------------------------------------------------------
 //  Description:
-//     Delay for at least 'len' ms
+//     Delay for at least 'len' ms.  Counted against the port the calling
+//     thread last talked to.
 //
 void msDelay(int len)
 {
@@ -400,5 +581,26 @@ void msDelay(int len)
    s.tv_sec = len / 1000;
    s.tv_nsec = (len - (s.tv_sec * 1000)) * 1000000;
    nanosleep(&s, NULL);
+   com_stats[com_port].syscalls++;
+   com_stats[com_port].delay_us += len * 1000.0;
 }
 
+
+//--------------------------------------------------------------------------
+// Add up the counters of all the ports for DigiTemp's --bench and -v
+//
+void ReadCOMStats(long *syscalls, long *writes, double *wait_us,
+                  double *delay_us)
+{
+   int i;
+
+   *syscalls = *writes = 0;
+   *wait_us = *delay_us = 0;
+   for (i = 0; i < MAX_PORTNUM; i++)
+   {
+      *syscalls += com_stats[i].syscalls;
+      *writes += com_stats[i].writes;
+      *wait_us += com_stats[i].wait_us;
+      *delay_us += com_stats[i].delay_us;
+   }
+}
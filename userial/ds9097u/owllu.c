@@ -112,9 +112,6 @@ SMALLINT owTouchReset(int portnum)
    // construct the command
    sendpacket[sendlen++] = (uchar)(CMD_COMM | FUNCTSEL_RESET | USpeed[portnum]);
 
-   // flush the buffers
-   FlushCOM(portnum);
-
    // send the packet
    if (WriteCOM(portnum,sendlen,sendpacket))
    {
@@ -177,9 +174,6 @@ SMALLINT owTouchBit(int portnum, SMALLINT sendbit)
    sendpacket[sendlen] = (sendbit != 0) ? BITPOL_ONE : BITPOL_ZERO;
    sendpacket[sendlen++] |= CMD_COMM | FUNCTSEL_BIT | USpeed[portnum];
 
-   // flush the buffers
-   FlushCOM(portnum);
-
    // send the packet
    if (WriteCOM(portnum,sendlen,sendpacket))
    {
@@ -271,9 +265,6 @@ SMALLINT owTouchByte(int portnum, SMALLINT sendbyte)
    if (sendbyte ==(SMALLINT)MODE_COMMAND)
       sendpacket[sendlen++] = (uchar)sendbyte;
 
-   // flush the buffers
-   FlushCOM(portnum);
-
    // send the packet
    if (WriteCOM(portnum,sendlen,sendpacket))
    {
@@ -404,9 +395,6 @@ SMALLINT owLevel(int portnum, SMALLINT new_level)
          // stop pulse command
          sendpacket[sendlen++] = MODE_STOP_PULSE;
 
-         // flush the buffers
-         FlushCOM(portnum);
-
          // send the packet
          if (WriteCOM(portnum,sendlen,sendpacket))
          {
@@ -458,9 +446,6 @@ SMALLINT owLevel(int portnum, SMALLINT new_level)
             sendpacket[sendlen++] = CMD_COMM | FUNCTSEL_CHMOD | SPEEDSEL_PULSE | BITPOL_12V;
          }
 
-         // flush the buffers
-         FlushCOM(portnum);
-
          // send the packet
          if (WriteCOM(portnum,sendlen,sendpacket))
          {
@@ -525,9 +510,6 @@ SMALLINT owProgramPulse(int portnum)
    // pulse command
    sendpacket[sendlen++] = CMD_COMM | FUNCTSEL_CHMOD | BITPOL_12V | SPEEDSEL_PULSE;
 
-   // flush the buffers
-   FlushCOM(portnum);
-
    // send the packet
    if (WriteCOM(portnum,sendlen,sendpacket))
    {
@@ -594,9 +576,6 @@ SMALLINT owWriteBytePower(int portnum, SMALLINT sendbyte)
       temp_byte >>= 1;
    }
 
-   // flush the buffers
-   FlushCOM(portnum);
-
    // send the packet
    if (WriteCOM(portnum,sendlen,sendpacket))
    {
@@ -668,8 +647,6 @@ SMALLINT owReadBitPower(int portnum, SMALLINT applyPowerResponse)
    sendpacket[sendlen++] = BITPOL_ONE 
                            | CMD_COMM | FUNCTSEL_BIT | USpeed[portnum] |
                            PRIME5V_TRUE;
-   // flush the buffers
-   FlushCOM(portnum);
 
    // send the packet
    if (WriteCOM(portnum,sendlen,sendpacket))
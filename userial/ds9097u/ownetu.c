@@ -234,9 +234,6 @@ SMALLINT owNext(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
    // search OFF
    sendpacket[sendlen++] = (uchar)(CMD_COMM | FUNCTSEL_SEARCHOFF | USpeed[portnum]);
 
-   // flush the buffers
-   FlushCOM(portnum);
-
    // send the packet
    if (WriteCOM(portnum,sendlen,sendpacket))
    {
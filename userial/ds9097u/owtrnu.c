@@ -37,6 +37,10 @@
 //                         handling plus the raw memory utilities.
 //           2.10 -> 3.00 Added memory bank functionality
 //                        Added file I/O operations
+//           3.00 -> 3.01 Added owAccessBlock, reset + Match ROM + data in
+//                        one packet to the DS2480
+//           3.01 -> 3.02 owBlock and owAccessBlock take up to 160 bytes
+//                        instead of 64
 //
 
 #include "ownet.h"
@@ -44,6 +48,7 @@
 
 // external functions defined in owllu.c
 extern SMALLINT owTouchReset(int);
+extern SMALLINT owLevel(int,SMALLINT);
 extern SMALLINT owWriteByte(int,SMALLINT);
 extern SMALLINT owReadByte(int);
 extern SMALLINT owProgramPulse(int);
@@ -59,6 +64,7 @@ extern void     FlushCOM(int);
 // external defined in ds2480ut.c
 extern SMALLINT DS2480Detect(int);
 extern SMALLINT UBaud[MAX_PORTNUM];
+extern SMALLINT ULevel[MAX_PORTNUM];
 extern SMALLINT UMode[MAX_PORTNUM];
 extern SMALLINT USpeed[MAX_PORTNUM];
 extern uchar SerialNum[MAX_PORTNUM][8];
@@ -71,6 +77,7 @@ extern uchar docrc8(int,uchar);
 
 // exportable functions defined in owtrnu.c
 SMALLINT owBlock(int,SMALLINT,uchar *,SMALLINT);
+SMALLINT owAccessBlock(int,SMALLINT,uchar *,SMALLINT);
 SMALLINT owReadPacketStd(int,SMALLINT,int,uchar *);
 SMALLINT owWritePacketStd(int,int,uchar *,SMALLINT,SMALLINT,SMALLINT);
 SMALLINT owProgramByte(int,SMALLINT,int,SMALLINT,SMALLINT,SMALLINT);
@@ -101,15 +108,16 @@ static SMALLINT Copy_Scratchpad(int,int,SMALLINT);
 //            FALSE (0): The reset did not return a valid prsence
 //                       (do_reset == TRUE).
 //
-//  The maximum tran_length is 64
+//  The maximum tran_length is 160, like the other adapters.  It goes out
+//  as one packet, with room for every byte to need doubling.
 //
 SMALLINT owBlock(int portnum, SMALLINT do_reset, uchar *tran_buf, SMALLINT tran_len)
 {
-   uchar sendpacket[150];
-   uchar sendlen=0,pos,i;
+   uchar sendpacket[2 * 160 + 1];
+   int sendlen=0,pos,i;
 
    // check for a block too big
-   if (tran_len > 64)
+   if (tran_len > 160)
    {
       OWERROR(OWERROR_BLOCK_TOO_BIG);
       return FALSE;
@@ -144,9 +152,6 @@ SMALLINT owBlock(int portnum, SMALLINT do_reset, uchar *tran_buf, SMALLINT tran_
          sendpacket[sendlen++] = tran_buf[i];
    }
 
-   // flush the buffers
-   FlushCOM(portnum);
-
    // send the packet
    if (WriteCOM(portnum,sendlen,sendpacket))
    {
@@ -165,6 +170,167 @@ SMALLINT owBlock(int portnum, SMALLINT do_reset, uchar *tran_buf, SMALLINT tran_
    return FALSE;
 }
 
+//--------------------------------------------------------------------------
+// The 'owAccessBlock' resets the 1-Wire Net, selects the current device
+// with Match ROM and transfers a block of data to and from it.  The
+// result is returned in the same buffer.
+//
+// Everything goes to the DS2480 in one packet: the reset in command
+// mode, then Match ROM and the data in data mode, and for 'power' the
+// last byte as 8 bit commands with the strong pullup primed, like
+// owWriteBytePower.  So a device read is one round trip instead of
+// owAccess, owBlock and maybe owWriteBytePower each waiting for theirs.
+//
+// 'portnum'  - number 0 to MAX_PORTNUM-1.  This number is provided to
+//              indicate the symbolic port number.
+// 'power'    - turn on the strong pullup after the last byte TRUE(1)
+//              or not FALSE(0)
+// 'tran_buf' - pointer to a block of unsigned
+//              chars of length 'tran_len' that will be sent
+//              to the 1-Wire Net
+// 'tran_len' - length in bytes to transfer
+//
+// Supported devices: all
+//
+// Returns:   TRUE (1) : The device answered the reset and the Match ROM
+//                       echo was correct.  With 'power' the strong
+//                       pullup is now on.
+//            FALSE (0): No presence, wrong echo or lost the DS2480
+//
+//  The maximum tran_length is 160
+//
+SMALLINT owAccessBlock(int portnum, SMALLINT power, uchar *tran_buf, SMALLINT tran_len)
+{
+   uchar sendpacket[2 * 160 + 40],readbuffer[160 + 20];
+   uchar temp_byte;
+   int sendlen=0,readlen,data_len,i;
+
+   // check for a block too big
+   if (tran_len > 160)
+   {
+      OWERROR(OWERROR_BLOCK_TOO_BIG);
+      return FALSE;
+   }
+   if (power && (tran_len < 1))
+      return FALSE;
+
+   // make sure normal level
+   owLevel(portnum,MODE_NORMAL);
+
+   // reset, in command mode
+   if (UMode[portnum] != MODSEL_COMMAND)
+      sendpacket[sendlen++] = MODE_COMMAND;
+   sendpacket[sendlen++] = (uchar)(CMD_COMM | FUNCTSEL_RESET | USpeed[portnum]);
+
+   // Match ROM and the data, in data mode
+   sendpacket[sendlen++] = MODE_DATA;
+   UMode[portnum] = MODSEL_DATA;
+   sendpacket[sendlen++] = 0x55;
+   for (i = 0; i < 8; i++)
+   {
+      sendpacket[sendlen++] = SerialNum[portnum][i];
+
+      // check for duplication of data that looks like COMMAND mode
+      if (SerialNum[portnum][i] == MODE_COMMAND)
+         sendpacket[sendlen++] = MODE_COMMAND;
+   }
+
+   data_len = power ? tran_len - 1 : tran_len;
+   for (i = 0; i < data_len; i++)
+   {
+      sendpacket[sendlen++] = tran_buf[i];
+
+      // check for duplication of data that looks like COMMAND mode
+      if (tran_buf[i] == MODE_COMMAND)
+         sendpacket[sendlen++] = tran_buf[i];
+   }
+
+   // the last byte as bit commands, the last one enabling the strong-pullup
+   if (power)
+   {
+      sendpacket[sendlen++] = MODE_COMMAND;
+      UMode[portnum] = MODSEL_COMMAND;
+      sendpacket[sendlen++] = CMD_CONFIG | PARMSEL_5VPULSE | PARMSET_infinite;
+
+      temp_byte = tran_buf[data_len];
+      for (i = 0; i < 8; i++)
+      {
+         sendpacket[sendlen++] = ((temp_byte & 0x01) ? BITPOL_ONE : BITPOL_ZERO)
+                                 | CMD_COMM | FUNCTSEL_BIT | USpeed[portnum] |
+                                 ((i == 7) ? PRIME5V_TRUE : PRIME5V_FALSE);
+         temp_byte >>= 1;
+      }
+   }
+
+   // reset byte, Match ROM echo, data and the 9 bytes for the power byte
+   readlen = 1 + 9 + data_len + (power ? 9 : 0);
+
+   // send the packet
+   if (WriteCOM(portnum,sendlen,sendpacket))
+   {
+      // read back the whole response
+      if (ReadCOM(portnum,readlen,readbuffer) == readlen)
+      {
+         // make sure the first byte looks like a reset byte
+         if (((readbuffer[0] & RB_RESET_MASK) == RB_PRESENCE) ||
+             ((readbuffer[0] & RB_RESET_MASK) == RB_ALARMPRESENCE))
+         {
+            // verify that the echo of the Match ROM was correct
+            if (readbuffer[1] != 0x55)
+            {
+               OWERROR(OWERROR_WRITE_VERIFY_FAILED);
+               return FALSE;
+            }
+            for (i = 0; i < 8; i++)
+            {
+               if (readbuffer[i + 2] != SerialNum[portnum][i])
+               {
+                  OWERROR(OWERROR_WRITE_VERIFY_FAILED);
+                  return FALSE;
+               }
+            }
+
+            for (i = 0; i < data_len; i++)
+               tran_buf[i] = readbuffer[i + 10];
+
+            if (!power)
+               return TRUE;
+
+            // check the response from setting the time limit
+            if ((readbuffer[data_len + 10] & 0x81) == 0)
+            {
+               // indicate the port is now at power delivery
+               ULevel[portnum] = MODE_STRONG5;
+
+               // reconstruct the echo byte
+               temp_byte = 0;
+               for (i = 0; i < 8; i++)
+               {
+                  temp_byte >>= 1;
+                  temp_byte |= (readbuffer[data_len + 11 + i] & 0x01) ? 0x80 : 0;
+               }
+
+               if (temp_byte == tran_buf[data_len])
+                  return TRUE;
+               OWERROR(OWERROR_WRITE_VERIFY_FAILED);
+               return FALSE;
+            }
+         }
+         else
+            OWERROR(OWERROR_RESET_FAILED);
+      }
+      else
+         OWERROR(OWERROR_READCOM_FAILED);
+   }
+   else
+      OWERROR(OWERROR_WRITECOM_FAILED);
+
+   // an error occurred so re-sync with DS2480
+   DS2480Detect(portnum);
+
+   return FALSE;
+}
+
 //--------------------------------------------------------------------------
 // Read a Universal Data Packet from a standard NVRAM iButton
 // and return it in the provided buffer. The page that the
@@ -0,0 +1,96 @@
+//---------------------------------------------------------------------------
+// Adapter table for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  owbackend.c - The table entry of one adapter. It is compiled along
+//                with the adapter's files, with the same OW_PREFIX, so
+//                the names below are that adapter's functions. OW_PORT
+//                is the 'name' a port starts with to use it.
+//
+
+#include <stdio.h>
+#include "ownet.h"
+#include "owbackend.h"
+
+// the adapter's functions, with their prefix from owprefix.h
+#ifndef OWUSB
+SMALLINT owAcquire(int,char *);
+void     owRelease(int);
+#else
+SMALLINT owAcquire(int,char *,char *);
+void     owRelease(int,char *);
+#endif // OWUSB
+SMALLINT owFirst(int,SMALLINT,SMALLINT);
+SMALLINT owNext(int,SMALLINT,SMALLINT);
+void     owSerialNum(int,uchar *,SMALLINT);
+void     owFamilySearchSetup(int,SMALLINT);
+void     owSkipFamily(int);
+SMALLINT owAccess(int);
+SMALLINT owVerify(int,SMALLINT);
+SMALLINT owOverdriveAccess(int);
+SMALLINT owBlock(int,SMALLINT,uchar *,SMALLINT);
+SMALLINT owAccessBlock(int,SMALLINT,uchar *,SMALLINT);
+SMALLINT owTouchReset(int);
+SMALLINT owTouchBit(int,SMALLINT);
+SMALLINT owTouchByte(int,SMALLINT);
+SMALLINT owWriteByte(int,SMALLINT);
+SMALLINT owReadByte(int);
+SMALLINT owSpeed(int,SMALLINT);
+SMALLINT owLevel(int,SMALLINT);
+SMALLINT owProgramPulse(int);
+SMALLINT owWriteBytePower(int,SMALLINT);
+SMALLINT owReadBitPower(int,SMALLINT);
+void     msDelay(int);
+long     msGettick(void);
+
+// from DigiTemp's src/<adapter>.c
+extern const char dtlib[];
+int adapter_stats(struct _adapter_stats *);
+int adapter_convert(int,int);
+
+#ifdef OWUSB
+//---------------------------------------------------------------------------
+// The DS2490 session functions return a message, print it
+//
+static SMALLINT acquire(int portnum, char *port_zstr)
+{
+   char msg[1024];
+
+   if (!owAcquire(portnum, port_zstr, msg))
+   {
+      fprintf(stderr, "USB ERROR: %s\n", msg);
+      return FALSE;
+   }
+   return TRUE;
+}
+
+static void release(int portnum)
+{
+   char msg[1024];
+
+   owRelease(portnum, msg);
+}
+#else
+#define acquire owAcquire
+#define release owRelease
+#endif // OWUSB
+
+struct ow_backend ow_backend_table = {
+   OW_PORT, dtlib,
+#if defined(OWUSB) || defined(OWW1)
+   FALSE,
+#else
+   TRUE,
+#endif
+   acquire, release,
+   owFirst, owNext, owSerialNum, owFamilySearchSetup, owSkipFamily,
+   owAccess, owVerify, owOverdriveAccess,
+   owBlock, owAccessBlock,
+   owTouchReset, owTouchBit, owTouchByte, owWriteByte, owReadByte,
+   owSpeed, owLevel, owProgramPulse, owWriteBytePower, owReadBitPower,
+   msDelay, msGettick,
+   adapter_stats, adapter_convert
+};
@@ -0,0 +1,63 @@
+//---------------------------------------------------------------------------
+// Adapter table for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  owbackend.h - The functions of one adapter, for the DigiTemp that has
+//                several of them linked in. owmulti.c picks an entry for
+//                each port when it is acquired, from the 'name:' in front
+//                of the port, and every call on that port goes straight
+//                to it.
+//
+
+#ifndef OW_BACKEND_H
+#define OW_BACKEND_H
+
+struct _adapter_stats;
+
+struct ow_backend {
+   char     *name;              // Prefix of the port, 'ds9097u' and so on
+   const char *lib;             // DigiTemp's name for it, dtlib
+   int      file_port;          // The port is a device file
+
+   // Session layer, owAcquire prints its own errors
+   SMALLINT (*owAcquire)(int,char *);
+   void     (*owRelease)(int);
+
+   // Network layer
+   SMALLINT (*owFirst)(int,SMALLINT,SMALLINT);
+   SMALLINT (*owNext)(int,SMALLINT,SMALLINT);
+   void     (*owSerialNum)(int,uchar *,SMALLINT);
+   void     (*owFamilySearchSetup)(int,SMALLINT);
+   void     (*owSkipFamily)(int);
+   SMALLINT (*owAccess)(int);
+   SMALLINT (*owVerify)(int,SMALLINT);
+   SMALLINT (*owOverdriveAccess)(int);
+
+   // Transport layer
+   SMALLINT (*owBlock)(int,SMALLINT,uchar *,SMALLINT);
+   SMALLINT (*owAccessBlock)(int,SMALLINT,uchar *,SMALLINT);
+
+   // Link layer
+   SMALLINT (*owTouchReset)(int);
+   SMALLINT (*owTouchBit)(int,SMALLINT);
+   SMALLINT (*owTouchByte)(int,SMALLINT);
+   SMALLINT (*owWriteByte)(int,SMALLINT);
+   SMALLINT (*owReadByte)(int);
+   SMALLINT (*owSpeed)(int,SMALLINT);
+   SMALLINT (*owLevel)(int,SMALLINT);
+   SMALLINT (*owProgramPulse)(int);
+   SMALLINT (*owWriteBytePower)(int,SMALLINT);
+   SMALLINT (*owReadBitPower)(int,SMALLINT);
+   void     (*msDelay)(int);
+   long     (*msGettick)(void);
+
+   // DigiTemp's counters for -v and --bench, and the adapter's own way
+   // of converting all of the thermometers
+   int      (*adapter_stats)(struct _adapter_stats *);
+   int      (*adapter_convert)(int,int);
+};
+
+#endif // OW_BACKEND_H
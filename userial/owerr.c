@@ -26,7 +26,10 @@
 //
 // owerr.c - Library functions for error handling with 1-Wire library
 //
-// Version: 1.00
+// Version: 1.01
+//
+// History: 1.00 -> 1.01  One error stack for each thread, so threads
+//                        driving different ports don't mix up errors.
 //
 
 #include <string.h>
@@ -59,12 +62,12 @@ typedef struct
 #endif
 } owErrorStruct;
 
-// Ring-buffer used for stack.
+// Ring-buffer used for stack, one for each thread.
 // In case of overflow, deepest error is over-written.
-static owErrorStruct owErrorStack[SIZE_OWERROR_STACK];
+static __thread owErrorStruct owErrorStack[SIZE_OWERROR_STACK];
 
 // Stack pointer to top-most error.
-static int owErrorPointer = 0;
+static __thread int owErrorPointer = 0;
 
 
 //---------------------------------------------------------------------------
@@ -0,0 +1,126 @@
+//---------------------------------------------------------------------------
+// Streaming memory reads for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  owmem.c - Read many pages of a device's memory with one Read Memory
+//            command. The device keeps sending pages, each followed by
+//            its inverted CRC16, for as long as the master reads, so
+//            there is no need to select it again for every page.
+//
+//            The transfer is split into blocks of OWMEM_BLOCK bytes,
+//            whole pages each, which every adapter's owBlock() takes.
+//            Each page's CRC16 is checked as its block comes in.
+//
+
+#include "ownet.h"
+
+// external One Wire functions from the transport layer
+extern SMALLINT owBlock(int,SMALLINT,uchar *,SMALLINT);
+extern SMALLINT owAccessBlock(int,SMALLINT,uchar *,SMALLINT);
+
+// external functions defined in crcutil.c
+extern void   setcrc16(int,ushort);
+extern ushort docrc16(int,ushort);
+
+// exportable functions defined in owmem.c
+int owReadMemoryCRC(int,uchar,int,int,int,uchar *);
+
+// Largest block handed to owBlock(), the smallest limit of the adapters
+#define OWMEM_BLOCK     160
+
+//--------------------------------------------------------------------------
+// Read 'num_pages' pages of 'page_len' bytes starting at 'address' of the
+// current device with 'cmd', a Read Memory command that sends an inverted
+// CRC16 after every page.  The CRC16 of the first page also covers the
+// command and the address, like the DS1921 and DS2423 0xA5 command.
+//
+// Stops at the first page with a bad CRC16, the pages before it are
+// good.  The caller can start again from the page after the last good
+// one.
+//
+// 'portnum'   - number 0 to MAX_PORTNUM-1.  This number is provided to
+//               indicate the symbolic port number.
+// 'cmd'       - Read Memory command
+// 'address'   - address of the first page
+// 'page_len'  - bytes in a page, not counting the CRC16
+// 'num_pages' - number of pages to read
+// 'buf'       - where the page data goes, num_pages * page_len bytes
+//
+// Returns: the number of pages read with a good CRC16, or -1 if the
+//          device couldn't be selected
+//
+int owReadMemoryCRC(int portnum, uchar cmd, int address, int page_len,
+                    int num_pages, uchar *buf)
+{
+   uchar  block[OWMEM_BLOCK];
+   int    per_block,pages,len,start,pg,i;
+   int    done = 0;
+   ushort lastcrc16 = 0;
+
+   // whole pages with their CRC16 in each block, leaving room for the
+   // command and address in the first one
+   per_block = (OWMEM_BLOCK - 3) / (page_len + 2);
+   if (per_block < 1)
+   {
+      OWERROR(OWERROR_BLOCK_TOO_BIG);
+      return -1;
+   }
+
+   while (done < num_pages)
+   {
+      pages = num_pages - done;
+      if (pages > per_block)
+         pages = per_block;
+
+      len = 0;
+      if (done == 0)
+      {
+         // Read Memory command and the address
+         block[len++] = cmd;
+         block[len++] = (uchar)(address & 0xFF);
+         block[len++] = (uchar)(address >> 8);
+      }
+      start = len;
+
+      // read slots for the data and the CRC16 of each page
+      for (i = 0; i < pages * (page_len + 2); i++)
+         block[len++] = 0xFF;
+
+      // select the device with the first block, the rest just keep reading
+      if (done == 0)
+      {
+         if (!owAccessBlock(portnum,FALSE,block,len))
+            return -1;
+      }
+      else if (!owBlock(portnum,FALSE,block,len))
+         return done;
+
+      // check each page as it came in
+      for (pg = 0; pg < pages; pg++)
+      {
+         setcrc16(portnum,0);
+         if ((done == 0) && (pg == 0))
+         {
+            for (i = 0; i < 3; i++)
+               docrc16(portnum,block[i]);
+         }
+         for (i = 0; i < page_len + 2; i++)
+            lastcrc16 = docrc16(portnum,block[start + pg * (page_len + 2) + i]);
+
+         if (lastcrc16 != 0xB001)
+         {
+            OWERROR(OWERROR_CRC_FAILED);
+            return done;
+         }
+
+         for (i = 0; i < page_len; i++)
+            buf[done * page_len + i] = block[start + pg * (page_len + 2) + i];
+         done++;
+      }
+   }
+
+   return done;
+}
@@ -0,0 +1,324 @@
+//---------------------------------------------------------------------------
+// Several adapters in one DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  owmulti.c - The 1-Wire functions the rest of DigiTemp calls, for the
+//              build that has several adapters linked in. The port says
+//              which adapter to use, 'ds9097u:/dev/ttyUSB0', 'ds9097:' or
+//              'sim:' and the name of a bus file, or 'ds2490:' and 'w1:'
+//              and the name of a kernel w1 master when they are built in.
+//              A port without a name uses the first adapter in the table.
+//
+//              owAcquire() looks the adapter up once and keeps its table
+//              for the port. After that every call is one indirect call
+//              through the port's table, straight into the adapter.
+//              msDelay() and msGettick() have no port number, they use
+//              the adapter the calling thread last talked to.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <pthread.h>
+#include "ownet.h"
+#include "owbackend.h"
+#include "digitemp.h"
+
+// the adapters that are linked in, each from its own owbackend.c
+extern struct ow_backend ds9097u_backend;
+extern struct ow_backend ds9097_backend;
+extern struct ow_backend sim_backend;
+#ifdef OW_DS2490
+extern struct ow_backend ds2490_backend;
+#endif // OW_DS2490
+#ifdef OW_W1
+extern struct ow_backend w1_backend;
+#endif // OW_W1
+
+static struct ow_backend *backends[] = {
+   &ds9097u_backend,
+   &ds9097_backend,
+   &sim_backend,
+#ifdef OW_DS2490
+   &ds2490_backend,
+#endif // OW_DS2490
+#ifdef OW_W1
+   &w1_backend,
+#endif // OW_W1
+   NULL
+};
+
+// Reported by DigiTemp's banner
+const char dtlib[] = "DS9097U, DS9097, SIM"
+#ifdef OW_DS2490
+                     ", DS2490"
+#endif // OW_DS2490
+#ifdef OW_W1
+                     ", W1"
+#endif // OW_W1
+                     ;
+
+// Adapter of each acquired port
+static struct ow_backend *port_backend[MAX_PORTNUM];
+
+// Adapter the calling thread last used, for msDelay() and msGettick()
+static __thread struct ow_backend *current = NULL;
+
+// exportable functions
+SMALLINT owAcquire(int,char *);
+void     owRelease(int);
+char     *owPortFile(char *);
+int      adapter_stats(struct _adapter_stats *);
+int      adapter_convert(int,int);
+
+
+//---------------------------------------------------------------------------
+// Find the adapter for 'port', and where the name of the port starts
+//
+static struct ow_backend *find_backend(char *port, char **rest)
+{
+   int i, len;
+
+   for (i = 0; backends[i] != NULL; i++)
+   {
+      len = strlen(backends[i]->name);
+      if ((strncasecmp(port, backends[i]->name, len) == 0) &&
+          (port[len] == ':'))
+      {
+         *rest = &port[len + 1];
+         return backends[i];
+      }
+   }
+
+   *rest = port;
+   return backends[0];
+}
+
+//---------------------------------------------------------------------------
+// The adapter of 'portnum', remembered for msDelay()
+//
+static inline struct ow_backend *ow_port(int portnum)
+{
+   current = port_backend[portnum];
+   return current;
+}
+
+//---------------------------------------------------------------------------
+// Attempt to acquire a 1-Wire net with the adapter named in 'port_zstr'.
+// Without a name it is the first adapter, the DS9097U.
+//
+// Returns: TRUE - success, port opened
+//          FALSE - failure, the adapter's owAcquire() failed
+//
+SMALLINT owAcquire(int portnum, char *port_zstr)
+{
+   struct ow_backend *b;
+   char *port;
+
+   b = find_backend(port_zstr, &port);
+   if (port == port_zstr)
+      fprintf(stderr, "Warning: no adapter named in %s, using the %s\n",
+              port_zstr, b->name);
+   if (!b->owAcquire(portnum, port))
+      return FALSE;
+
+   port_backend[portnum] = b;
+   current = b;
+   return TRUE;
+}
+
+//---------------------------------------------------------------------------
+// Release the previously acquired 1-Wire net.
+//
+void owRelease(int portnum)
+{
+   if (port_backend[portnum] == NULL)
+      return;
+
+   port_backend[portnum]->owRelease(portnum);
+   port_backend[portnum] = NULL;
+}
+
+//---------------------------------------------------------------------------
+// The device file of 'port' without the adapter's name, for checking that
+// it exists. NULL if the adapter doesn't use a device file.
+//
+char *owPortFile(char *port)
+{
+   char *file;
+
+   if (!find_backend(port, &file)->file_port)
+      return NULL;
+   return file;
+}
+
+//---------------------------------------------------------------------------
+// Network, transport and link layers, passed to the port's adapter
+//
+SMALLINT owFirst(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
+{
+   return ow_port(portnum)->owFirst(portnum, do_reset, alarm_only);
+}
+
+SMALLINT owNext(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
+{
+   return ow_port(portnum)->owNext(portnum, do_reset, alarm_only);
+}
+
+void owSerialNum(int portnum, uchar *serialnum_buf, SMALLINT do_read)
+{
+   ow_port(portnum)->owSerialNum(portnum, serialnum_buf, do_read);
+}
+
+void owFamilySearchSetup(int portnum, SMALLINT search_family)
+{
+   ow_port(portnum)->owFamilySearchSetup(portnum, search_family);
+}
+
+void owSkipFamily(int portnum)
+{
+   ow_port(portnum)->owSkipFamily(portnum);
+}
+
+SMALLINT owAccess(int portnum)
+{
+   return ow_port(portnum)->owAccess(portnum);
+}
+
+SMALLINT owVerify(int portnum, SMALLINT alarm_only)
+{
+   return ow_port(portnum)->owVerify(portnum, alarm_only);
+}
+
+SMALLINT owOverdriveAccess(int portnum)
+{
+   return ow_port(portnum)->owOverdriveAccess(portnum);
+}
+
+SMALLINT owBlock(int portnum, SMALLINT do_reset, uchar *tran_buf,
+                 SMALLINT tran_len)
+{
+   return ow_port(portnum)->owBlock(portnum, do_reset, tran_buf, tran_len);
+}
+
+SMALLINT owAccessBlock(int portnum, SMALLINT power, uchar *tran_buf,
+                       SMALLINT tran_len)
+{
+   return ow_port(portnum)->owAccessBlock(portnum, power, tran_buf, tran_len);
+}
+
+SMALLINT owTouchReset(int portnum)
+{
+   return ow_port(portnum)->owTouchReset(portnum);
+}
+
+SMALLINT owTouchBit(int portnum, SMALLINT sendbit)
+{
+   return ow_port(portnum)->owTouchBit(portnum, sendbit);
+}
+
+SMALLINT owTouchByte(int portnum, SMALLINT sendbyte)
+{
+   return ow_port(portnum)->owTouchByte(portnum, sendbyte);
+}
+
+SMALLINT owWriteByte(int portnum, SMALLINT sendbyte)
+{
+   return ow_port(portnum)->owWriteByte(portnum, sendbyte);
+}
+
+SMALLINT owReadByte(int portnum)
+{
+   return ow_port(portnum)->owReadByte(portnum);
+}
+
+SMALLINT owSpeed(int portnum, SMALLINT new_speed)
+{
+   return ow_port(portnum)->owSpeed(portnum, new_speed);
+}
+
+SMALLINT owLevel(int portnum, SMALLINT new_level)
+{
+   return ow_port(portnum)->owLevel(portnum, new_level);
+}
+
+SMALLINT owProgramPulse(int portnum)
+{
+   return ow_port(portnum)->owProgramPulse(portnum);
+}
+
+SMALLINT owWriteBytePower(int portnum, SMALLINT sendbyte)
+{
+   return ow_port(portnum)->owWriteBytePower(portnum, sendbyte);
+}
+
+SMALLINT owReadBitPower(int portnum, SMALLINT applyPowerResponse)
+{
+   return ow_port(portnum)->owReadBitPower(portnum, applyPowerResponse);
+}
+
+//--------------------------------------------------------------------------
+// Delay with the adapter the thread last used, the simulated one only
+// moves its clock
+//
+void msDelay(int len)
+{
+   (current ? current : backends[0])->msDelay(len);
+}
+
+long msGettick(void)
+{
+   return (current ? current : backends[0])->msGettick();
+}
+
+//--------------------------------------------------------------------------
+// Add up the counters of the adapters that have a port open. The
+// response time and timeout are the first one's that has them.
+//
+int adapter_stats(struct _adapter_stats *stats)
+{
+   struct _adapter_stats s;
+   int i, p, ret = 0;
+
+   memset(stats, 0, sizeof(struct _adapter_stats));
+   for (i = 0; backends[i] != NULL; i++)
+   {
+      for (p = 0; p < MAX_PORTNUM; p++)
+      {
+         if (port_backend[p] == backends[i])
+            break;
+      }
+      if (p == MAX_PORTNUM)
+         continue;
+
+      memset(&s, 0, sizeof(s));
+      if (!backends[i]->adapter_stats(&s))
+         continue;
+
+      stats->bus_us += s.bus_us;
+      stats->delay_us += s.delay_us;
+      stats->transactions += s.transactions;
+      stats->syscalls += s.syscalls;
+      stats->crc_errors += s.crc_errors;
+      if (!ret)
+      {
+         stats->response_us = s.response_us;
+         stats->timeout_ms = s.timeout_ms;
+      }
+      ret = 1;
+   }
+
+   return ret;
+}
+
+//--------------------------------------------------------------------------
+// Convert all of the thermometers of 'portnum' the adapter's own way
+//
+int adapter_convert(int portnum, int msec)
+{
+   return ow_port(portnum)->adapter_convert(portnum, msec);
+}
@@ -165,6 +165,9 @@
 #define FALSE          0
 #define TRUE           1
 
+// All of the state of a port is kept in arrays indexed by portnum, so
+// different ports can be used from different threads at the same time.
+// A port must only be used by one thread at a time.
 #ifndef MAX_PORTNUM
    #define MAX_PORTNUM    16
 #endif
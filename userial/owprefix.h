@@ -0,0 +1,89 @@
+//---------------------------------------------------------------------------
+// Adapter name prefixes for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  owprefix.h - Every adapter's link, network, transport and session
+//               layers define the same names. To link several of them into
+//               one DigiTemp their files are compiled with
+//               -DOW_PREFIX=<adapter>_ -include owprefix.h, which puts the
+//               prefix in front of all of those names. Calls between the
+//               layers of one adapter stay direct, the rest of DigiTemp
+//               goes through owmulti.c.
+//
+//               It is included before anything else, so a name that is
+//               also a field in a system header (fd in struct pollfd) is
+//               changed the same way everywhere in the file.
+//
+
+#ifndef OW_PREFIX_H
+#define OW_PREFIX_H
+
+#define OW_PASTE2(a,b)          a##b
+#define OW_PASTE(a,b)           OW_PASTE2(a,b)
+#define OW_NAME(name)           OW_PASTE(OW_PREFIX,name)
+
+// Session layer
+#define owAcquire               OW_NAME(owAcquire)
+#define owRelease               OW_NAME(owRelease)
+
+// Network layer
+#define owFirst                 OW_NAME(owFirst)
+#define owNext                  OW_NAME(owNext)
+#define owSerialNum             OW_NAME(owSerialNum)
+#define owFamilySearchSetup     OW_NAME(owFamilySearchSetup)
+#define owSkipFamily            OW_NAME(owSkipFamily)
+#define owAccess                OW_NAME(owAccess)
+#define owVerify                OW_NAME(owVerify)
+#define owOverdriveAccess       OW_NAME(owOverdriveAccess)
+#define bitacc                  OW_NAME(bitacc)
+#define SerialNum               OW_NAME(SerialNum)
+
+// Transport layer
+#define owBlock                 OW_NAME(owBlock)
+#define owAccessBlock           OW_NAME(owAccessBlock)
+#define owReadPacketStd         OW_NAME(owReadPacketStd)
+#define owWritePacketStd        OW_NAME(owWritePacketStd)
+#define owProgramByte           OW_NAME(owProgramByte)
+
+// Link layer
+#define owTouchReset            OW_NAME(owTouchReset)
+#define owTouchBit              OW_NAME(owTouchBit)
+#define owTouchBits             OW_NAME(owTouchBits)
+#define owTouchBlock            OW_NAME(owTouchBlock)
+#define owLinkInit              OW_NAME(owLinkInit)
+#define owBlockIO               OW_NAME(owBlockIO)
+#define owSearchAccess          OW_NAME(owSearchAccess)
+#define owTouchByte             OW_NAME(owTouchByte)
+#define owWriteByte             OW_NAME(owWriteByte)
+#define owReadByte              OW_NAME(owReadByte)
+#define owSpeed                 OW_NAME(owSpeed)
+#define owLevel                 OW_NAME(owLevel)
+#define owProgramPulse          OW_NAME(owProgramPulse)
+#define owWriteBytePower        OW_NAME(owWriteBytePower)
+#define owReadBitPower          OW_NAME(owReadBitPower)
+#define owHasPowerDelivery      OW_NAME(owHasPowerDelivery)
+#define owHasOverDrive          OW_NAME(owHasOverDrive)
+#define owHasProgramPulse       OW_NAME(owHasProgramPulse)
+#define hasPowerDelivery        OW_NAME(hasPowerDelivery)
+#define hasOverDrive            OW_NAME(hasOverDrive)
+#define hasProgramPulse         OW_NAME(hasProgramPulse)
+#define msDelay                 OW_NAME(msDelay)
+#define msGettick               OW_NAME(msGettick)
+
+// Serial port state of the DS9097 and DS9097U
+#define fd                      OW_NAME(fd)
+#define term                    OW_NAME(term)
+#define term_orig               OW_NAME(term_orig)
+
+// DigiTemp's adapter files, src/ds9097.c and the others
+#define dtlib                   OW_NAME(dtlib)
+#define adapter_stats           OW_NAME(adapter_stats)
+#define adapter_convert         OW_NAME(adapter_convert)
+
+// The adapter's entry in owmulti.c's table, from owbackend.c
+#define ow_backend_table        OW_NAME(backend)
+
+#endif // OW_PREFIX_H
@@ -15,7 +15,9 @@ SMALLINT owWriteByte(int,SMALLINT);
 SMALLINT owReadByte(int);
 SMALLINT owLevel(int,SMALLINT);
 void     msDelay(int);
+long     msGettick(void);
 SMALLINT owBlock(int,SMALLINT,uchar *,SMALLINT);
+SMALLINT owAccessBlock(int,SMALLINT,uchar *,SMALLINT);
 SMALLINT owTouchReset(int);
 
 #ifndef OWUSB
@@ -27,6 +29,11 @@ void     owRelease(int, char *);
 SMALLINT owFirst(int,SMALLINT,SMALLINT);
 SMALLINT owNext(int,SMALLINT,SMALLINT);
 
+#ifdef OWMULTI
+/* From owmulti.c */
+char     *owPortFile(char *);
+#endif /* OWMULTI */
+
 
 /* From owerr.c */
 int owGetErrorNum(void);
@@ -76,9 +83,12 @@ int owBranchNext(int,uchar *,int,int);
 /* From cnt1d.c */
 SMALLINT ReadCounter(int,int,ulong *);
 
+/* From owmem.c */
+int owReadMemoryCRC(int,uchar,int,int,int,uchar *);
+
 /* From ad26.c */
-double Get_Temperature(int portnum);
-float Volt_Reading(int portnum, int vdd, int *cad);
+double Get_Temperature(int portnum, int reads);
+float Volt_Reading(int portnum, int vdd, int *cad, int reads);
 int PIO_Reading(int portnum, int pionum /* TS ignored so far */ );
 
 /* From XXXlnk.c */
@@ -0,0 +1,1188 @@
+//---------------------------------------------------------------------------
+// Simulated 1-Wire bus for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  simbus.c - In-memory 1-Wire bus model used by the simulated adapter.
+//
+//  Every device runs its own copy of the 1-Wire protocol a time slot at a
+//  time, so the normal search, Match ROM, Skip ROM and block code in the
+//  network and transport layers runs unchanged on top of it. The line is
+//  a wired-AND of the master and every connected device. Time is kept on
+//  a simulated clock that advances by the length of each reset and time
+//  slot, and by msDelay.
+//
+//  Modelled devices: DS18B20, DS1822, DS1820/DS18S20, DS2438, DS2423,
+//  DS1923 and the DS2409 coupler, including parasite power, conversion
+//  times, busy signalling in read slots and injected CRC errors.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <time.h>
+#include "ownet.h"
+#include "simbus.h"
+
+// What a conversion produces
+#define CONV_TEMP         0
+#define CONV_VOLT         1
+
+// One bus for each port, every thread works on the bus of the port it
+// last used, so msDelay() and msGettick() need no port number
+static struct sim_bus sim_bus[MAX_PORTNUM];
+static __thread struct sim_bus *sim = &sim_bus[0];
+
+// local functions
+static int  sim_connected(int d);
+static void sim_finish(struct sim_dev *d);
+static void sim_activity(void);
+
+
+//--------------------------------------------------------------------------
+// Repeatable random numbers, the same bus file always gives the same run
+//
+static int sim_random(void)
+{
+   sim->seed = sim->seed * 1103515245UL + 12345UL;
+   return (int)((sim->seed >> 16) & 0x7FFF);
+}
+
+//--------------------------------------------------------------------------
+// Dallas CRC8 of a block
+//
+static unsigned char sim_crc8(unsigned char *buf, int len)
+{
+   unsigned char crc = 0;
+   int i, b;
+
+   for (i = 0; i < len; i++)
+   {
+      crc ^= buf[i];
+      for (b = 0; b < 8; b++)
+         crc = (crc & 0x01) ? (crc >> 1) ^ 0x8C : (crc >> 1);
+   }
+   return crc;
+}
+
+//--------------------------------------------------------------------------
+// Dallas CRC16, one byte at a time
+//
+static unsigned short sim_crc16(unsigned short crc, unsigned char data)
+{
+   int b;
+
+   crc ^= data;
+   for (b = 0; b < 8; b++)
+      crc = (crc & 0x0001) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+   return crc;
+}
+
+//--------------------------------------------------------------------------
+// Flip a bit in a CRC protected reply, as often as CRC_ERRORS says
+//
+static void sim_corrupt(struct sim_dev *d, unsigned char *buf, int len)
+{
+   int pct = (d->crc_errors >= 0) ? d->crc_errors : sim->crc_errors;
+
+   if ((pct <= 0) || ((sim_random() % 100) >= pct))
+      return;
+
+   buf[sim_random() % len] ^= 1 << (sim_random() % 8);
+   sim->stats.crc_errors++;
+}
+
+//--------------------------------------------------------------------------
+// Queue bytes to be sent in the following read slots
+//
+static void sim_send(struct sim_dev *d, unsigned char *buf, int len)
+{
+   if (len > sizeof(d->tx))
+      len = sizeof(d->tx);
+   memcpy(d->tx, buf, len);
+   d->tx_bits = len * 8;
+   d->tx_pos = 0;
+}
+
+//--------------------------------------------------------------------------
+// Bit 'n' of the ROM
+//
+static int sim_rom_bit(struct sim_dev *d, int n)
+{
+   return (d->rom[n / 8] >> (n % 8)) & 0x01;
+}
+
+//--------------------------------------------------------------------------
+// Is device 'd' connected to the master? Devices behind a DS2409 are only
+// connected when that branch is switched on.
+//
+static int sim_connected(int d)
+{
+   int c = sim->dev[d].coupler;
+
+   if (c < 0)
+      return TRUE;
+
+   return (sim->dev[c].lines == sim->dev[d].branch) && sim_connected(c);
+}
+
+//--------------------------------------------------------------------------
+// Start a conversion that takes 'ms' milliseconds
+//
+static void sim_start_convert(struct sim_dev *d, int kind, double ms)
+{
+   // The command's last time slot is still running
+   d->converting = TRUE;
+   d->convert_kind = kind;
+   d->convert_start = sim->now_us + sim->bit_us;
+   d->convert_done = d->convert_start + ms * 1000.0;
+   d->powered = FALSE;
+
+   // Externally powered DS18x20s hold read slots low until they are done
+   if (!d->parasite && (kind == CONV_TEMP) &&
+       (d->rom[0] != SIM_DS2438) && (d->rom[0] != SIM_DS1923))
+      d->busy_until = d->convert_done;
+}
+
+//--------------------------------------------------------------------------
+// DS18x20 temperature registers for 'temp', at the configured resolution
+//
+static void sim_ds18x20_temp(struct sim_dev *d, double temp)
+{
+   int raw, res, tr;
+
+   if (d->rom[0] == SIM_DS1820)
+   {
+      // Half degree reading, COUNT_REMAIN has the rest
+      tr = (int) floor(temp + 0.25);
+      raw = tr * 2 + ((temp >= tr + 0.25) ? 1 : 0);
+      d->scratch[0] = raw & 0xFF;
+      d->scratch[1] = (raw < 0) ? 0xFF : 0x00;
+      d->scratch[6] = 16 - (int)((temp - tr + 0.25) * 16);
+      d->scratch[7] = 0x10;
+      return;
+   }
+
+   res = 9 + ((d->scratch[4] >> 5) & 0x03);
+   raw = (int) floor(temp * 16 + 0.5);
+   raw &= ~((1 << (12 - res)) - 1);
+   d->scratch[0] = raw & 0xFF;
+   d->scratch[1] = (raw >> 8) & 0xFF;
+}
+
+//--------------------------------------------------------------------------
+// The power-on value, 85C. A parasite powered conversion without the
+// strong pullup leaves this in the scratchpad.
+//
+static void sim_ds18x20_reset_value(struct sim_dev *d)
+{
+   if (d->rom[0] == SIM_DS1820)
+   {
+      d->scratch[0] = 0xAA;
+      d->scratch[1] = 0x00;
+      d->scratch[6] = 0x0C;
+      d->scratch[7] = 0x10;
+   }
+   else
+   {
+      d->scratch[0] = 0x50;
+      d->scratch[1] = 0x05;
+   }
+}
+
+//--------------------------------------------------------------------------
+// Store the result if the conversion has finished
+//
+static void sim_finish(struct sim_dev *d)
+{
+   int raw, cad;
+   double v;
+
+   if (!d->converting || (sim->now_us < d->convert_done))
+      return;
+
+   d->converting = FALSE;
+
+   switch (d->rom[0])
+   {
+      case SIM_DS1820:
+      case SIM_DS1822:
+      case SIM_DS18B20:
+      case SIM_DS28EA00:
+         if (d->parasite && !d->powered)
+            sim_ds18x20_reset_value(d);
+         else
+            sim_ds18x20_temp(d, d->temp);
+         break;
+
+      case SIM_DS2438:
+         if (d->convert_kind == CONV_TEMP)
+         {
+            raw = ((int) floor(d->temp / 0.03125 + 0.5)) << 3;
+            d->page[0][1] = raw & 0xFF;
+            d->page[0][2] = (raw >> 8) & 0xFF;
+         }
+         else
+         {
+            // AD bit picks VDD or VAD
+            v = (d->page[0][0] & 0x08) ? d->vdd : d->vad;
+            raw = (int) floor(v * 100 + 0.5) & 0x03FF;
+            d->page[0][3] = raw & 0xFF;
+            d->page[0][4] = (raw >> 8) & 0xFF;
+
+            cad = (int) floor(d->vsens / 0.2441 + 0.5);
+            d->page[0][5] = cad & 0xFF;
+            d->page[0][6] = (cad >> 8) & 0xFF;
+         }
+         break;
+
+      case SIM_DS1923:
+         // Latest temperature, 11 bits
+         raw = ((int) floor((d->temp + 41.0) * 512 + 0.5)) & 0xFFE0;
+         d->mem[0x0C] = raw & 0xFF;
+         d->mem[0x0D] = (raw >> 8) & 0xFF;
+
+         // Latest humidity, 12 bits of the A/D
+         v = d->humidity * 0.0307 + 0.958;
+         raw = ((int) floor(v * 4096 / 5.02 + 0.5)) << 4;
+         d->mem[0x0E] = raw & 0xFF;
+         d->mem[0x0F] = (raw >> 8) & 0xFF;
+         break;
+   }
+}
+
+//--------------------------------------------------------------------------
+// Something happened on the bus. Finish any conversions that are done and
+// drop the strong pullup, which takes the power away from parasite devices
+// that are still converting.
+//
+static void sim_activity(void)
+{
+   int d;
+
+   for (d = 0; d < sim->ndev; d++)
+      sim_finish(&sim->dev[d]);
+
+   if (sim->strong)
+      sim_level(FALSE);
+}
+
+//--------------------------------------------------------------------------
+// Switch the branches of a DS2409 after the confirmation byte
+//
+static void sim_switch(int c)
+{
+   int d;
+
+   sim->dev[c].lines = sim->dev[c].new_lines;
+
+   for (d = 0; d < sim->ndev; d++)
+   {
+      if (sim->dev[d].coupler != c)
+         continue;
+
+      // Smart-on resets the branch, so it is ready for a ROM command
+      if (sim->dev[c].smart && sim_connected(d))
+      {
+         sim->dev[d].state = SIM_ROM;
+         sim->dev[d].bit = 0;
+         sim->dev[d].rx = 0;
+      }
+      else
+         sim->dev[d].state = SIM_IDLE;
+      sim->dev[d].tx_bits = sim->dev[d].tx_pos = 0;
+   }
+}
+
+//--------------------------------------------------------------------------
+// Is anything on branch 'branch' of coupler 'c'?
+//
+static int sim_branch_presence(int c, int branch)
+{
+   int d;
+
+   for (d = 0; d < sim->ndev; d++)
+   {
+      if ((sim->dev[d].coupler == c) && (sim->dev[d].branch == branch))
+         return TRUE;
+   }
+   return FALSE;
+}
+
+//--------------------------------------------------------------------------
+// ROM command received
+//
+static void sim_rom_command(struct sim_dev *d, unsigned char cmd)
+{
+   d->bit = 0;
+   d->rx = 0;
+
+   switch (cmd)
+   {
+      case 0x33:  // Read ROM
+         sim_send(d, d->rom, 8);
+         d->state = SIM_CMD;
+         break;
+
+      case 0x55:  // Match ROM
+         d->state = SIM_MATCH;
+         break;
+
+      case 0xCC:  // Skip ROM
+         d->state = SIM_CMD;
+         break;
+
+      case 0xF0:  // Search ROM
+         d->state = SIM_SEARCH;
+         d->phase = 0;
+         break;
+
+      default:    // Alarm search (nothing alarms), overdrive, ...
+         d->state = SIM_IDLE;
+         break;
+   }
+}
+
+//--------------------------------------------------------------------------
+// Function command received by a selected device
+//
+static void sim_function(int n, unsigned char cmd)
+{
+   struct sim_dev *d = &sim->dev[n];
+   unsigned char buf[9];
+   int ms;
+
+   d->state = SIM_FUNC;
+   d->cmd = cmd;
+   d->nargs = 0;
+
+   switch (d->rom[0])
+   {
+      case SIM_DS1820:
+      case SIM_DS1822:
+      case SIM_DS18B20:
+      case SIM_DS28EA00:
+         switch (cmd)
+         {
+            case 0x44:  // Convert T
+               if (d->convert_ms > 0)
+                  ms = d->convert_ms;
+               else if (d->rom[0] == SIM_DS1820)
+                  ms = 500;
+               else
+                  ms = 600 >> (3 - ((d->scratch[4] >> 5) & 0x03));
+               sim_start_convert(d, CONV_TEMP, ms);
+               return;
+
+            case 0xBE:  // Read Scratchpad
+               sim_finish(d);
+               d->scratch[8] = sim_crc8(d->scratch, 8);
+               memcpy(buf, d->scratch, 9);
+               sim_corrupt(d, buf, 9);
+               sim_send(d, buf, 9);
+               return;
+
+            case 0x4E:  // Write Scratchpad, bytes follow
+               return;
+
+            case 0x48:  // Copy Scratchpad
+               memcpy(d->eeprom, &d->scratch[2], 3);
+               d->busy_until = sim->now_us + 10000.0;
+               return;
+
+            case 0xB8:  // Recall EEPROM
+               memcpy(&d->scratch[2], d->eeprom,
+                      (d->rom[0] == SIM_DS1820) ? 2 : 3);
+               return;
+
+            case 0xB4:  // Read Power Supply, parasite devices pull it low
+               if (d->parasite)
+               {
+                  buf[0] = 0x00;
+                  sim_send(d, buf, 1);
+                  d->tx_bits = 1;
+               }
+               return;
+         }
+         break;
+
+      case SIM_DS2438:
+         switch (cmd)
+         {
+            case 0x44:  // Convert T
+               sim_start_convert(d, CONV_TEMP, d->convert_ms ? d->convert_ms : 10);
+               return;
+
+            case 0xB4:  // Convert V
+               sim_start_convert(d, CONV_VOLT, 4);
+               return;
+
+            case 0xB8:  // Recall Memory, page follows
+            case 0xBE:  // Read Scratchpad, page follows
+            case 0x4E:  // Write Scratchpad, page and data follow
+            case 0x48:  // Copy Scratchpad, page follows
+               return;
+         }
+         break;
+
+      case SIM_DS2423:
+         if (cmd == 0xA5)  // Read Memory + Counter, address follows
+            return;
+         break;
+
+      case SIM_DS1923:
+         if ((cmd == 0x55) || (cmd == 0x69))
+            return;
+         break;
+
+      case SIM_DS2409:
+         switch (cmd)
+         {
+            case 0x66:  // All Lines Off
+               d->new_lines = -1;
+               d->smart = FALSE;
+               sim_send(d, &cmd, 1);
+               return;
+
+            case 0xA5:  // Direct-On Main
+               d->new_lines = SIM_BRANCH_MAIN;
+               d->smart = FALSE;
+               sim_send(d, &cmd, 1);
+               return;
+
+            case 0xCC:  // Smart-On Main
+            case 0x33:  // Smart-On Auxiliary
+               d->new_lines = (cmd == 0xCC) ? SIM_BRANCH_MAIN : SIM_BRANCH_AUX;
+               d->smart = TRUE;
+               buf[0] = 0xFF;
+               buf[1] = sim_branch_presence(n, d->new_lines) ? 0x00 : 0xFF;
+               buf[2] = cmd;
+               sim_send(d, buf, 3);
+               return;
+
+            case 0x5A:  // Status Read/Write, status follows
+               return;
+         }
+         break;
+   }
+
+   // Not something we know about, wait for the next reset
+   d->state = SIM_IDLE;
+}
+
+//--------------------------------------------------------------------------
+// Byte received after a function command
+//
+static void sim_function_data(struct sim_dev *d, unsigned char data)
+{
+   unsigned char buf[64];
+   unsigned short crc;
+   unsigned long count;
+   int addr, page, len, i;
+
+   if (d->nargs < sizeof(d->args))
+      d->args[d->nargs] = data;
+   d->nargs++;
+
+   switch (d->rom[0])
+   {
+      case SIM_DS1820:
+      case SIM_DS1822:
+      case SIM_DS18B20:
+      case SIM_DS28EA00:
+         // Write Scratchpad, TH TL and config (not on the DS1820)
+         if ((d->cmd == 0x4E) &&
+             (d->nargs <= ((d->rom[0] == SIM_DS1820) ? 2 : 3)))
+         {
+            if (d->nargs == 3)
+               data = (data & 0x60) | 0x1F;
+            d->scratch[1 + d->nargs] = data;
+         }
+         break;
+
+      case SIM_DS2438:
+         page = d->args[0] & 0x07;
+         switch (d->cmd)
+         {
+            case 0xB8:
+               if (d->nargs == 1)
+               {
+                  sim_finish(d);
+                  memcpy(d->spad[page], d->page[page], 8);
+               }
+               break;
+
+            case 0xBE:
+               if (d->nargs == 1)
+               {
+                  memcpy(buf, d->spad[page], 8);
+                  buf[8] = sim_crc8(buf, 8);
+                  sim_corrupt(d, buf, 9);
+                  sim_send(d, buf, 9);
+               }
+               break;
+
+            case 0x4E:
+               if ((d->nargs >= 2) && (d->nargs <= 9))
+                  d->spad[page][d->nargs - 2] = data;
+               break;
+
+            case 0x48:
+               if (d->nargs == 1)
+               {
+                  // Only the config and threshold bytes of page 0 are writable
+                  if (page == 0)
+                  {
+                     d->page[0][0] = d->spad[0][0];
+                     d->page[0][7] = d->spad[0][7];
+                  }
+                  else
+                     memcpy(d->page[page], d->spad[page], 8);
+                  d->busy_until = sim->now_us + 10000.0;
+               }
+               break;
+         }
+         break;
+
+      case SIM_DS2423:
+         if (d->nargs != 2)
+            break;
+
+         // Rest of the page, the counter, 4 zero bytes and the CRC16
+         addr = (d->args[0] | (d->args[1] << 8)) & 0x01FF;
+         page = addr >> 5;
+         crc = sim_crc16(0, 0xA5);
+         crc = sim_crc16(crc, d->args[0]);
+         crc = sim_crc16(crc, d->args[1]);
+
+         len = 0;
+         for (i = addr & 0x1F; i < 32; i++)
+            buf[len++] = 0xFF;
+
+         if (page >= 14)
+            count = (unsigned long)(d->count[page - 14] +
+                                    d->rate[page - 14] * sim->now_us / 1000000.0);
+         else if (page >= 12)
+            count = 0;
+         else
+            count = 0xFFFFFFFFUL;
+         for (i = 0; i < 4; i++)
+            buf[len++] = (count >> (i * 8)) & 0xFF;
+         for (i = 0; i < 4; i++)
+            buf[len++] = 0x00;
+
+         for (i = 0; i < len; i++)
+            crc = sim_crc16(crc, buf[i]);
+         crc = ~crc;
+         buf[len++] = crc & 0xFF;
+         buf[len++] = (crc >> 8) & 0xFF;
+
+         sim_corrupt(d, buf, len);
+         sim_send(d, buf, len);
+         break;
+
+      case SIM_DS1923:
+         if (d->cmd == 0x55)
+         {
+            // Forced Conversion needs 0x55 twice
+            if ((d->nargs == 1) && (data == 0x55))
+               sim_start_convert(d, CONV_TEMP, d->convert_ms ? d->convert_ms : 500);
+         }
+         else if (d->nargs == 10)
+         {
+            // Read Memory with Password, address and 8 password bytes
+            sim_finish(d);
+            addr = d->args[0] | (d->args[1] << 8);
+            len = 0;
+            if ((addr >= 0x0200) && (addr < 0x0220))
+            {
+               crc = sim_crc16(0, 0x69);
+               crc = sim_crc16(crc, d->args[0]);
+               crc = sim_crc16(crc, d->args[1]);
+               for (i = addr - 0x0200; i < 32; i++)
+               {
+                  buf[len] = d->mem[i];
+                  crc = sim_crc16(crc, buf[len++]);
+               }
+               crc = ~crc;
+               buf[len++] = crc & 0xFF;
+               buf[len++] = (crc >> 8) & 0xFF;
+            }
+            sim_send(d, buf, len);
+         }
+         break;
+
+      case SIM_DS2409:
+         // Status Read/Write, the status comes back twice
+         if ((d->cmd == 0x5A) && (d->nargs == 1))
+         {
+            buf[0] = buf[1] = d->status;
+            sim_send(d, buf, 2);
+         }
+         break;
+   }
+}
+
+//--------------------------------------------------------------------------
+// Receive a bit, returns TRUE when a whole byte is in d->rx
+//
+static int sim_receive(struct sim_dev *d, int line)
+{
+   if (line)
+      d->rx |= 1 << d->bit;
+   if (++d->bit < 8)
+      return FALSE;
+   d->bit = 0;
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// What device 'd' does to the line in this time slot, 0 pulls it low
+//
+static int sim_drive(struct sim_dev *d)
+{
+   if (d->tx_pos < d->tx_bits)
+      return (d->tx[d->tx_pos / 8] >> (d->tx_pos % 8)) & 0x01;
+
+   switch (d->state)
+   {
+      case SIM_SEARCH:
+         if (d->phase == 0)
+            return sim_rom_bit(d, d->bit);
+         if (d->phase == 1)
+            return !sim_rom_bit(d, d->bit);
+         break;
+
+      case SIM_FUNC:
+         if (sim->now_us < d->busy_until)
+            return 0;
+         break;
+   }
+   return 1;
+}
+
+//--------------------------------------------------------------------------
+// Device 'n' sees the line level at the end of the time slot
+//
+static void sim_sample(int n, int line)
+{
+   struct sim_dev *d = &sim->dev[n];
+   unsigned char byte;
+
+   // Sending, not listening
+   if (d->tx_pos < d->tx_bits)
+   {
+      if (++d->tx_pos == d->tx_bits)
+      {
+         d->tx_bits = d->tx_pos = 0;
+         if ((d->rom[0] == SIM_DS2409) && (d->state == SIM_FUNC) &&
+             (d->cmd != 0x5A))
+            d->switching = TRUE;
+      }
+      return;
+   }
+
+   switch (d->state)
+   {
+      case SIM_ROM:
+         if (sim_receive(d, line))
+         {
+            byte = d->rx;
+            sim_rom_command(d, byte);
+         }
+         break;
+
+      case SIM_MATCH:
+         if (line != sim_rom_bit(d, d->bit))
+            d->state = SIM_IDLE;
+         else if (++d->bit == 64)
+         {
+            d->state = SIM_CMD;
+            d->bit = 0;
+            d->rx = 0;
+         }
+         break;
+
+      case SIM_SEARCH:
+         if (d->phase < 2)
+         {
+            d->phase++;
+            break;
+         }
+
+         // The master wrote the direction, drop out if it isn't ours
+         d->phase = 0;
+         if (line != sim_rom_bit(d, d->bit))
+            d->state = SIM_IDLE;
+         else if (++d->bit == 64)
+         {
+            d->state = SIM_CMD;
+            d->bit = 0;
+            d->rx = 0;
+         }
+         break;
+
+      case SIM_CMD:
+         if (sim_receive(d, line))
+         {
+            byte = d->rx;
+            d->rx = 0;
+            sim_function(n, byte);
+         }
+         break;
+
+      case SIM_FUNC:
+         if (sim->now_us < d->busy_until)
+            break;
+         if (sim_receive(d, line))
+         {
+            byte = d->rx;
+            d->rx = 0;
+            sim_function_data(d, byte);
+         }
+         break;
+   }
+}
+
+//--------------------------------------------------------------------------
+// Work on the bus of 'portnum' from now on in this thread
+//
+void sim_select(int portnum)
+{
+   if ((portnum >= 0) && (portnum < MAX_PORTNUM))
+      sim = &sim_bus[portnum];
+}
+
+//--------------------------------------------------------------------------
+// Reset pulse. Returns TRUE if something answered with a presence pulse.
+//
+int sim_reset(void)
+{
+   int d, presence = FALSE;
+
+   sim_activity();
+
+   for (d = 0; d < sim->ndev; d++)
+   {
+      sim->dev[d].tx_bits = sim->dev[d].tx_pos = 0;
+      sim->dev[d].bit = 0;
+      sim->dev[d].rx = 0;
+      if (sim_connected(d))
+      {
+         sim->dev[d].state = SIM_ROM;
+         presence = TRUE;
+      }
+      else
+         sim->dev[d].state = SIM_IDLE;
+   }
+
+   sim->now_us += sim->reset_us;
+   sim->stats.bus_us += sim->reset_us;
+   sim->stats.resets++;
+
+   return presence;
+}
+
+//--------------------------------------------------------------------------
+// One time slot. Writing a 1 is a read slot, the result is the wired-AND
+// of the master and every connected device.
+//
+int sim_touch_bit(int sbit)
+{
+   int d, line;
+
+   sim_activity();
+
+   line = sbit & 0x01;
+   for (d = 0; d < sim->ndev; d++)
+   {
+      if ((sim->conn[d] = sim_connected(d)) != 0)
+         line &= sim_drive(&sim->dev[d]);
+   }
+
+   for (d = 0; d < sim->ndev; d++)
+   {
+      if (sim->conn[d])
+         sim_sample(d, line);
+   }
+
+   // Branches change once everything has seen the confirmation
+   for (d = 0; d < sim->ndev; d++)
+   {
+      if (sim->dev[d].switching)
+      {
+         sim->dev[d].switching = FALSE;
+         sim_switch(d);
+      }
+   }
+
+   sim->now_us += sim->bit_us;
+   sim->stats.bus_us += sim->bit_us;
+   sim->stats.bits++;
+
+   return line;
+}
+
+//--------------------------------------------------------------------------
+// Turn the strong pullup on or off
+//
+void sim_level(int on)
+{
+   int d;
+
+   for (d = 0; d < sim->ndev; d++)
+   {
+      sim_finish(&sim->dev[d]);
+
+      if (!sim->dev[d].converting || !sim->dev[d].parasite)
+         continue;
+
+      // Only a pullup right after the command powers the conversion,
+      // taking it away early spoils it.
+      if (on)
+         sim->dev[d].powered = (sim->now_us - sim->dev[d].convert_start < 1.0);
+      else
+         sim->dev[d].powered = FALSE;
+   }
+
+   if (on && !sim->strong)
+      sim->stats.strong++;
+   sim->strong = on;
+}
+
+//--------------------------------------------------------------------------
+// Let time pass without any bus activity
+//
+void sim_delay(double us)
+{
+   struct timespec s;
+
+   sim->now_us += us;
+   sim->stats.delay_us += us;
+
+   if (sim->realtime)
+   {
+      s.tv_sec = (time_t)(us / 1000000.0);
+      s.tv_nsec = (long)(us - s.tv_sec * 1000000.0) * 1000;
+      nanosleep(&s, NULL);
+      sim->stats.syscalls++;
+   }
+}
+
+//--------------------------------------------------------------------------
+// Simulated time in uS
+//
+double sim_now(void)
+{
+   return sim->now_us;
+}
+
+//--------------------------------------------------------------------------
+// msDelay really sleeps
+//
+int sim_realtime(void)
+{
+   return sim->realtime;
+}
+
+//--------------------------------------------------------------------------
+// Count a call into the link layer. A real adapter needs at least one
+// round trip for each of them.
+//
+void sim_transaction(void)
+{
+   sim->stats.transactions++;
+}
+
+//--------------------------------------------------------------------------
+// Add up the counters of all the buses
+//
+void sim_get_stats(struct sim_stats *s)
+{
+   int p;
+
+   memset(s, 0, sizeof(struct sim_stats));
+   for (p = 0; p < MAX_PORTNUM; p++)
+   {
+      s->bus_us += sim_bus[p].stats.bus_us;
+      s->delay_us += sim_bus[p].stats.delay_us;
+      s->resets += sim_bus[p].stats.resets;
+      s->bits += sim_bus[p].stats.bits;
+      s->strong += sim_bus[p].stats.strong;
+      s->crc_errors += sim_bus[p].stats.crc_errors;
+      s->transactions += sim_bus[p].stats.transactions;
+      s->syscalls += sim_bus[p].stats.syscalls;
+   }
+}
+
+//--------------------------------------------------------------------------
+// Parse a serial number, 12 hex digits (family and CRC are added) or all
+// 16 digits as DigiTemp prints them
+//
+static int sim_parse_rom(char *str, int family, unsigned char *rom)
+{
+   char hex[3];
+   int i, len;
+
+   if (str == NULL)
+      return FALSE;
+
+   len = strlen(str);
+   if ((len != 12) && (len != 16))
+      return FALSE;
+   if (strspn(str, "0123456789abcdefABCDEF") != len)
+      return FALSE;
+
+   hex[2] = 0;
+   for (i = 0; i < len / 2; i++)
+   {
+      hex[0] = str[i * 2];
+      hex[1] = str[i * 2 + 1];
+      rom[(len == 12) ? i + 1 : i] = (unsigned char) strtol(hex, NULL, 16);
+   }
+
+   if (len == 12)
+   {
+      rom[0] = family;
+      rom[7] = sim_crc8(rom, 7);
+   }
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// Set up a new device with its power-on state
+//
+static void sim_new_device(struct sim_dev *d, int coupler, int branch)
+{
+   memset(d, 0, sizeof(struct sim_dev));
+   d->coupler = coupler;
+   d->branch = branch;
+   d->temp = 20.0;
+   d->humidity = 50.0;
+   d->vdd = 5.0;
+   d->vad = 2.5;
+   d->crc_errors = -1;
+   d->lines = -1;
+   d->new_lines = -1;
+
+   // DS18x20 scratchpad: 85C, TH 75, TL 70, 12 bits
+   d->scratch[2] = d->eeprom[0] = 0x4B;
+   d->scratch[3] = d->eeprom[1] = 0x46;
+   d->scratch[4] = d->eeprom[2] = 0x7F;
+   d->scratch[5] = 0xFF;
+   d->scratch[6] = 0x0C;
+   d->scratch[7] = 0x10;
+
+   // DS2438 IAD, CA, EE and AD set
+   d->page[0][0] = 0x0F;
+}
+
+//--------------------------------------------------------------------------
+// Load a bus description
+//
+//  # comment
+//  <type> <serial> [options]     A device, type is DS18B20, DS1822,
+//                                DS28EA00, DS1820, DS18S20, DS2438,
+//                                DS2423, DS1923 or DS2409
+//  BRANCH <serial> MAIN|AUX      Following devices are behind a DS2409
+//  BRANCH NONE                   Following devices are on the main bus
+//  CRC_ERRORS <percent>          Corrupt this many CRC protected reads
+//  SEED <n>                      Random number seed
+//  BIT_US <uS>                   Length of a time slot
+//  RESET_US <uS>                 Length of a reset
+//  REALTIME 1                    msDelay really sleeps
+//
+//  Device options are TEMP <C>, HUMIDITY <%RH>, VDD <V>, VAD <V>,
+//  VSENS <mV>, COUNT_A <n>, COUNT_B <n>, RATE_A <n/s>, RATE_B <n/s>,
+//  RES <9-12>, CONVERT <mS>, CRC_ERRORS <percent> and PARASITE
+//
+// Returns: TRUE if the file was loaded
+//
+int sim_load(char *fname)
+{
+   static struct {
+      char *name;
+      int  family;
+   } types[] = {
+      { "DS18B20", SIM_DS18B20 },
+      { "DS1822",  SIM_DS1822 },
+      { "DS28EA00", SIM_DS28EA00 },
+      { "DS1820",  SIM_DS1820 },
+      { "DS18S20", SIM_DS1820 },
+      { "DS2438",  SIM_DS2438 },
+      { "DS2423",  SIM_DS2423 },
+      { "DS1923",  SIM_DS1923 },
+      { "DS2409",  SIM_DS2409 },
+      { NULL, 0 }
+   };
+   FILE *fp;
+   char line[1024], *ptr, *val;
+   unsigned char rom[8];
+   int lineno = 0, coupler = -1, branch = SIM_BRANCH_MAIN, i, res;
+   struct sim_dev *d;
+
+   if ((fp = fopen(fname, "r")) == NULL)
+   {
+      perror("sim: failed to open bus file");
+      return FALSE;
+   }
+
+   sim->ndev = 0;
+   sim->now_us = 0.0;
+   sim->strong = FALSE;
+   sim->crc_errors = 0;
+   sim->seed = 1;
+   sim->reset_us = SIM_RESET_US;
+   sim->bit_us = SIM_BIT_US;
+   sim->realtime = FALSE;
+   memset(&sim->stats, 0, sizeof(sim->stats));
+
+   while (fgets(line, sizeof(line), fp) != NULL)
+   {
+      lineno++;
+      if ((ptr = strchr(line, '#')) != NULL)
+         *ptr = 0;
+      if ((ptr = strtok(line, " \t\r\n")) == NULL)
+         continue;
+
+      val = strtok(NULL, " \t\r\n");
+
+      if (strcasecmp(ptr, "BRANCH") == 0)
+      {
+         if ((val != NULL) && (strcasecmp(val, "NONE") == 0))
+         {
+            coupler = -1;
+            continue;
+         }
+         if (!sim_parse_rom(val, SIM_DS2409, rom))
+            goto bad_line;
+         for (coupler = 0; coupler < sim->ndev; coupler++)
+         {
+            if ((sim->dev[coupler].rom[0] == SIM_DS2409) &&
+                (memcmp(sim->dev[coupler].rom, rom, 8) == 0))
+               break;
+         }
+         if (coupler == sim->ndev)
+         {
+            fprintf(stderr, "sim: %s line %d: no DS2409 %s\n", fname, lineno, val);
+            fclose(fp);
+            return FALSE;
+         }
+         if ((val = strtok(NULL, " \t\r\n")) == NULL)
+            goto bad_line;
+         if (strcasecmp(val, "MAIN") == 0)
+            branch = SIM_BRANCH_MAIN;
+         else if (strcasecmp(val, "AUX") == 0)
+            branch = SIM_BRANCH_AUX;
+         else
+            goto bad_line;
+         continue;
+      }
+
+      if (val == NULL)
+         goto bad_line;
+
+      if (strcasecmp(ptr, "CRC_ERRORS") == 0)
+         sim->crc_errors = atoi(val);
+      else if (strcasecmp(ptr, "SEED") == 0)
+         sim->seed = strtoul(val, NULL, 0);
+      else if (strcasecmp(ptr, "BIT_US") == 0)
+         sim->bit_us = atoi(val);
+      else if (strcasecmp(ptr, "RESET_US") == 0)
+         sim->reset_us = atoi(val);
+      else if (strcasecmp(ptr, "REALTIME") == 0)
+         sim->realtime = atoi(val);
+      else
+      {
+         for (i = 0; types[i].name != NULL; i++)
+         {
+            if (strcasecmp(ptr, types[i].name) == 0)
+               break;
+         }
+         if (types[i].name == NULL)
+            goto bad_line;
+
+         if (sim->ndev == SIM_MAX_DEVICES)
+         {
+            fprintf(stderr, "sim: %s line %d: too many devices\n", fname, lineno);
+            fclose(fp);
+            return FALSE;
+         }
+
+         d = &sim->dev[sim->ndev];
+         sim_new_device(d, coupler, branch);
+         if (!sim_parse_rom(val, types[i].family, d->rom))
+            goto bad_line;
+
+         // Options
+         while ((ptr = strtok(NULL, " \t\r\n")) != NULL)
+         {
+            if (strcasecmp(ptr, "PARASITE") == 0)
+            {
+               d->parasite = TRUE;
+               continue;
+            }
+            if ((val = strtok(NULL, " \t\r\n")) == NULL)
+               goto bad_line;
+
+            if (strcasecmp(ptr, "TEMP") == 0)
+               d->temp = atof(val);
+            else if (strcasecmp(ptr, "HUMIDITY") == 0)
+               d->humidity = atof(val);
+            else if (strcasecmp(ptr, "VDD") == 0)
+               d->vdd = atof(val);
+            else if (strcasecmp(ptr, "VAD") == 0)
+               d->vad = atof(val);
+            else if (strcasecmp(ptr, "VSENS") == 0)
+               d->vsens = atof(val);
+            else if (strcasecmp(ptr, "COUNT_A") == 0)
+               d->count[0] = atof(val);
+            else if (strcasecmp(ptr, "COUNT_B") == 0)
+               d->count[1] = atof(val);
+            else if (strcasecmp(ptr, "RATE_A") == 0)
+               d->rate[0] = atof(val);
+            else if (strcasecmp(ptr, "RATE_B") == 0)
+               d->rate[1] = atof(val);
+            else if (strcasecmp(ptr, "CONVERT") == 0)
+               d->convert_ms = atoi(val);
+            else if (strcasecmp(ptr, "CRC_ERRORS") == 0)
+               d->crc_errors = atoi(val);
+            else if (strcasecmp(ptr, "RES") == 0)
+            {
+               res = atoi(val);
+               if ((res < 9) || (res > 12))
+                  goto bad_line;
+               d->scratch[4] = d->eeprom[2] = ((res - 9) << 5) | 0x1F;
+            }
+            else
+               goto bad_line;
+         }
+         sim->ndev++;
+      }
+   }
+   fclose(fp);
+
+   if (sim->ndev == 0)
+   {
+      fprintf(stderr, "sim: %s has no devices\n", fname);
+      return FALSE;
+   }
+   return TRUE;
+
+bad_line:
+   fprintf(stderr, "sim: %s line %d: syntax error\n", fname, lineno);
+   fclose(fp);
+   return FALSE;
+}
+
+//--------------------------------------------------------------------------
+// Forget the bus
+//
+void sim_free(void)
+{
+   sim->ndev = 0;
+}
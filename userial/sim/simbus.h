@@ -0,0 +1,129 @@
+//---------------------------------------------------------------------------
+// Simulated 1-Wire bus for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  simbus.h - In-memory 1-Wire bus model used by the simulated adapter.
+//
+//  The bus is described by a text file that is passed in place of the
+//  serial port (TTY in .digitemprc or -s). The format is in the README.
+//  Each port has its own bus, so several TTY lines each get one.
+//
+
+// Default bus timing in microseconds, standard speed
+#define SIM_RESET_US      960
+#define SIM_BIT_US        70
+
+#define SIM_MAX_DEVICES   256
+
+// Family codes of the simulated devices
+#define SIM_DS1820        0x10
+#define SIM_DS1822        0x22
+#define SIM_DS18B20       0x28
+#define SIM_DS28EA00      0x42
+#define SIM_DS1923        0x41
+#define SIM_DS2423        0x1D
+#define SIM_DS2438        0x26
+#define SIM_DS2409        0x1F
+
+// Device state while talking on the bus
+#define SIM_IDLE          0     // Waiting for a reset
+#define SIM_ROM           1     // Receiving the ROM command
+#define SIM_MATCH         2     // Receiving a Match ROM serial number
+#define SIM_SEARCH        3     // Taking part in a search
+#define SIM_CMD           4     // Selected, receiving the function command
+#define SIM_FUNC          5     // Running a function command
+
+// Branch a device is connected to
+#define SIM_MAIN_BUS      -1    // Not behind a coupler
+#define SIM_BRANCH_MAIN   0
+#define SIM_BRANCH_AUX    1
+
+struct sim_dev {
+   unsigned char rom[8];        // Family, serial number and CRC
+   int      coupler;            // Index of the DS2409 it is behind, or -1
+   int      branch;             // SIM_BRANCH_MAIN or SIM_BRANCH_AUX
+
+   // Settings from the bus file
+   double   temp;               // Degrees C
+   double   humidity;           // %RH, DS1923
+   double   vdd;                // Volts, DS2438
+   double   vad;                // Volts, DS2438
+   double   vsens;              // mV, DS2438
+   double   count[2];           // DS2423 counters A and B
+   double   rate[2];            // DS2423 counts per second
+   int      parasite;           // Parasite powered
+   int      convert_ms;         // Conversion time, 0 uses the default
+   int      crc_errors;         // Percent of CRC reads to corrupt, -1 global
+
+   // Bus state
+   int      state;
+   int      bit;                // Bit number in the current byte or ROM
+   int      phase;              // Search phase for the current bit
+   unsigned char rx;            // Byte being received
+   unsigned char cmd;           // Current function command
+   unsigned char args[16];      // Bytes received after the command
+   int      nargs;
+   unsigned char tx[64];        // Bytes to send in read slots
+   int      tx_bits;            // Number of bits in tx
+   int      tx_pos;             // Next bit to send
+   double   busy_until;         // Read slots return 0 until then (uS)
+   int      converting;         // A conversion is running
+   double   convert_done;       // When the conversion finishes (uS)
+   int      convert_kind;       // What is being converted
+   double   convert_start;      // When it started (uS)
+   int      powered;            // Parasite device got its strong pullup
+
+   // Device memory
+   unsigned char scratch[9];    // DS18x20 scratchpad
+   unsigned char eeprom[3];     // DS18x20 TH, TL and config
+   unsigned char page[8][8];    // DS2438 memory pages
+   unsigned char spad[8][8];    // DS2438 scratchpad pages
+   unsigned char mem[32];       // DS1923 register page 0x0200
+   int      lines;              // DS2409 branch that is on, -1 for none
+   int      new_lines;          // Branch to switch to after confirming
+   int      smart;              // Reset the branch when it is switched on
+   int      switching;          // Switch at the end of this time slot
+   unsigned char status;        // DS2409 status byte
+};
+
+// Counters for benchmarking
+struct sim_stats {
+   double   bus_us;             // Simulated time spent on the bus
+   double   delay_us;           // Simulated time spent in msDelay
+   long     resets;
+   long     bits;               // Time slots, including the ones in bytes
+   long     strong;             // Strong pullups
+   long     crc_errors;         // CRC errors injected
+   long     transactions;       // Link layer calls (resets, bits and bytes)
+   long     syscalls;           // System calls made while simulating
+};
+
+// A simulated bus, one for each port
+struct sim_bus {
+   struct sim_dev dev[SIM_MAX_DEVICES];
+   int      ndev;
+   int      conn[SIM_MAX_DEVICES];  // Devices connected in this time slot
+   double   now_us;             // Simulated time in uS
+   int      strong;             // Strong pullup is on
+   int      crc_errors;         // Percent of CRC reads to corrupt
+   unsigned long seed;
+   int      reset_us;
+   int      bit_us;
+   int      realtime;           // msDelay really sleeps
+   struct sim_stats stats;
+};
+
+void   sim_select(int portnum);
+int    sim_load(char *fname);
+void   sim_free(void);
+int    sim_reset(void);
+int    sim_touch_bit(int sbit);
+void   sim_level(int strong);
+void   sim_delay(double us);
+double sim_now(void);
+void   sim_get_stats(struct sim_stats *stats);
+int    sim_realtime(void);
+void   sim_transaction(void);
@@ -0,0 +1,236 @@
+//---------------------------------------------------------------------------
+// Simulated 1-Wire adapter for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  simlnk.c - Link layer functions for the simulated adapter. These are
+//             the same functions linuxlnk.c provides for the DS9097, so
+//             the network and transport layers from userial/ds9097 are
+//             used unchanged on top of the simulated bus.
+//
+//             Each port has its own bus. The functions that talk to it
+//             select it for the calling thread, msDelay and msGettick
+//             use the one the thread last talked to.
+//
+
+#include "ownet.h"
+#include "simbus.h"
+
+// exportable link-level functions
+SMALLINT owTouchReset(int);
+SMALLINT owTouchBit(int,SMALLINT);
+SMALLINT owTouchByte(int,SMALLINT);
+SMALLINT owWriteByte(int,SMALLINT);
+SMALLINT owReadByte(int);
+SMALLINT owSpeed(int,SMALLINT);
+SMALLINT owLevel(int,SMALLINT);
+SMALLINT owProgramPulse(int);
+void msDelay(int);
+long msGettick(void);
+SMALLINT hasPowerDelivery(int);
+SMALLINT hasOverDrive(int);
+SMALLINT hasProgramPulse(int);
+SMALLINT owWriteBytePower(int,SMALLINT);
+SMALLINT owReadBitPower(int, SMALLINT);
+void owTouchBlock(int,int,int,uchar *);
+
+
+//--------------------------------------------------------------------------
+// Reset all of the devices on the 1-Wire Net and return the result.
+//
+// Returns: TRUE(1):  presense pulse(s) detected, device(s) reset
+//          FALSE(0): no presense pulses detected
+//
+SMALLINT owTouchReset(int portnum)
+{
+   sim_select(portnum);
+   sim_transaction();
+   return sim_reset();
+}
+
+//--------------------------------------------------------------------------
+// Send 1 bit of communication to the 1-Wire Net and return the
+// result 1 bit read from the 1-Wire Net.
+//
+SMALLINT owTouchBit(int portnum, SMALLINT sbit)
+{
+   sim_select(portnum);
+   sim_transaction();
+   return sim_touch_bit(sbit & 0x01);
+}
+
+//--------------------------------------------------------------------------
+// Send 8 bits of communication to the 1-Wire Net and return the
+// result 8 bits read from the 1-Wire Net, least significant bit first.
+//
+SMALLINT owTouchByte(int portnum, SMALLINT sendbyte)
+{
+   SMALLINT result = 0;
+   int i;
+
+   sim_select(portnum);
+   sim_transaction();
+   for (i = 0; i < 8; i++)
+      result |= sim_touch_bit((sendbyte >> i) & 0x01) << i;
+
+   return result;
+}
+
+//--------------------------------------------------------------------------
+// Send 'nbits' bits from 'transfer_buf', least significant bit of each
+// byte first, and replace them with the bits read back.  One transaction,
+// like the DS9097's one write and read for the whole block.  'timeout' is
+// only used by the real adapter.
+//
+void owTouchBlock(int portnum, int timeout, int nbits, uchar *transfer_buf)
+{
+   uchar inch = 0;
+   int i;
+
+   sim_select(portnum);
+   sim_transaction();
+   for (i = 0; i < nbits; i++)
+   {
+      inch |= sim_touch_bit((transfer_buf[i / 8] >> (i % 8)) & 0x01) << (i % 8);
+      if (((i % 8) == 7) || (i == nbits - 1))
+      {
+         transfer_buf[i / 8] = inch;
+         inch = 0;
+      }
+   }
+}
+
+//--------------------------------------------------------------------------
+// Send 8 bits of communication to the 1-Wire Net and verify that the
+// 8 bits read from the 1-Wire Net is the same (write operation).
+//
+// Returns:  TRUE: bytes written and echo was the same
+//           FALSE: echo was not the same
+//
+SMALLINT owWriteByte(int portnum, SMALLINT sendbyte)
+{
+   return (owTouchByte(portnum,sendbyte) == sendbyte) ? TRUE : FALSE;
+}
+
+//--------------------------------------------------------------------------
+// Send 8 bits of read communication to the 1-Wire Net and and return the
+// resulting 8 bits read from the 1-Wire Net.
+//
+SMALLINT owReadByte(int portnum)
+{
+   return owTouchByte(portnum,0xFF);
+}
+
+//--------------------------------------------------------------------------
+// The simulated bus only runs at normal speed
+//
+SMALLINT owSpeed(int portnum, SMALLINT new_speed)
+{
+   return MODE_NORMAL;
+}
+
+//--------------------------------------------------------------------------
+// Turn the strong pullup on or off. Parasite powered devices only finish
+// a conversion properly while it is on.
+//
+SMALLINT owLevel(int portnum, SMALLINT new_level)
+{
+   sim_select(portnum);
+   if (new_level == MODE_STRONG5)
+   {
+      sim_level(TRUE);
+      return MODE_STRONG5;
+   }
+
+   sim_level(FALSE);
+   return MODE_NORMAL;
+}
+
+//--------------------------------------------------------------------------
+// No EPROM programming
+//
+SMALLINT owProgramPulse(int portnum)
+{
+   return FALSE;
+}
+
+//--------------------------------------------------------------------------
+// Delay for at least 'len' ms. This only moves the simulated clock unless
+// the bus file asked for REALTIME.
+//
+void msDelay(int len)
+{
+   sim_delay(len * 1000.0);
+}
+
+//--------------------------------------------------------------------------
+// Get the current millisecond tick count from the simulated clock
+//
+long msGettick(void)
+{
+   return (long)(sim_now() / 1000.0);
+}
+
+//--------------------------------------------------------------------------
+// Send 8 bits of communication to the 1-Wire Net and verify that the
+// 8 bits read from the 1-Wire Net is the same (write operation).
+// After the 8 bits are sent change the level of the 1-Wire net.
+//
+// Returns:  TRUE: bytes written and echo was the same
+//           FALSE: echo was not the same
+//
+SMALLINT owWriteBytePower(int portnum, SMALLINT sendbyte)
+{
+   if(owTouchByte(portnum,sendbyte) != sendbyte)
+     return FALSE;
+
+   if(owLevel(portnum,MODE_STRONG5) != MODE_STRONG5)
+     return FALSE;
+
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// Send 1 bit of communication to the 1-Wire Net and verify that the
+// response matches the 'applyPowerResponse' bit and apply power delivery
+// to the 1-Wire net.
+//
+// Returns:  TRUE: bit written and response correct, strong pullup now on
+//           FALSE: response incorrect
+//
+SMALLINT owReadBitPower(int portnum, SMALLINT applyPowerResponse)
+{
+   if(owTouchBit(portnum, 0x01) != applyPowerResponse)
+     return FALSE;
+
+   if(owLevel(portnum, MODE_STRONG5) != MODE_STRONG5)
+     return FALSE;
+
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// The simulated adapter can power parasite devices
+//
+SMALLINT hasPowerDelivery(int portnum)
+{
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// No OverDrive
+//
+SMALLINT hasOverDrive(int portnum)
+{
+   return FALSE;
+}
+
+//--------------------------------------------------------------------------
+// No EPROM programming
+//
+SMALLINT hasProgramPulse(int portnum)
+{
+   return FALSE;
+}
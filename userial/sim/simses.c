@@ -0,0 +1,44 @@
+//---------------------------------------------------------------------------
+// Simulated 1-Wire adapter for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  simses.c - Session functions for the simulated adapter. The 'port' is
+//             the name of a bus description file.
+//
+
+#include "ownet.h"
+#include "simbus.h"
+
+// exportable functions
+SMALLINT owAcquire(int,char *);
+void     owRelease(int);
+
+
+//---------------------------------------------------------------------------
+// Attempt to acquire a 1-Wire net. Load the bus described in 'port_zstr'.
+//
+// Returns: TRUE - success, bus loaded
+//          FALSE - failure, the file could not be read
+//
+SMALLINT owAcquire(int portnum, char *port_zstr)
+{
+   sim_select(portnum);
+   if (!sim_load(port_zstr))
+   {
+      OWERROR(OWERROR_GET_SYSTEM_RESOURCE_FAILED);
+      return FALSE;
+   }
+   return TRUE;
+}
+
+//---------------------------------------------------------------------------
+// Release the previously acquired 1-Wire net.
+//
+void owRelease(int portnum)
+{
+   sim_select(portnum);
+   sim_free();
+}
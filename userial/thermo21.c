@@ -32,6 +32,8 @@
 //           1.03 -> 2.00  Reorganization of Public Domain Kit 
 //                         Convert to global CRC utility functions
 //                         Y2K fix.
+//           2.00 -> 2.01  ReadPages streams the pages with
+//                         owReadMemoryCRC instead of a block per page.
 
 #include "ownet.h"
 #include "thermo21.h"   
@@ -110,6 +112,7 @@ extern SMALLINT owOverdriveAccess(int);
 
 // external One Wire functions from transaction layer
 extern SMALLINT owBlock(int,SMALLINT,uchar *,SMALLINT);
+extern int      owReadMemoryCRC(int,uchar,int,int,int,uchar *);
 
 // external One Wire functions from link layer
 extern SMALLINT owTouchReset(int);
@@ -506,19 +509,17 @@ int ThermoStep(int portnum, ThermoStateType *ThermoState,
 //----------------------------------------------------------------------
 //  Read a specified number of pages in overdrive
 //
+//  The pages are streamed with one Read Memory with CRC command by
+//  owReadMemoryCRC().  'last_pg' is moved past every good page, so a
+//  retry after a CRC error starts where this one stopped.
+//
 // 'portnum'  - number 0 to MAX_PORTNUM-1.  This number is provided to
 //              indicate the symbolic port number.
 //
 int ReadPages(int portnum, int start_pg, int num_pgs, int *last_pg, uchar *finalbuf)
 {
-   int skip_overaccess = 0, skip_access = 0;
-   uchar pkt[60];
-   int len,i;
-   uchar  SerialNumber[8];
-   ushort lastcrc16;
-	
-   // read the rom number 
-   owSerialNum(portnum,SerialNumber,TRUE);
+   int skip_overaccess = 0;
+   int pages,rslt;
 
 #ifndef __MC68K__
    // verify device is in overdrive
@@ -537,65 +538,14 @@ int ReadPages(int portnum, int start_pg, int num_pgs, int *last_pg, uchar *final
    }
 #endif
 
-   // loop while there is pages to read
-   do
-   {
-      // create a packet to read a page
-      len = 0;
-      setcrc16(portnum,0);
-      // optional skip access on subsequent pages 
-      if (!skip_access)
-      {  
-         // match
-         pkt[len++] = 0x55; 
-         // rom number
-         for (i = 0; i < 8; i++)
-            pkt[len++] = SerialNumber[i];
-         // read memory with crc command 
-         pkt[len] = 0xA5; 
-         docrc16(portnum,pkt[len++]);         
-         // address
-         pkt[len] = (uchar)((*last_pg << 5) & 0xFF);
-         docrc16(portnum,pkt[len++]);         
-         pkt[len] = (uchar)(*last_pg >> 3); 
-         docrc16(portnum,pkt[len++]);         
-      }
-
-      // set 32 reads for data and 2 for crc
-      for (i = 0; i < 34; i++)
-         pkt[len++] = 0xFF; 
-         
-      // send the bytes
-      if (owBlock(portnum,!skip_access,pkt,len))
-      {
-         // calucate the CRC over the last 34 bytes
-         for (i = 0; i < 34; i++)
-            lastcrc16 = docrc16(portnum,pkt[len - 34 + i]);
-
-         // check crc
-         if (lastcrc16 == 0xB001)
-         {
-            // copy the data into the buffer
-            for (i = 0; i < 32; i++)
-               finalbuf[i + (*last_pg - start_pg) * 32] = pkt[len - 34 + i];
-
-            // change number of pages 
-            *last_pg = *last_pg + 1;
-
-            // now skip access 
-            skip_access = TRUE;
-         }
-         else
-            return FALSE;
-
-      }
-      else
-         return FALSE;
-
-   }
-   while ((*last_pg - start_pg) < num_pgs);
+   // read the rest of the pages with read memory with crc
+   pages = num_pgs - (*last_pg - start_pg);
+   rslt = owReadMemoryCRC(portnum, 0xA5, *last_pg << 5, 32, pages,
+                          &finalbuf[(*last_pg - start_pg) * 32]);
+   if (rslt > 0)
+      *last_pg = *last_pg + rslt;
 
-   return TRUE;
+   return (rslt == pages);
 }
 
 //----------------------------------------------------------------------------}
@@ -0,0 +1,308 @@
+//---------------------------------------------------------------------------
+// Linux kernel w1 bus master adapter for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  ownet.c - Network functions for the kernel's w1 bus masters.
+//
+//            The kernel searches the whole 1-Wire Net with one command
+//            and sends back every ROM it found, owFirst() asks for them
+//            and owNext() hands them out in the order the bit by bit
+//            search would find them. There are no single bit time slots
+//            to search with, so a search always starts with a reset.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ownet.h"
+#include "owproto.h"
+#include "w1lnk.h"
+
+// exportable functions defined in ownet.c
+SMALLINT owFirst(int,SMALLINT,SMALLINT);
+SMALLINT owNext(int,SMALLINT,SMALLINT);
+void     owSerialNum(int,uchar *,SMALLINT);
+void     owFamilySearchSetup(int,SMALLINT);
+void     owSkipFamily(int);
+SMALLINT owAccess(int);
+SMALLINT owVerify(int,SMALLINT);
+SMALLINT owOverdriveAccess(int);
+
+// global variables for this module to hold search state information
+uchar SerialNum[MAX_PORTNUM][8];
+
+// ROMs from the last search, handed out by owNext
+static uchar SearchROM[MAX_PORTNUM][W1_SEARCH_MAX][8];
+static int SearchCount[MAX_PORTNUM];
+static int SearchPos[MAX_PORTNUM];
+static SMALLINT SearchValid[MAX_PORTNUM];
+static SMALLINT SearchAlarm[MAX_PORTNUM];
+static SMALLINT SearchSeek[MAX_PORTNUM];
+
+
+//--------------------------------------------------------------------------
+// Compare two ROMs in search order, the first bit sent is the first
+// compared.
+//
+static int rom_order(const void *a, const void *b)
+{
+   const uchar *ra = a, *rb = b;
+   int i, ba, bb;
+
+   for (i = 0; i < 64; i++)
+   {
+      ba = (ra[i / 8] >> (i % 8)) & 0x01;
+      bb = (rb[i / 8] >> (i % 8)) & 0x01;
+      if (ba != bb)
+         return ba - bb;
+   }
+
+   return 0;
+}
+
+//--------------------------------------------------------------------------
+// Search the 1-Wire Net for 'roms', room for W1_SEARCH_MAX of them, and
+// keep the ones with a good CRC8 in search order.
+//
+// Returns: the number of ROMs found, -1 if the search failed
+//
+static int owSearchAll(int portnum, SMALLINT alarm_only, uchar *roms)
+{
+   struct w1_tran t;
+   uchar lastcrc8 = 0;
+   int i, j, num = 0;
+
+   w1_begin(&t);
+   w1_add(&t, alarm_only ? W1_CMD_ALARM_SEARCH : W1_CMD_SEARCH, roms,
+          W1_SEARCH_MAX * 8);
+   if (!w1_run(portnum, &t))
+   {
+      OWERROR(OWERROR_SEARCH_ERROR);
+      return -1;
+   }
+
+   for (i = 0; i < t.num_roms; i++)
+   {
+      setcrc8(portnum, 0);
+      for (j = 0; j < 8; j++)
+         lastcrc8 = docrc8(portnum, roms[i * 8 + j]);
+      if (lastcrc8 || !roms[i * 8])
+         continue;
+
+      memmove(&roms[num++ * 8], &roms[i * 8], 8);
+   }
+
+   qsort(roms, num, 8, rom_order);
+   return num;
+}
+
+//--------------------------------------------------------------------------
+// The 'owFirst' finds the first device on the 1-Wire Net.  When
+// 'alarm_only' is TRUE (1) only devices in an alarm state are found.
+//
+// 'portnum'    - number 0 to MAX_PORTNUM-1.  This number is provided to
+//                indicate the symbolic port number.
+// 'do_reset'   - the kernel always resets before a search
+// 'alarm_only' - TRUE (1) the find alarm command 0xEC is
+//                sent instead of the normal search command 0xF0
+//
+// Returns:   TRUE (1) : when a 1-Wire device was found and it's
+//                        Serial Number placed in the global SerialNum[portnum]
+//            FALSE (0): There are no devices on the 1-Wire Net.
+//
+SMALLINT owFirst(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
+{
+   SearchValid[portnum] = FALSE;
+   SearchSeek[portnum] = FALSE;
+
+   return owNext(portnum,do_reset,alarm_only);
+}
+
+//--------------------------------------------------------------------------
+// The 'owNext' function hands out the next ROM of the last search.  The
+// first call searches, and so does a call after the last ROM was handed
+// out.  After owFamilySearchSetup it starts with the first ROM that the
+// bit by bit search would have found from SerialNum[portnum].
+//
+// 'portnum'    - number 0 to MAX_PORTNUM-1.  This number is provided to
+//                indicate the symbolic port number.
+// 'do_reset'   - the kernel always resets before a search
+// 'alarm_only' - TRUE (1) the find alarm command 0xEC is
+//                sent instead of the normal search command 0xF0
+//
+// Returns:   TRUE (1) : when a 1-Wire device was found and it's
+//                       Serial Number placed in the global SerialNum[portnum]
+//            FALSE (0): when no new device was found.  Either the
+//                       last search was the last device or there
+//                       are no devices on the 1-Wire Net.
+//
+SMALLINT owNext(int portnum, SMALLINT do_reset, SMALLINT alarm_only)
+{
+   int num;
+
+   if (!SearchValid[portnum] || (SearchAlarm[portnum] != alarm_only))
+   {
+      SearchCount[portnum] = 0;
+      SearchPos[portnum] = 0;
+      SearchAlarm[portnum] = alarm_only;
+
+      num = owSearchAll(portnum,alarm_only,&SearchROM[portnum][0][0]);
+      if (num <= 0)
+      {
+         if (num == 0)
+            OWERROR(OWERROR_NO_DEVICES_ON_NET);
+         SearchSeek[portnum] = FALSE;
+         return FALSE;
+      }
+      SearchCount[portnum] = num;
+      SearchValid[portnum] = TRUE;
+   }
+
+   if (SearchSeek[portnum])
+   {
+      while ((SearchPos[portnum] < SearchCount[portnum]) &&
+             (rom_order(SearchROM[portnum][SearchPos[portnum]],SerialNum[portnum]) < 0))
+         SearchPos[portnum]++;
+      SearchSeek[portnum] = FALSE;
+   }
+
+   // the last one was handed out, the next call is like a first
+   if (SearchPos[portnum] >= SearchCount[portnum])
+   {
+      SearchValid[portnum] = FALSE;
+      return FALSE;
+   }
+
+   memcpy(SerialNum[portnum],SearchROM[portnum][SearchPos[portnum]++],8);
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// The 'owSerialNum' function either reads or sets the SerialNum buffer
+// that is used in the search functions 'owFirst' and 'owNext'.
+//
+// 'portnum'       - number 0 to MAX_PORTNUM-1.  This number is provided to
+//                   indicate the symbolic port number.
+// 'serialnum_buf' - buffer to that contains the serial number to set
+//                   when do_read = FALSE (0) and buffer to get the serial
+//                   number when do_read = TRUE (1).
+// 'do_read'       - flag to indicate reading (1) or setting (0) the current
+//                   serial number.
+//
+void owSerialNum(int portnum, uchar *serialnum_buf, SMALLINT do_read)
+{
+   if (do_read)
+      memcpy(serialnum_buf,SerialNum[portnum],8);
+   else
+      memcpy(SerialNum[portnum],serialnum_buf,8);
+}
+
+//--------------------------------------------------------------------------
+// Setup the search to find a certain family of devices the next time
+// 'owNext' is called.
+//
+// 'portnum'       - number 0 to MAX_PORTNUM-1.  This number is provided to
+//                   indicate the symbolic port number.
+// 'search_family' - family code type to set the search algorithm to find
+//                   next.
+//
+void owFamilySearchSetup(int portnum, SMALLINT search_family)
+{
+   SerialNum[portnum][0] = search_family;
+   memset(&SerialNum[portnum][1],0,7);
+
+   // search again and start with the first ROM of the family
+   SearchValid[portnum] = FALSE;
+   SearchSeek[portnum] = TRUE;
+}
+
+//--------------------------------------------------------------------------
+// Set the current search state to skip the current family code.
+//
+// 'portnum'     - number 0 to MAX_PORTNUM-1.  This number is provided to
+//                 indicate the symbolic port number.
+//
+void owSkipFamily(int portnum)
+{
+   if (SearchValid[portnum] && (SearchPos[portnum] > 0))
+   {
+      while ((SearchPos[portnum] < SearchCount[portnum]) &&
+             (SearchROM[portnum][SearchPos[portnum]][0] ==
+              SearchROM[portnum][SearchPos[portnum] - 1][0]))
+         SearchPos[portnum]++;
+   }
+}
+
+//--------------------------------------------------------------------------
+// The 'owAccess' function resets the 1-Wire and sends a MATCH Serial
+// Number command followed by the current SerialNum code, in one
+// transaction. After this function is complete the 1-Wire device is
+// ready to accept device-specific commands.
+//
+// 'portnum'     - number 0 to MAX_PORTNUM-1.  This number is provided to
+//                 indicate the symbolic port number.
+//
+// Returns:   TRUE (1) : reset indicates present and device is ready
+//                       for commands.
+//            FALSE (0): reset does not indicate presence
+//
+SMALLINT owAccess(int portnum)
+{
+   struct w1_tran t;
+   uchar sendpacket[9];
+
+   sendpacket[0] = 0x55;
+   memcpy(&sendpacket[1],SerialNum[portnum],8);
+
+   w1_begin(&t);
+   w1_add(&t,W1_CMD_RESET,NULL,0);
+   w1_add(&t,W1_CMD_WRITE,sendpacket,9);
+   return w1_run(portnum,&t);
+}
+
+//----------------------------------------------------------------------
+// The function 'owVerify' verifies that the current device
+// is in contact with the 1-Wire Net, by searching for it.  The ROMs
+// handed out by owNext are kept.
+//
+// 'portnum'     - number 0 to MAX_PORTNUM-1.  This number is provided to
+//                 indicate the symbolic port number.
+// 'alarm_only'  - TRUE (1) only find it if it is in an alarm state
+//
+// Returns:   TRUE (1) : when the 1-Wire device was verified
+//                       to be on the 1-Wire Net
+//                       with alarm_only == FALSE
+//                       or verified to be on the 1-Wire Net
+//                       AND in an alarm state when
+//                       alarm_only == TRUE.
+//            FALSE (0): the 1-Wire device was not on the
+//                       1-Wire Net or if alarm_only
+//                       == TRUE, the device may be on the
+//                       1-Wire Net but in a non-alarm state.
+//
+SMALLINT owVerify(int portnum, SMALLINT alarm_only)
+{
+   uchar roms[W1_SEARCH_MAX * 8];
+   int i, num;
+
+   num = owSearchAll(portnum,alarm_only,roms);
+   for (i = 0; i < num; i++)
+   {
+      if (!memcmp(&roms[i * 8],SerialNum[portnum],8))
+         return TRUE;
+   }
+
+   return FALSE;
+}
+
+//----------------------------------------------------------------------
+// The kernel's masters don't do overdrive
+//
+SMALLINT owOverdriveAccess(int portnum)
+{
+   OWERROR(OWERROR_FUNC_NOT_SUP);
+   return FALSE;
+}
@@ -0,0 +1,99 @@
+//---------------------------------------------------------------------------
+// Linux kernel w1 bus master adapter for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  owtran.c - Transport functions for the kernel's w1 bus masters. A
+//             block, with its reset and Match ROM, is one transaction.
+//
+
+#include <string.h>
+#include "ownet.h"
+#include "w1lnk.h"
+
+// global serial number of the current device, from ownet.c
+extern uchar SerialNum[MAX_PORTNUM][8];
+
+// external functions defined in w1lnk.c
+extern SMALLINT hasPowerDelivery(int);
+
+// exportable functions defined in owtran.c
+SMALLINT owBlock(int,SMALLINT,uchar *,SMALLINT);
+SMALLINT owAccessBlock(int,SMALLINT,uchar *,SMALLINT);
+
+
+//--------------------------------------------------------------------------
+// The 'owBlock' transfers a block of data to and from the
+// 1-Wire Net with an optional reset at the begining of communication.
+// The result is returned in the same buffer.
+//
+// 'do_reset' - cause a owTouchReset to occure at the begining of
+//              communication TRUE(1) or not FALSE(0)
+// 'tran_buf' - pointer to a block of unsigned
+//              chars of length 'tran_len' that will be sent
+//              to the 1-Wire Net
+// 'tran_len' - length in bytes to transfer
+// Supported devices: all
+//
+// Returns:   TRUE (1) : The optional reset returned a valid
+//                       presence (do_reset == TRUE) or there
+//                       was no reset required.
+//            FALSE (0): The reset did not return a valid presence
+//                       (do_reset == TRUE) or the block was too long
+//
+SMALLINT owBlock(int portnum, SMALLINT do_reset, uchar *tran_buf, SMALLINT tran_len)
+{
+   struct w1_tran t;
+
+   w1_begin(&t);
+   if (do_reset)
+      w1_add(&t,W1_CMD_RESET,NULL,0);
+   if (!w1_add(&t,W1_CMD_TOUCH,tran_buf,tran_len))
+      return FALSE;
+
+   return w1_run(portnum,&t);
+}
+
+//--------------------------------------------------------------------------
+// The 'owAccessBlock' resets the 1-Wire Net, selects the current device
+// with Match ROM and transfers a block of data to and from it, all in
+// one transaction.  The result is returned in the same buffer.
+//
+// 'power'    - the last byte needs the strong pullup TRUE(1) or not
+//              FALSE(0).  Only the thermometer files have it, the
+//              driver turns it on for the commands that need it.
+// 'tran_buf' - pointer to a block of unsigned
+//              chars of length 'tran_len' that will be sent
+//              to the 1-Wire Net
+// 'tran_len' - length in bytes to transfer
+// Supported devices: all
+//
+// Returns:   TRUE (1) : The device answered the reset and the block
+//                       was transferred.
+//            FALSE (0): The device could not be selected, the transfer
+//                       failed or there is no strong pullup.
+//
+SMALLINT owAccessBlock(int portnum, SMALLINT power, uchar *tran_buf, SMALLINT tran_len)
+{
+   struct w1_tran t;
+   uchar sendpacket[9];
+
+   if (power && !hasPowerDelivery(portnum))
+   {
+      OWERROR(OWERROR_POWER_NOT_AVAILABLE);
+      return FALSE;
+   }
+
+   sendpacket[0] = 0x55;
+   memcpy(&sendpacket[1],SerialNum[portnum],8);
+
+   w1_begin(&t);
+   w1_add(&t,W1_CMD_RESET,NULL,0);
+   w1_add(&t,W1_CMD_WRITE,sendpacket,9);
+   if (!w1_add(&t,W1_CMD_TOUCH,tran_buf,tran_len))
+      return FALSE;
+
+   return w1_run(portnum,&t);
+}
@@ -0,0 +1,534 @@
+//---------------------------------------------------------------------------
+// Linux kernel w1 bus master adapter for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  w1lnk.c - Transactions with the kernel's w1 bus master, and the link
+//            layer functions on top of them.
+//
+//            A transaction goes to the kernel as one W1_MASTER_CMD netlink
+//            message with a w1_netlink_cmd for each step. The kernel runs
+//            them in order while it holds the master, so its own searches
+//            can't get in between a reset, the Match ROM and the read
+//            that follows. It answers each command with a status message,
+//            and the bytes of a read or touch and the ROMs of a search
+//            come back in a message of their own before it.
+//
+//            The kernel only has byte reads and writes. A bit is a touch
+//            of a whole byte, DigiTemp only reads single bits, which is
+//            8 read slots that all return the same thing.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include "ownet.h"
+#include "w1lnk.h"
+
+// exportable link-level functions
+SMALLINT owTouchReset(int);
+SMALLINT owTouchBit(int,SMALLINT);
+SMALLINT owTouchByte(int,SMALLINT);
+SMALLINT owWriteByte(int,SMALLINT);
+SMALLINT owReadByte(int);
+SMALLINT owSpeed(int,SMALLINT);
+SMALLINT owLevel(int,SMALLINT);
+SMALLINT owProgramPulse(int);
+void msDelay(int);
+long msGettick(void);
+SMALLINT hasPowerDelivery(int);
+SMALLINT hasOverDrive(int);
+SMALLINT hasProgramPulse(int);
+SMALLINT owWriteBytePower(int,SMALLINT);
+SMALLINT owReadBitPower(int, SMALLINT);
+
+// the kernel's master of each port
+struct w1_port w1_port[MAX_PORTNUM];
+
+// Largest request and answer, the connector limits a message to 16k
+#define W1_SEND_SIZE    NLMSG_SPACE(sizeof(struct cn_msg) + \
+                        sizeof(struct w1_netlink_msg) + W1_TRAN_CMDS * \
+                        (sizeof(struct w1_netlink_cmd) + W1_BLOCK_MAX))
+#define W1_RECV_SIZE    (16384 + 256)
+
+// How long the kernel has to answer a transaction, and the first one
+// that checks it is there at all
+#define W1_TIMEOUT      5000
+#define W1_OPEN_TIMEOUT 1000
+
+
+//--------------------------------------------------------------------------
+// Start an empty transaction
+//
+void w1_begin(struct w1_tran *t)
+{
+   t->num = 0;
+   t->num_roms = 0;
+}
+
+//--------------------------------------------------------------------------
+// Add a command to the transaction. The bytes of a write, read or touch
+// are in 'data', a read or touch puts what it read there. A search puts
+// the ROMs it finds in 'data', 'len' is the room there is for them.
+//
+// Returns: TRUE - added
+//          FALSE - the transaction is full or 'len' is too big
+//
+SMALLINT w1_add(struct w1_tran *t, uchar cmd, uchar *data, int len)
+{
+   if ((t->num >= W1_TRAN_CMDS) ||
+       ((cmd != W1_CMD_SEARCH) && (cmd != W1_CMD_ALARM_SEARCH) &&
+        (len > W1_BLOCK_MAX)))
+   {
+      OWERROR(OWERROR_BLOCK_TOO_BIG);
+      return FALSE;
+   }
+
+   t->cmd[t->num].cmd = cmd;
+   t->cmd[t->num].data = data;
+   t->cmd[t->num].len = len;
+   t->num++;
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// Bytes a command sends to the kernel. Reads send as many as they want
+// back, the kernel reads into them.
+//
+static int w1_cmd_len(struct w1_tran *t, int i)
+{
+   switch (t->cmd[i].cmd)
+   {
+      case W1_CMD_READ:
+      case W1_CMD_WRITE:
+      case W1_CMD_TOUCH:
+         return t->cmd[i].len;
+   }
+   return 0;
+}
+
+//--------------------------------------------------------------------------
+// Send a transaction to the master of 'portnum' as one message
+//
+static SMALLINT w1_netlink_send(int portnum, struct w1_tran *t)
+{
+   struct w1_port *p = &w1_port[portnum];
+   uchar buf[W1_SEND_SIZE];
+   struct nlmsghdr *nlh;
+   struct cn_msg *cn;
+   struct w1_netlink_msg *msg;
+   struct w1_netlink_cmd *cmd;
+   int i, len = 0;
+
+   memset(buf, 0, NLMSG_SPACE(sizeof(*cn) + sizeof(*msg)));
+   nlh = (struct nlmsghdr *)buf;
+   cn = (struct cn_msg *)NLMSG_DATA(nlh);
+   msg = (struct w1_netlink_msg *)cn->data;
+
+   for (i = 0; i < t->num; i++)
+   {
+      cmd = (struct w1_netlink_cmd *)(msg->data + len);
+      cmd->cmd = t->cmd[i].cmd;
+      cmd->res = 0;
+      cmd->len = w1_cmd_len(t, i);
+      if (cmd->len)
+         memcpy(cmd->data, t->cmd[i].data, cmd->len);
+      len += sizeof(*cmd) + cmd->len;
+   }
+
+   msg->type = W1_MASTER_CMD;
+   msg->len = len;
+   msg->id.mst.id = p->master;
+
+   cn->id.idx = CN_W1_IDX;
+   cn->id.val = CN_W1_VAL;
+   cn->seq = ++p->seq;
+   cn->ack = 0;
+   cn->len = sizeof(*msg) + len;
+   cn->flags = 0;
+
+   nlh->nlmsg_len = NLMSG_LENGTH(sizeof(*cn) + cn->len);
+   nlh->nlmsg_type = NLMSG_DONE;
+   nlh->nlmsg_seq = p->seq;
+
+   p->syscalls++;
+   if (send(p->sock, buf, nlh->nlmsg_len, 0) != nlh->nlmsg_len)
+   {
+      OWERROR(OWERROR_WRITECOM_FAILED);
+      return FALSE;
+   }
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// Take the ROMs of a search answer, 8 bytes of the kernel's u64 each
+//
+static void w1_netlink_roms(struct w1_tran *t, int i, uchar *data, int len)
+{
+   unsigned long long id;
+   uchar *rom;
+   int j, b;
+
+   for (j = 0; (j + 8 <= len) && ((t->num_roms + 1) * 8 <= t->cmd[i].len); j += 8)
+   {
+      memcpy(&id, &data[j], 8);
+      rom = &t->cmd[i].data[t->num_roms++ * 8];
+      for (b = 0; b < 8; b++)
+         rom[b] = (uchar)(id >> (b * 8));
+   }
+}
+
+//--------------------------------------------------------------------------
+// Collect the answers to the transaction that was just sent, until every
+// command has its status. A reset without a presence pulse, or anything
+// else the kernel couldn't do, fails the transaction.
+//
+static SMALLINT w1_netlink_answer(int portnum, struct w1_tran *t, int timeout)
+{
+   struct w1_port *p = &w1_port[portnum];
+   uchar buf[W1_RECV_SIZE];
+   struct pollfd pfd;
+   struct nlmsghdr *nlh;
+   struct cn_msg *cn;
+   struct w1_netlink_msg *msg;
+   struct w1_netlink_cmd *cmd;
+   SMALLINT ok = TRUE;
+   int done = 0, n, off, left;
+   long start = msGettick();
+
+   // a transaction without commands gets one status for the message
+   while (done < (t->num ? t->num : 1))
+   {
+      left = timeout - (msGettick() - start);
+      pfd.fd = p->sock;
+      pfd.events = POLLIN;
+      p->syscalls += 2;
+      if ((left <= 0) || (poll(&pfd, 1, left) <= 0) ||
+          ((n = recv(p->sock, buf, sizeof(buf), 0)) <= 0))
+      {
+         OWERROR(OWERROR_READCOM_FAILED);
+         return FALSE;
+      }
+
+      for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, n); nlh = NLMSG_NEXT(nlh, n))
+      {
+         cn = (struct cn_msg *)NLMSG_DATA(nlh);
+         if ((nlh->nlmsg_type == NLMSG_ERROR) || (cn->id.idx != CN_W1_IDX) ||
+             (cn->id.val != CN_W1_VAL) || (cn->seq != p->seq))
+            continue;
+
+         for (off = 0; off + sizeof(*msg) <= cn->len; off += sizeof(*msg) + msg->len)
+         {
+            msg = (struct w1_netlink_msg *)(cn->data + off);
+            if ((off + sizeof(*msg) + msg->len > cn->len) ||
+                (msg->type != W1_MASTER_CMD))
+               break;
+
+            // the status of the message, no such master or no commands
+            if (msg->len < sizeof(*cmd))
+            {
+               if (msg->status)
+               {
+                  OWERROR(OWERROR_ACCESS_FAILED);
+                  return FALSE;
+               }
+               if (t->num == 0)
+                  done++;
+               continue;
+            }
+
+            cmd = (struct w1_netlink_cmd *)msg->data;
+            if ((done >= t->num) || (cmd->cmd != t->cmd[done].cmd))
+               continue;
+
+            if (cmd->len == 0)
+            {
+               // the status of a command, the kernel's errno
+               if (msg->status && ok)
+               {
+                  if (cmd->cmd == W1_CMD_RESET)
+                     OWERROR(OWERROR_NO_DEVICES_ON_NET);
+                  else
+                     OWERROR(OWERROR_BLOCK_FAILED);
+                  ok = FALSE;
+               }
+               done++;
+            }
+            else if ((cmd->cmd == W1_CMD_SEARCH) || (cmd->cmd == W1_CMD_ALARM_SEARCH))
+               w1_netlink_roms(t, done, cmd->data, cmd->len);
+            else if (cmd->len == t->cmd[done].len)
+               memcpy(t->cmd[done].data, cmd->data, cmd->len);
+         }
+      }
+   }
+
+   return ok;
+}
+
+//--------------------------------------------------------------------------
+// Run a transaction on the 1-Wire Net of 'portnum', through netlink or
+// the thermometer files
+//
+// Returns: TRUE - every command was done
+//          FALSE - a reset found no devices or a command failed
+//
+SMALLINT w1_run(int portnum, struct w1_tran *t)
+{
+   w1_port[portnum].transactions++;
+
+   if (w1_port[portnum].sock < 0)
+      return w1_sysfs_run(portnum, t);
+
+   if (!w1_netlink_send(portnum, t))
+      return FALSE;
+   return w1_netlink_answer(portnum, t, W1_TIMEOUT);
+}
+
+//--------------------------------------------------------------------------
+// Open a netlink socket to the kernel's w1 subsystem and check that it
+// answers for the master of 'portnum'. The socket stays closed if it
+// doesn't, the files are used instead.
+//
+// Returns: TRUE - the kernel answered
+//          FALSE - no w1 netlink, or no such master
+//
+SMALLINT w1_netlink_open(int portnum)
+{
+   struct w1_port *p = &w1_port[portnum];
+   struct sockaddr_nl addr;
+   struct w1_tran t;
+
+   p->sock = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_CONNECTOR);
+   if (p->sock < 0)
+      return FALSE;
+
+   // the kernel picks the port id, and answers to it
+   memset(&addr, 0, sizeof(addr));
+   addr.nl_family = AF_NETLINK;
+   if (bind(p->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+   {
+      w1_netlink_close(portnum);
+      return FALSE;
+   }
+
+   w1_begin(&t);
+   if (!w1_netlink_send(portnum, &t) ||
+       !w1_netlink_answer(portnum, &t, W1_OPEN_TIMEOUT))
+   {
+      OWERROR_CLEAR();
+      w1_netlink_close(portnum);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// Close the netlink socket of 'portnum'
+//
+void w1_netlink_close(int portnum)
+{
+   if (w1_port[portnum].sock >= 0)
+      close(w1_port[portnum].sock);
+   w1_port[portnum].sock = -1;
+}
+
+//--------------------------------------------------------------------------
+// Transactions and system calls of all the ports, for DigiTemp's -v
+//
+void w1_stats(long *transactions, long *syscalls)
+{
+   int i;
+
+   *transactions = 0;
+   *syscalls = 0;
+   for (i = 0; i < MAX_PORTNUM; i++)
+   {
+      *transactions += w1_port[i].transactions;
+      *syscalls += w1_port[i].syscalls;
+   }
+}
+
+//--------------------------------------------------------------------------
+// Reset all of the devices on the 1-Wire Net and return the result.
+//
+// Returns: TRUE(1):  presense pulse(s) detected, device(s) reset
+//          FALSE(0): no presense pulses detected
+//
+SMALLINT owTouchReset(int portnum)
+{
+   struct w1_tran t;
+
+   w1_begin(&t);
+   w1_add(&t, W1_CMD_RESET, NULL, 0);
+   return w1_run(portnum, &t);
+}
+
+//--------------------------------------------------------------------------
+// Send 1 bit of communication to the 1-Wire Net and return the
+// result 1 bit read from the 1-Wire Net. It is the first bit of a byte,
+// a 1 is followed by 7 more read slots and a 0 by 7 write 1 slots.
+//
+SMALLINT owTouchBit(int portnum, SMALLINT sendbit)
+{
+   return owTouchByte(portnum, sendbit ? 0xFF : 0xFE) & 0x01;
+}
+
+//--------------------------------------------------------------------------
+// Send 8 bits of communication to the 1-Wire Net and return the
+// result 8 bits read from the 1-Wire Net.
+//
+SMALLINT owTouchByte(int portnum, SMALLINT sendbyte)
+{
+   struct w1_tran t;
+   uchar b = (uchar)sendbyte;
+
+   w1_begin(&t);
+   w1_add(&t, W1_CMD_TOUCH, &b, 1);
+   if (!w1_run(portnum, &t))
+      return 0xFF;
+   return b;
+}
+
+//--------------------------------------------------------------------------
+// Send 8 bits of communication to the 1-Wire Net. The kernel doesn't read
+// a write back.
+//
+// Returns:  TRUE: byte written
+//           FALSE: the kernel couldn't write it
+//
+SMALLINT owWriteByte(int portnum, SMALLINT sendbyte)
+{
+   struct w1_tran t;
+   uchar b = (uchar)sendbyte;
+
+   w1_begin(&t);
+   w1_add(&t, W1_CMD_WRITE, &b, 1);
+   return w1_run(portnum, &t);
+}
+
+//--------------------------------------------------------------------------
+// Send 8 bits of read communication to the 1-Wire Net and and return the
+// resulting 8 bits read from the 1-Wire Net.
+//
+SMALLINT owReadByte(int portnum)
+{
+   struct w1_tran t;
+   uchar b = 0xFF;
+
+   w1_begin(&t);
+   w1_add(&t, W1_CMD_READ, &b, 1);
+   if (!w1_run(portnum, &t))
+      return 0xFF;
+   return b;
+}
+
+//--------------------------------------------------------------------------
+// The kernel's masters only run at normal speed
+//
+SMALLINT owSpeed(int portnum, SMALLINT new_speed)
+{
+   return MODE_NORMAL;
+}
+
+//--------------------------------------------------------------------------
+// There is no strong pullup through netlink, the kernel only turns it on
+// for its own drivers. The thermometer files get it from the driver.
+//
+SMALLINT owLevel(int portnum, SMALLINT new_level)
+{
+   return MODE_NORMAL;
+}
+
+//--------------------------------------------------------------------------
+// No EPROM programming
+//
+SMALLINT owProgramPulse(int portnum)
+{
+   return FALSE;
+}
+
+//--------------------------------------------------------------------------
+// Delay for at least 'len' ms
+//
+void msDelay(int len)
+{
+   struct timespec s;
+
+   s.tv_sec = len / 1000;
+   s.tv_nsec = (len - (s.tv_sec * 1000)) * 1000000;
+   nanosleep(&s, NULL);
+}
+
+//--------------------------------------------------------------------------
+// Get the current millisecond tick count.  Does not have to represent
+// an actual time, it just needs to be an incrementing timer.
+//
+long msGettick(void)
+{
+   struct timeval tmval;
+
+   gettimeofday(&tmval, NULL);
+   return (tmval.tv_sec & 0xFFFF) * 1000 + tmval.tv_usec / 1000;
+}
+
+//--------------------------------------------------------------------------
+// Send 8 bits of communication to the 1-Wire Net and turn on the strong
+// pullup after them. Only the thermometer files can, the driver powers
+// its Convert T and Copy Scratchpad itself.
+//
+// Returns:  TRUE: byte written, the device is powered
+//           FALSE: no strong pullup, or the byte wasn't written
+//
+SMALLINT owWriteBytePower(int portnum, SMALLINT sendbyte)
+{
+   if (!hasPowerDelivery(portnum))
+   {
+      OWERROR(OWERROR_POWER_NOT_AVAILABLE);
+      return FALSE;
+   }
+
+   return owWriteByte(portnum, sendbyte);
+}
+
+//--------------------------------------------------------------------------
+// No strong pullup after a bit either
+//
+SMALLINT owReadBitPower(int portnum, SMALLINT applyPowerResponse)
+{
+   OWERROR(OWERROR_POWER_NOT_AVAILABLE);
+   return FALSE;
+}
+
+//--------------------------------------------------------------------------
+// Parasite powered devices only get the strong pullup through the
+// thermometer files
+//
+SMALLINT hasPowerDelivery(int portnum)
+{
+   return (w1_port[portnum].sock < 0);
+}
+
+//--------------------------------------------------------------------------
+// No OverDrive
+//
+SMALLINT hasOverDrive(int portnum)
+{
+   return FALSE;
+}
+
+//--------------------------------------------------------------------------
+// No EPROM programming
+//
+SMALLINT hasProgramPulse(int portnum)
+{
+   return FALSE;
+}
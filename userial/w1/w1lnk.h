@@ -0,0 +1,112 @@
+//---------------------------------------------------------------------------
+// Linux kernel w1 bus master adapter for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  w1lnk.h - The kernel's w1 subsystem drives the bus master (w1-gpio, a
+//            DS2482 and so on), DigiTemp talks to the kernel. A
+//            transaction is a list of w1 commands, reset, write, read,
+//            touch and search, that is sent to the kernel as one netlink
+//            message and runs on the bus as one, with nothing else in
+//            between.
+//
+//            Without netlink (not root, or a tree that isn't the
+//            kernel's sysfs) the same transactions are run against the
+//            files of the kernel's thermometer driver, see w1sysfs.c.
+//
+
+#ifndef W1LNK_H
+#define W1LNK_H
+
+#include <limits.h>
+
+// Where the kernel puts its bus masters and their slaves
+#define W1_SYSFS                "/sys/bus/w1/devices"
+
+// The kernel's netlink structures, drivers/w1/w1_netlink.h isn't exported
+#define W1_CN_BUNDLE            1
+
+#define W1_SLAVE_ADD            0
+#define W1_SLAVE_REMOVE         1
+#define W1_MASTER_ADD           2
+#define W1_MASTER_REMOVE        3
+#define W1_MASTER_CMD           4
+#define W1_SLAVE_CMD            5
+#define W1_LIST_MASTERS         6
+
+#define W1_CMD_READ             0
+#define W1_CMD_WRITE            1
+#define W1_CMD_SEARCH           2
+#define W1_CMD_ALARM_SEARCH     3
+#define W1_CMD_TOUCH            4
+#define W1_CMD_RESET            5
+
+struct w1_netlink_msg {
+   unsigned char  type;
+   unsigned char  status;
+   unsigned short len;
+   union {
+      unsigned char id[8];
+      struct {
+         unsigned int id;
+         unsigned int res;
+      } mst;
+   } id;
+   unsigned char  data[0];
+};
+
+struct w1_netlink_cmd {
+   unsigned char  cmd;
+   unsigned char  res;
+   unsigned short len;
+   unsigned char  data[0];
+};
+
+// Most commands in one transaction, most bytes in one of them and most
+// ROMs kept from one search
+#define W1_TRAN_CMDS            8
+#define W1_BLOCK_MAX            512
+#define W1_SEARCH_MAX           256
+
+// One transaction. The bytes of a read or touch are replaced by what was
+// read, a search puts the ROMs it found in its own bytes and counts them
+// in 'num_roms'.
+struct w1_tran {
+   int   num;
+   struct {
+      uchar cmd;
+      uchar *data;
+      int   len;
+   } cmd[W1_TRAN_CMDS];
+   int   num_roms;
+};
+
+// The kernel's master behind each port
+struct w1_port {
+   char  dir[PATH_MAX];          // its directory in sysfs
+   int   master;                 // N of w1_bus_masterN, its netlink id
+   int   sock;                   // netlink socket, -1 to use the files
+   unsigned int seq;
+   int   bulk;                   // it has therm_bulk_read
+   long  transactions;
+   long  syscalls;
+};
+
+extern struct w1_port w1_port[MAX_PORTNUM];
+
+// w1lnk.c
+void     w1_begin(struct w1_tran *);
+SMALLINT w1_add(struct w1_tran *,uchar,uchar *,int);
+SMALLINT w1_run(int,struct w1_tran *);
+SMALLINT w1_netlink_open(int);
+void     w1_netlink_close(int);
+void     w1_stats(long *,long *);
+
+// w1sysfs.c
+SMALLINT w1_sysfs_run(int,struct w1_tran *);
+SMALLINT w1_sysfs_open(int);
+int      w1_convert_all(int,int);
+
+#endif // W1LNK_H
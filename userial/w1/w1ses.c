@@ -0,0 +1,79 @@
+//---------------------------------------------------------------------------
+// Linux kernel w1 bus master adapter for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  w1ses.c - Session functions for the kernel's w1 bus masters. The
+//            'port' is the master's name, w1_bus_master1, or the path of
+//            its directory.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ownet.h"
+#include "w1lnk.h"
+
+// exportable functions
+SMALLINT owAcquire(int,char *);
+void     owRelease(int);
+
+
+//---------------------------------------------------------------------------
+// Attempt to acquire a 1-Wire net. Find the master named in 'port_zstr',
+// and talk to it through netlink if it is one of the kernel's and it
+// answers there.
+//
+// Returns: TRUE - success, the master is there
+//          FALSE - failure, it isn't a w1 bus master
+//
+SMALLINT owAcquire(int portnum, char *port_zstr)
+{
+   struct w1_port *p = &w1_port[portnum];
+   char path[PATH_MAX], *name;
+   int len;
+
+   memset(p, 0, sizeof(*p));
+   p->sock = -1;
+
+   // a name on its own is in the kernel's directory
+   if (strchr(port_zstr, '/') == NULL)
+      snprintf(p->dir, sizeof(p->dir), "%s/%s", W1_SYSFS, port_zstr);
+   else
+      snprintf(p->dir, sizeof(p->dir), "%s", port_zstr);
+
+   len = strlen(p->dir);
+   while ((len > 1) && (p->dir[len - 1] == '/'))
+      p->dir[--len] = 0;
+
+   name = strrchr(p->dir, '/');
+   name = name ? name + 1 : p->dir;
+   if ((sscanf(name, "w1_bus_master%d", &p->master) != 1) ||
+       !w1_sysfs_open(portnum))
+   {
+      fprintf(stderr, "%s is not a w1 bus master\n", port_zstr);
+      OWERROR(OWERROR_OPENCOM_FAILED);
+      return FALSE;
+   }
+
+   snprintf(path, sizeof(path), "%s/therm_bulk_read", p->dir);
+   p->bulk = (access(path, W_OK) == 0);
+
+   // netlink talks to the kernel's own masters, never to a tree of
+   // files somewhere else that has the same name
+   if ((realpath(p->dir, path) != NULL) && (strncmp(path, "/sys/", 5) == 0))
+      w1_netlink_open(portnum);
+
+   return TRUE;
+}
+
+//---------------------------------------------------------------------------
+// Release the previously acquired 1-Wire net.
+//
+void owRelease(int portnum)
+{
+   w1_netlink_close(portnum);
+}
@@ -0,0 +1,473 @@
+//---------------------------------------------------------------------------
+// Linux kernel w1 bus master adapter for DigiTemp
+//
+// Copyright 1996-2018 by Brian C. Lane <bcl@brianlane.com>
+// See COPYING for GNU General Public License
+//---------------------------------------------------------------------------
+//
+//  w1sysfs.c - The master's sysfs files. Every port uses the slave list,
+//              and therm_bulk_read to convert all of the thermometers.
+//
+//              Without netlink the files are all there is, and only the
+//              thermometer driver's. The bytes of a transaction are
+//              followed through the ROM and function commands that
+//              DigiTemp sends to a DS18x20, and each command is done with
+//              the file that does the same:
+//
+//                Convert T          therm_bulk_read, or the slave's
+//                                   w1_slave, which converts and reads it
+//                Read Scratchpad    w1_slave
+//                Read Power Supply  ext_power
+//                Write Scratchpad   resolution, from the config byte
+//                Copy Scratchpad    eeprom_cmd 'save'
+//                Recall E2          eeprom_cmd 'restore'
+//
+//              The driver powers parasite devices itself. Anything else,
+//              and any other device, needs netlink.
+//
+//              A tree with the same files anywhere else is used the same
+//              way, it is never talked to through netlink.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ownet.h"
+#include "owproto.h"
+#include "w1lnk.h"
+
+// What the next bytes of a transaction are
+#define F_ROM           0       // a ROM command, after a reset
+#define F_MATCH         1       // the ROM of a Match ROM
+#define F_FUNC          2       // a function command
+#define F_READ          3       // read slots of the scratchpad
+#define F_POWER         4       // read slots of Read Power Supply
+#define F_WRITE         5       // TH, TL and config of Write Scratchpad
+#define F_DONE          6       // nothing, read slots are 1s
+
+// Where each port's transaction is
+static struct {
+   int   state;
+   int   all;                   // Skip ROM, not Match ROM
+   uchar rom[8];
+   uchar data[9];
+   int   pos;
+   uchar conv_rom[8];           // Scratchpad from the last Convert T
+   uchar conv[9];               // of one slave
+   int   conv_valid;
+   uchar slaves[W1_SEARCH_MAX * 8];
+   int   num_slaves;
+} fbus[MAX_PORTNUM];
+
+// external functions defined in w1lnk.c
+extern void msDelay(int);
+extern long msGettick(void);
+
+
+//--------------------------------------------------------------------------
+// Path of 'file' of the master, or of the slave 'rom' when it isn't NULL.
+// The kernel names a slave by its family and its 48 bit serial number,
+// most significant byte first.
+//
+static void w1_path(int portnum, uchar *rom, char *file, char *path, int size)
+{
+   if (rom == NULL)
+      snprintf(path, size, "%s/%s", w1_port[portnum].dir, file);
+   else
+      snprintf(path, size, "%s/%02x-%02x%02x%02x%02x%02x%02x/%s",
+               w1_port[portnum].dir, rom[0], rom[6], rom[5], rom[4],
+               rom[3], rom[2], rom[1], file);
+}
+
+//--------------------------------------------------------------------------
+// Read a file of the master or a slave into 'buf'
+//
+// Returns: the number of bytes read, -1 if it couldn't be read
+//
+static int w1_read_file(int portnum, uchar *rom, char *file, char *buf, int size)
+{
+   char path[PATH_MAX];
+   int f, len;
+
+   w1_path(portnum, rom, file, path, sizeof(path));
+   w1_port[portnum].syscalls += 3;
+   if ((f = open(path, O_RDONLY)) < 0)
+      return -1;
+   len = read(f, buf, size - 1);
+   close(f);
+   if (len < 0)
+      return -1;
+
+   buf[len] = 0;
+   return len;
+}
+
+//--------------------------------------------------------------------------
+// Write 'value' to a file of the master or a slave
+//
+// Returns: TRUE - written
+//          FALSE - the file isn't there, or the kernel refused it
+//
+static SMALLINT w1_write_file(int portnum, uchar *rom, char *file, char *value)
+{
+   char path[PATH_MAX];
+   int f, ok;
+
+   w1_path(portnum, rom, file, path, sizeof(path));
+   w1_port[portnum].syscalls += 3;
+   if ((f = open(path, O_WRONLY)) < 0)
+      return FALSE;
+   ok = (write(f, value, strlen(value)) == strlen(value));
+   close(f);
+
+   return ok;
+}
+
+//--------------------------------------------------------------------------
+// Read the slaves of the master of 'portnum' from w1_master_slaves into
+// 'roms', 8 bytes each, at most 'max' of them. The list leaves out the
+// CRC8, it is worked out here.
+//
+// Returns: the number of slaves, -1 if the list couldn't be read
+//
+static int w1_sysfs_slaves(int portnum, uchar *roms, int max)
+{
+   char buf[W1_SEARCH_MAX * 17], *line, *save;
+   unsigned int family;
+   unsigned long long serial;
+   uchar crc = 0;
+   int num = 0, i;
+
+   if (w1_read_file(portnum, NULL, "w1_master_slaves", buf, sizeof(buf)) < 0)
+      return -1;
+
+   // one name a line, or 'not found.'
+   for (line = strtok_r(buf, "\n", &save); line && (num < max);
+        line = strtok_r(NULL, "\n", &save))
+   {
+      if (sscanf(line, "%2x-%12llx", &family, &serial) != 2)
+         continue;
+
+      roms[num * 8] = family;
+      for (i = 1; i < 7; i++)
+         roms[num * 8 + i] = (uchar)(serial >> ((i - 1) * 8));
+
+      setcrc8(portnum, 0);
+      for (i = 0; i < 7; i++)
+         crc = docrc8(portnum, roms[num * 8 + i]);
+      roms[num * 8 + 7] = crc;
+      num++;
+   }
+
+   return num;
+}
+
+//--------------------------------------------------------------------------
+// Read the master's slave list when the port is opened, a reset finds
+// them until the next search
+//
+// Returns: TRUE - the list was read
+//          FALSE - 'portnum' isn't a master's directory
+//
+SMALLINT w1_sysfs_open(int portnum)
+{
+   int num;
+
+   memset(&fbus[portnum], 0, sizeof(fbus[portnum]));
+   if ((num = w1_sysfs_slaves(portnum, fbus[portnum].slaves, W1_SEARCH_MAX)) < 0)
+      return FALSE;
+
+   fbus[portnum].num_slaves = num;
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// Start a conversion on all of the master's thermometers with
+// therm_bulk_read. The kernel holds the strong pullup while it writes
+// for the ones that need it, then it is -1 until they are all done.
+// Waits up to 'msec' for that.
+//
+// Returns: TRUE - they converted
+//          FALSE - no therm_bulk_read, or the kernel has no thermometers
+//                  to convert and netlink can send the Convert T instead
+//
+int w1_convert_all(int portnum, int msec)
+{
+   char buf[32];
+   long start;
+   int state = 0;
+
+   if (!w1_port[portnum].bulk)
+      return FALSE;
+
+   w1_port[portnum].transactions++;
+   if (!w1_write_file(portnum, NULL, "therm_bulk_read", "trigger\n"))
+      return FALSE;
+
+   start = msGettick();
+   while ((w1_read_file(portnum, NULL, "therm_bulk_read", buf, sizeof(buf)) > 0) &&
+          ((state = atoi(buf)) == -1) && (msGettick() - start < msec))
+      msDelay(10);
+
+   if ((state == 0) && (w1_port[portnum].sock >= 0))
+      return FALSE;
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// Read the scratchpad of 'rom' from the first line of its w1_slave,
+//   72 01 4b 46 7f ff 0e 10 57 : crc=57 YES
+// The kernel converts it first, unless therm_bulk_read already did.
+//
+static SMALLINT w1_read_scratchpad(int portnum, uchar *rom, uchar *data)
+{
+   char buf[256];
+   unsigned int b[9];
+   int i;
+
+   if ((w1_read_file(portnum, rom, "w1_slave", buf, sizeof(buf)) <= 0) ||
+       (sscanf(buf, "%x %x %x %x %x %x %x %x %x", &b[0], &b[1], &b[2], &b[3],
+               &b[4], &b[5], &b[6], &b[7], &b[8]) != 9))
+   {
+      OWERROR(OWERROR_READ_SCRATCHPAD_VERIFY);
+      return FALSE;
+   }
+
+   for (i = 0; i < 9; i++)
+      data[i] = b[i];
+   return TRUE;
+}
+
+//--------------------------------------------------------------------------
+// Read Power Supply of 'rom' from its ext_power, 1 when it is externally
+// powered. With Skip ROM any parasite powered slave pulls it to 0. A
+// slave without a readable ext_power counts as parasite powered, so it
+// gets the strong pullup.
+//
+static uchar w1_power(int portnum)
+{
+   char buf[32];
+   uchar *rom;
+   int i, power;
+
+   for (i = 0; i < (fbus[portnum].all ? fbus[portnum].num_slaves : 1); i++)
+   {
+      rom = fbus[portnum].all ? &fbus[portnum].slaves[i * 8] : fbus[portnum].rom;
+      if ((w1_read_file(portnum, rom, "ext_power", buf, sizeof(buf)) <= 0) ||
+          (sscanf(buf, "%d", &power) != 1) || (power != 1))
+         return 0x00;
+   }
+
+   return (i > 0) ? 0xFF : 0x00;
+}
+
+//--------------------------------------------------------------------------
+// A function command to the selected slave, or to all of them
+//
+// Returns: TRUE - done, or ready for the bytes that follow it
+//          FALSE - not a command the files can do
+//
+static SMALLINT w1_function(int portnum, uchar cmd)
+{
+   uchar *rom = fbus[portnum].rom;
+   int one = !fbus[portnum].all;
+
+   // Skip ROM on its own only reads the one slave there is
+   if (!one && (fbus[portnum].num_slaves == 1))
+      rom = fbus[portnum].slaves;
+
+   switch (cmd)
+   {
+      // Convert T, they all convert at once, one of them converts and is
+      // read, the scratchpad is kept for the Read Scratchpad after it
+      case 0x44:
+         fbus[portnum].state = F_DONE;
+         if (!one)
+         {
+            w1_convert_all(portnum, 1000);
+            return TRUE;
+         }
+         fbus[portnum].conv_valid = w1_read_scratchpad(portnum, rom, fbus[portnum].conv);
+         memcpy(fbus[portnum].conv_rom, rom, 8);
+         return fbus[portnum].conv_valid;
+
+      // Read Scratchpad
+      case 0xBE:
+         if (!one && (fbus[portnum].num_slaves != 1))
+            break;
+         fbus[portnum].state = F_READ;
+         fbus[portnum].pos = 0;
+         if (fbus[portnum].conv_valid && !memcmp(fbus[portnum].conv_rom, rom, 8))
+         {
+            memcpy(fbus[portnum].data, fbus[portnum].conv, 9);
+            fbus[portnum].conv_valid = FALSE;
+            return TRUE;
+         }
+         return w1_read_scratchpad(portnum, rom, fbus[portnum].data);
+
+      // Read Power Supply
+      case 0xB4:
+         fbus[portnum].state = F_POWER;
+         fbus[portnum].data[0] = w1_power(portnum);
+         return TRUE;
+
+      // Write Scratchpad
+      case 0x4E:
+         if (!one)
+            break;
+         fbus[portnum].state = F_WRITE;
+         fbus[portnum].pos = 0;
+         return TRUE;
+
+      // Copy Scratchpad and Recall E2
+      case 0x48:
+      case 0xB8:
+         if (!one)
+            break;
+         fbus[portnum].state = F_DONE;
+         return w1_write_file(portnum, rom, "eeprom_cmd",
+                              (cmd == 0x48) ? "save\n" : "restore\n");
+   }
+
+   OWERROR(OWERROR_FUNC_NOT_SUP);
+   return FALSE;
+}
+
+//--------------------------------------------------------------------------
+// Send one byte of a transaction and return what the slave answered, -1
+// if the files can't do it
+//
+static int w1_byte(int portnum, uchar out)
+{
+   char value[8];
+   int res;
+
+   switch (fbus[portnum].state)
+   {
+      case F_ROM:
+         if (out == 0xCC)
+         {
+            fbus[portnum].all = TRUE;
+            fbus[portnum].state = F_FUNC;
+            return out;
+         }
+         if (out == 0x55)
+         {
+            fbus[portnum].pos = 0;
+            fbus[portnum].state = F_MATCH;
+            return out;
+         }
+         break;
+
+      case F_MATCH:
+         fbus[portnum].rom[fbus[portnum].pos++] = out;
+         if (fbus[portnum].pos == 8)
+         {
+            fbus[portnum].all = FALSE;
+            fbus[portnum].state = F_FUNC;
+         }
+         return out;
+
+      case F_FUNC:
+         if (w1_function(portnum, out))
+            return out;
+         fbus[portnum].state = F_DONE;
+         return -1;
+
+      case F_READ:
+         if (fbus[portnum].pos >= 9)
+            return out;
+         return out & fbus[portnum].data[fbus[portnum].pos++];
+
+      case F_POWER:
+         return out & fbus[portnum].data[0];
+
+      // the resolution is in bits 6 and 5 of the config byte
+      case F_WRITE:
+         fbus[portnum].data[fbus[portnum].pos++] = out;
+         if (fbus[portnum].pos < 3)
+            return out;
+         fbus[portnum].state = F_DONE;
+         res = ((out >> 5) & 0x03) + 9;
+         sprintf(value, "%d\n", res);
+         if (!w1_write_file(portnum, fbus[portnum].rom, "resolution", value))
+         {
+            OWERROR(OWERROR_WRITE_SCRATCHPAD_FAILED);
+            return -1;
+         }
+         return out;
+
+      case F_DONE:
+         return out;
+   }
+
+   OWERROR(OWERROR_FUNC_NOT_SUP);
+   return -1;
+}
+
+//--------------------------------------------------------------------------
+// Run a transaction with the master's files. A reset finds the slaves of
+// the last search, a search reads the list again.
+//
+// Returns: TRUE - every command was done
+//          FALSE - a reset found no slaves, or the files can't do a
+//                  command
+//
+SMALLINT w1_sysfs_run(int portnum, struct w1_tran *t)
+{
+   SMALLINT ok = TRUE;
+   int i, j, b, num;
+
+   for (i = 0; i < t->num; i++)
+   {
+      switch (t->cmd[i].cmd)
+      {
+         case W1_CMD_RESET:
+            fbus[portnum].state = F_ROM;
+            if (fbus[portnum].num_slaves == 0)
+            {
+               OWERROR(OWERROR_NO_DEVICES_ON_NET);
+               ok = FALSE;
+            }
+            break;
+
+         case W1_CMD_WRITE:
+         case W1_CMD_READ:
+         case W1_CMD_TOUCH:
+            for (j = 0; j < t->cmd[i].len; j++)
+            {
+               b = w1_byte(portnum, (t->cmd[i].cmd == W1_CMD_READ) ? 0xFF : t->cmd[i].data[j]);
+               if (b < 0)
+               {
+                  ok = FALSE;
+                  b = 0xFF;
+               }
+               if (t->cmd[i].cmd != W1_CMD_WRITE)
+                  t->cmd[i].data[j] = b;
+            }
+            break;
+
+         // the driver has no alarm search
+         case W1_CMD_ALARM_SEARCH:
+            t->num_roms = 0;
+            break;
+
+         case W1_CMD_SEARCH:
+            num = w1_sysfs_slaves(portnum, fbus[portnum].slaves, W1_SEARCH_MAX);
+            if (num < 0)
+            {
+               OWERROR(OWERROR_SEARCH_ERROR);
+               ok = FALSE;
+               break;
+            }
+            fbus[portnum].num_slaves = num;
+            t->num_roms = (num * 8 <= t->cmd[i].len) ? num : t->cmd[i].len / 8;
+            memcpy(t->cmd[i].data, fbus[portnum].slaves, t->num_roms * 8);
+            break;
+      }
+   }
+
+   return ok;
+}